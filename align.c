@@ -0,0 +1,667 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "align.h"
+#include "audio_ctrl.h"
+#include "audio_file.h"
+#include "audio_stream.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "pcm.h"
+
+/*
+ * One -d of a measurement, whose channels follow those of the sources given
+ * before it
+ */
+typedef struct align_source_t {
+	const char *path;      /* once opened */
+	int device;            /* recorded, else a recording read whole */
+	audio_ctrl_t ctrl;     /* of a device */
+	audio_file_t file;     /* of a recording */
+	audio_stream_t chunk;  /* layout of a block of its samples */
+	u_int fs;
+	u_int first;           /* channel of the measurement of its channel 0 */
+	size_t frame;          /* bytes of a sample frame */
+	size_t offset;         /* of the next block of a recording */
+	u_char *data;          /* a block read from a device */
+	float *pcm;            /* a block, normalized */
+} align_source_t;
+
+int
+build_align(align_t *al, u_int channels, u_int nsamples, u_int fs,
+    float fmin, float fmax)
+{
+	u_int a, b, p, j;
+	size_t nb;
+	int res;
+
+	memset(al, 0, sizeof(*al));
+	if (channels < 2 || channels > ALIGN_MAX_CHANNELS) {
+		return E_ALIGN_CHANNELS;
+	}
+	if ((res = build_fft_config(&al->config, nsamples, fs, nsamples,
+	    0.0f)) != 0) {
+		return res;
+	}
+	al->channels = channels;
+	al->npairs = channels * (channels - 1) / 2;
+	al->lo = (u_int)ceil((double)fmin * nsamples / fs);
+	al->hi = fmax > 0.0f ? (u_int)floor((double)fmax * nsamples / fs) :
+	    nsamples / 2;
+	if (al->lo < 1) {
+		al->lo = 1;
+	}
+	if (al->hi > nsamples / 2 - 1) {
+		al->hi = nsamples / 2 - 1;
+	}
+	if (al->lo > al->hi) {
+		return E_ALIGN_BAND;
+	}
+
+	nb = al->config.nbins;
+	al->window = malloc(sizeof(float) * nsamples);
+	al->frame = malloc(sizeof(float) * nsamples * channels);
+	al->twiddles = malloc(sizeof(cplx) * nsamples / 2);
+	al->buf = malloc(sizeof(cplx) * nsamples);
+	al->tmp = malloc(sizeof(cplx) * nsamples);
+	al->spectra = calloc(nb * channels, sizeof(cplx));
+	al->cross = calloc(nb * al->npairs, sizeof(cplx));
+	al->pairs = calloc(al->npairs, sizeof(align_pair_t));
+	if (al->window == NULL || al->frame == NULL || al->twiddles == NULL ||
+	    al->buf == NULL || al->tmp == NULL || al->spectra == NULL ||
+	    al->cross == NULL || al->pairs == NULL) {
+		free_align(al);
+		return E_NO_MEMORY;
+	}
+
+	for (j = 0; j < nsamples; j++) {
+		al->window[j] = (float)(0.5 - 0.5 *
+		    cos(2.0 * M_PI * j / nsamples));
+	}
+	fft_twiddles(al->twiddles, nsamples);
+	for (p = 0, a = 0; a < channels; a++) {
+		for (b = a + 1; b < channels; b++, p++) {
+			al->pairs[p].a = a;
+			al->pairs[p].b = b;
+		}
+	}
+	return 0;
+}
+
+void
+free_align(align_t *al)
+{
+	free(al->window);
+	free(al->frame);
+	free(al->twiddles);
+	free(al->buf);
+	free(al->tmp);
+	free(al->spectra);
+	free(al->cross);
+	free(al->pairs);
+	memset(al, 0, sizeof(*al));
+}
+
+/*
+ * Transform every channel of the frame and add the cross spectrum of every
+ * pair to the block
+ *
+ * Two real channels x and y share one complex transform Z of x + iy, from
+ * which X[k] = (Z[k] + Z*[n - k]) / 2 and Y[k] = (Z[k] - Z*[n - k]) / 2i.
+ */
+static void
+transform_frame(align_t *al)
+{
+	u_int c, j, k, p, n;
+	size_t nb;
+	const float *x, *y;
+	cplx z, zm, *xa, *xb, *s;
+
+	n = al->config.nsamples;
+	nb = al->config.nbins;
+	for (c = 0; c < al->channels; c += 2) {
+		x = al->frame + (size_t)c * n;
+		y = c + 1 < al->channels ? x + n : NULL;
+		for (j = 0; j < n; j++) {
+			al->buf[j] = x[j] * al->window[j] +
+			    I * (y != NULL ? y[j] * al->window[j] : 0.0f);
+		}
+		fft_cplx_table(al->buf, al->tmp, al->twiddles, n);
+		xa = al->spectra + c * nb;
+		xb = xa + nb;
+		for (k = al->lo; k <= al->hi; k++) {
+			z = al->buf[k];
+			zm = conj(al->buf[n - k]);
+			xa[k] = 0.5 * (z + zm);
+			if (y != NULL) {
+				xb[k] = -0.5 * I * (z - zm);
+			}
+		}
+	}
+
+	for (p = 0; p < al->npairs; p++) {
+		xa = al->spectra + al->pairs[p].a * nb;
+		xb = al->spectra + al->pairs[p].b * nb;
+		s = al->cross + p * nb;
+		for (k = al->lo; k <= al->hi; k++) {
+			s[k] += conj(xa[k]) * xb[k];
+		}
+	}
+	al->nframes++;
+}
+
+/*
+ * Add n interleaved sample frames
+ *
+ * Every frame that fills up is transformed, then its second half is kept as
+ * the first half of the next one.
+ */
+void
+align_update(align_t *al, const float *pcm, u_int n)
+{
+	u_int i, c, half, channels, nsamples;
+
+	channels = al->channels;
+	nsamples = al->config.nsamples;
+	half = nsamples / 2;
+	for (i = 0; i < n; i++) {
+		for (c = 0; c < channels; c++) {
+			al->frame[(size_t)c * nsamples + al->fill] =
+			    pcm[(size_t)i * channels + c];
+		}
+		if (++al->fill < nsamples) {
+			continue;
+		}
+		transform_frame(al);
+		for (c = 0; c < channels; c++) {
+			memmove(al->frame + (size_t)c * nsamples,
+			    al->frame + (size_t)c * nsamples + half,
+			    sizeof(float) * half);
+		}
+		al->fill = half;
+	}
+}
+
+/*
+ * The band-limited correlation of the spectrum g at a delay of tau samples,
+ * with its first and second derivatives
+ */
+static double
+correlate(const cplx *g, u_int lo, u_int hi, u_int n, double tau,
+    double *d1, double *d2)
+{
+	u_int k;
+	double w, r;
+	cplx e, rot, z;
+
+	e = cexp(I * 2.0 * M_PI * lo * tau / n);
+	rot = cexp(I * 2.0 * M_PI * tau / n);
+	r = *d1 = *d2 = 0.0;
+	for (k = lo; k <= hi; k++) {
+		z = g[k] * e;
+		w = 2.0 * M_PI * k / n;
+		r += creal(z);
+		*d1 -= w * cimag(z);
+		*d2 -= w * w * creal(z);
+		e *= rot;
+	}
+	return r;
+}
+
+/*
+ * Find the delay of a pair from its phase transformed spectrum g and its
+ * correlation r
+ */
+static void
+find_delay(const align_t *al, const cplx *g, const double *r,
+    align_pair_t *pair)
+{
+	u_int j, i, n, best;
+	double tau, step, d1, d2, peak;
+
+	n = al->config.nsamples;
+	best = 0;
+	for (j = 1; j < n; j++) {
+		if (r[j] > r[best]) {
+			best = j;
+		}
+	}
+	tau = best < n / 2 ? (double)best : (double)best - n;
+
+	for (i = 0; i < ALIGN_NEWTON; i++) {
+		correlate(g, al->lo, al->hi, n, tau, &d1, &d2);
+		if (d2 >= 0.0) {
+			break;
+		}
+		step = -d1 / d2;
+		tau += fmax(-0.5, fmin(step, 0.5));
+	}
+	peak = correlate(g, al->lo, al->hi, n, tau, &d1, &d2) /
+	    (al->hi - al->lo + 1);
+
+	pair->delay = tau;
+	pair->peak = peak;
+}
+
+/*
+ * Work out the delay of every pair over the frames added since the last
+ * block, at time t in seconds
+ *
+ * Two pairs share an inverse transform: with G and H the spectra of the
+ * real correlations g and h, the inverse of G + iH is g + ih.
+ */
+void
+align_block(align_t *al, double t)
+{
+	u_int p, q, k, j, n;
+	size_t nb;
+	double m, *r, *h;
+	cplx *g;
+	align_pair_t *pair;
+
+	if (al->nframes == 0) {
+		return;
+	}
+	n = al->config.nsamples;
+	nb = al->config.nbins;
+
+	/* the phase transform */
+	for (k = 0; k < nb * al->npairs; k++) {
+		m = cabs(al->cross[k]);
+		al->cross[k] = m > 0.0 ? al->cross[k] / m : 0.0;
+	}
+
+	/* the correlations go into the spare spectra, as doubles */
+	r = (double *)al->tmp;
+	h = r + n;
+	for (p = 0; p < al->npairs; p += 2) {
+		q = p + 1 < al->npairs ? p + 1 : p;
+		memset(al->buf, 0, sizeof(cplx) * n);
+		for (k = al->lo; k <= al->hi; k++) {
+			g = al->cross + p * nb + k;
+			al->buf[k] = conj(*g);
+			al->buf[n - k] = *g;
+			if (q != p) {
+				g = al->cross + q * nb + k;
+				al->buf[k] -= I * conj(*g);
+				al->buf[n - k] -= I * *g;
+			}
+		}
+		/* inverse by the conjugate: the real part is g, -imag h */
+		fft_cplx_table(al->buf, al->tmp, al->twiddles, n);
+		for (j = 0; j < n; j++) {
+			r[j] = creal(al->buf[j]);
+			h[j] = -cimag(al->buf[j]);
+		}
+
+		find_delay(al, al->cross + p * nb, r, &al->pairs[p]);
+		if (q != p) {
+			find_delay(al, al->cross + q * nb, h, &al->pairs[q]);
+		}
+	}
+
+	for (p = 0; p < al->npairs; p++) {
+		pair = &al->pairs[p];
+		if (pair->peak >= ALIGN_MIN_PEAK) {
+			pair->n++;
+			pair->st += t;
+			pair->sd += pair->delay;
+			pair->stt += t * t;
+			pair->std += t * pair->delay;
+			pair->sdd += pair->delay * pair->delay;
+		}
+	}
+	memset(al->cross, 0, sizeof(cplx) * nb * al->npairs);
+	al->nframes = 0;
+}
+
+static void
+print_block(FILE *out, const align_t *al, double t)
+{
+	u_int p;
+	const align_pair_t *pair;
+
+	for (p = 0; p < al->npairs; p++) {
+		pair = &al->pairs[p];
+		fprintf(out, "%-10.3f %-3u %-3u %10.3f %10.2f %6.3f\n", t,
+		    pair->a, pair->b, pair->delay,
+		    pair->delay * 1e6 / al->config.fs, pair->peak);
+	}
+}
+
+/*
+ * Print the mean delay of every pair, the drift of the fitted line in parts
+ * per million and the rms distance of the delays from it
+ */
+static void
+print_summary(FILE *out, const align_t *al)
+{
+	u_int p;
+	double n, mean, sxx, sxy, syy, slope, spread;
+	const align_pair_t *pair;
+
+	fprintf(out, "# A  B        DELAY         US  DRIFT PPM     SPREAD "
+	    "BLOCKS\n");
+	for (p = 0; p < al->npairs; p++) {
+		pair = &al->pairs[p];
+		fprintf(out, "# %-3u%-3u", pair->a, pair->b);
+		if (pair->n == 0) {
+			fprintf(out, " %10s %10s %10s %10s %6lu\n", "-", "-",
+			    "-", "-", pair->n);
+			continue;
+		}
+		n = (double)pair->n;
+		mean = pair->sd / n;
+		sxx = pair->stt - pair->st * pair->st / n;
+		sxy = pair->std - pair->st * pair->sd / n;
+		syy = pair->sdd - pair->sd * pair->sd / n;
+		slope = sxx > 0.0 ? sxy / sxx : 0.0;
+		spread = sqrt(fmax(0.0, syy - slope * sxy) / n);
+		fprintf(out, " %10.3f %10.2f %10.3f %10.4f %6lu\n", mean,
+		    mean * 1e6 / al->config.fs,
+		    slope * 1e6 / al->config.fs, spread, pair->n);
+	}
+}
+
+static double
+elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) +
+	    (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Open path as a recording or a device recording in the format of fallback,
+ * with blocks of ms
+ */
+static int
+open_source(align_source_t *s, const char *path, audio_config_t fallback,
+    u_int ms)
+{
+	struct stat st;
+	int res;
+
+	s->device = !(stat(path, &st) == 0 && S_ISREG(st.st_mode));
+	if (!s->device) {
+		if ((res = open_audio_file(&s->file, path, fallback)) != 0) {
+			return res;
+		}
+		s->path = path;
+		s->fs = s->file.config.sample_rate;
+		return build_stream(ms, s->file.config.channels, s->fs,
+		    s->file.config.buffer_size, s->file.config.precision,
+		    s->file.config.encoding, &s->chunk);
+	}
+
+	if ((res = build_audio_ctrl(&s->ctrl, path, AUMODE_RECORD)) != 0) {
+		return res;
+	}
+	s->path = path;
+	if ((res = update_audio_ctrl(&s->ctrl, fallback)) != 0) {
+		return res;
+	}
+	s->fs = s->ctrl.config.sample_rate;
+	if ((res = build_stream_from_ctrl(s->ctrl, ms, &s->chunk)) != 0) {
+		return res;
+	}
+	/* the others are read in turn, the driver holds on meanwhile */
+	return tune_stream(&s->ctrl, &s->chunk, STREAM_BUFFER_FRAMES);
+}
+
+static void
+close_source(align_source_t *s)
+{
+	if (s->path == NULL) {
+		return;
+	}
+	if (s->device) {
+		close_audio_ctrl(&s->ctrl);
+	} else {
+		close_audio_file(&s->file);
+	}
+	free(s->data);
+	free(s->pcm);
+}
+
+/*
+ * Normalize n sample frames of a source, read from a device beforehand, or
+ * the next ones of a recording, into the channels of pcm it owns
+ */
+static int
+convert_source(align_source_t *s, u_int n, float *pcm, u_int channels)
+{
+	u_int j, c;
+	int res;
+	audio_stream_t chunk;
+
+	chunk = s->chunk;
+	chunk.total_samples = n * chunk.channels;
+	chunk.total_size = n * s->frame;
+	if (s->device) {
+		res = to_normalized_pcm(chunk, s->data, s->pcm);
+	} else {
+		res = to_normalized_pcm(chunk,
+		    s->file.map + s->file.data_offset + s->offset, s->pcm);
+		release_file_range(&s->file, s->offset, chunk.total_size);
+		s->offset += chunk.total_size;
+	}
+	if (res != 0) {
+		return res;
+	}
+
+	for (j = 0; j < n; j++) {
+		for (c = 0; c < chunk.channels; c++) {
+			pcm[j * channels + s->first + c] =
+			    s->pcm[j * chunk.channels + c];
+		}
+	}
+	return 0;
+}
+
+/*
+ * Measure the delay between every pair of channels of the sources in paths
+ *
+ * Each path is a recording, which is measured whole, or a device, which is
+ * recorded in the format of fallback for seconds, ALIGN_SECONDS if 0. The
+ * channels of every source follow those of the one before, so devices
+ * recorded side by side are measured against one another and the drift
+ * between their clocks shows. They must share a sample rate, and the
+ * recordings end with the shortest. Every ms of samples makes a block,
+ * whose delays are written to out, followed by a summary of every pair and
+ * how much of the duration of the samples the measurement took.
+ */
+int
+measure_align(const char **paths, u_int npaths, audio_config_t fallback,
+    u_int ms, u_int nsamples, u_int seconds, float fmin, float fmax,
+    FILE *out)
+{
+	u_int i, n, fs, channels, nframes, nblocks;
+	u_long total, done;
+	int res, device;
+	size_t left;
+	struct timespec start;
+	double busy;
+	align_source_t sources[ALIGN_MAX_CHANNELS], *s;
+	align_t al;
+	float *pcm;
+
+	pcm = NULL;
+	memset(&al, 0, sizeof(al));
+	memset(sources, 0, sizeof(sources));
+	if (npaths > ALIGN_MAX_CHANNELS) {
+		return E_ALIGN_CHANNELS;
+	}
+	fs = channels = nframes = 0;
+	device = 0;
+	for (i = 0; i < npaths; i++) {
+		s = &sources[i];
+		if ((res = open_source(s, paths[i], fallback, ms)) != 0) {
+			goto done;
+		}
+		if (i > 0 && s->fs != fs) {
+			res = E_ALIGN_RATE;
+			goto done;
+		}
+		fs = s->fs;
+		s->first = channels;
+		channels += s->chunk.channels;
+		device |= s->device;
+		n = s->chunk.total_samples / s->chunk.channels;
+		if (i == 0 || n < nframes) {
+			nframes = n;
+		}
+	}
+	if ((res = build_align(&al, channels, nsamples, fs, fmin,
+	    fmax)) != 0) {
+		goto done;
+	}
+
+	/* the same whole sample frames from every source */
+	for (i = 0; i < npaths; i++) {
+		s = &sources[i];
+		s->frame = s->chunk.channels *
+		    (s->chunk.precision / STREAM_BYTE_SIZE);
+		s->chunk.total_samples = nframes * s->chunk.channels;
+		s->chunk.total_size = nframes * s->frame;
+		s->pcm = malloc(sizeof(float) * s->chunk.total_samples);
+		if (s->device) {
+			s->data = malloc(s->chunk.total_size);
+		}
+		if (s->pcm == NULL || (s->device && s->data == NULL)) {
+			res = E_NO_MEMORY;
+			goto done;
+		}
+	}
+	if ((pcm = malloc(sizeof(float) * nframes * channels)) == NULL) {
+		res = E_NO_MEMORY;
+		goto done;
+	}
+
+	for (i = 0; i < npaths; i++) {
+		fprintf(out, "# align %s: channels %u to %u\n", paths[i],
+		    sources[i].first,
+		    sources[i].first + sources[i].chunk.channels - 1);
+	}
+	fprintf(out, "# %u channels at %u Hz, %u samples, %.1f to %.1f Hz\n",
+	    channels, fs, nsamples, (double)al.lo * fs / nsamples,
+	    (double)al.hi * fs / nsamples);
+	fprintf(out, "TIME       A   B        DELAY         US   PEAK\n");
+
+	total = (u_long)(seconds > 0 ? seconds : ALIGN_SECONDS) * fs;
+	busy = 0.0;
+	done = 0;
+	for (nblocks = 0;; nblocks++) {
+		if (device && done >= total) {
+			break;
+		}
+		n = nframes;
+		for (i = 0; i < npaths; i++) {
+			s = &sources[i];
+			if (s->device) {
+				continue;
+			}
+			left = (s->file.data_size - s->offset) / s->frame;
+			if (left < n) {
+				n = (u_int)left;
+			}
+		}
+		if (n == 0) {
+			break;
+		}
+
+		/* every device in turn, each holding on while it waits */
+		for (i = 0; i < npaths && res == 0; i++) {
+			if (sources[i].device) {
+				res = stream(sources[i].ctrl, sources[i].chunk,
+				    sources[i].data);
+			}
+		}
+		if (res != 0) {
+			break;
+		}
+		if (device && nblocks == 0) {
+			/* whatever the drivers held before the start */
+			for (i = 0; i < npaths; i++) {
+				if (!sources[i].device) {
+					sources[i].offset += n *
+					    sources[i].frame;
+				}
+			}
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < npaths && res == 0; i++) {
+			res = convert_source(&sources[i], n, pcm, channels);
+		}
+		if (res != 0) {
+			break;
+		}
+
+		align_update(&al, pcm, n);
+		done += n;
+		if (al.nframes > 0) {
+			align_block(&al, (double)done / fs);
+			busy += elapsed(&start);
+			print_block(out, &al, (double)done / fs);
+		} else {
+			busy += elapsed(&start);
+		}
+	}
+	if (res != 0) {
+		goto done;
+	}
+
+	print_summary(out, &al);
+	if (done > 0) {
+		fprintf(out, "# %.3f s of samples in %.3f s, %.1f%% of real "
+		    "time\n", (double)done / fs, busy,
+		    100.0 * busy * fs / done);
+	}
+	fflush(out);
+
+done:
+	free_align(&al);
+	free(pcm);
+	for (i = 0; i < npaths; i++) {
+		close_source(&sources[i]);
+	}
+	return res;
+}
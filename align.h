@@ -0,0 +1,95 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_ALIGN_H
+#define AUDIO_ALIGN_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "audio_ctrl.h"
+#include "fft.h"
+
+#define ALIGN_MAX_CHANNELS 16
+#define ALIGN_SECONDS 10      /* devices are measured this long by default */
+#define ALIGN_NEWTON 4        /* refinements of the sub-sample peak */
+#define ALIGN_MIN_PEAK 0.25   /* weaker peaks are not counted for drift */
+
+/*
+ * Delay of one channel after another, block after block
+ *
+ * The delays of the blocks whose peak is high enough are fitted with a
+ * straight line by least squares: its slope is the drift.
+ */
+typedef struct align_pair_t {
+	u_int a, b;        /* channels, b is delayed against a */
+	double delay;      /* of the last block, samples */
+	double peak;       /* of the last block, 1 for a perfect match */
+	u_long n;          /* blocks fitted */
+	double st, sd, stt, std, sdd; /* sums of the fit */
+} align_pair_t;
+
+/*
+ * Generalized cross-correlation with the phase transform of every pair of
+ * channels
+ *
+ * Frames of nsamples overlap by half and go through a Hann window. Every
+ * channel of a frame is transformed once, two channels to a complex
+ * transform, and its spectrum serves every pair it is part of. The cross
+ * spectra of a pair are summed over the frames of a block, then weighted by
+ * their inverse magnitude, which leaves only the phase, and transformed
+ * back, two pairs to a transform. The delay is the highest point of that
+ * correlation, refined to a fraction of a sample by Newton's method on the
+ * band-limited correlation between the bins of fmin and fmax.
+ */
+typedef struct align_t {
+	fft_config_t config; /* transform of a single frame */
+	u_int channels;
+	u_int npairs;
+	u_int lo, hi;        /* bins of the band */
+	float *window;       /* the Hann window */
+	float *frame;        /* samples of the frame being filled, by channel */
+	u_int fill;          /* samples of every channel in frame */
+	cplx *twiddles;
+	cplx *buf, *tmp;     /* of a transform */
+	cplx *spectra;       /* bins of every channel of the current frame */
+	cplx *cross;         /* bins of every pair, summed over the block */
+	u_int nframes;       /* frames summed into cross */
+	align_pair_t *pairs;
+} align_t;
+
+int build_align(align_t *al, u_int channels, u_int nsamples, u_int fs,
+    float fmin, float fmax);
+void free_align(align_t *al);
+void align_update(align_t *al, const float *pcm, u_int n);
+void align_block(align_t *al, double t);
+int measure_align(const char **paths, u_int npaths, audio_config_t fallback,
+    u_int ms, u_int nsamples, u_int seconds, float fmin, float fmax,
+    FILE *out);
+
+#endif
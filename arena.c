@@ -0,0 +1,85 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "error_codes.h"
+
+/*
+ * Allocate an arena of size bytes
+ *
+ * The memory is zeroed so that buffers start out the way calloc would leave
+ * them.
+ */
+int
+build_arena(arena_t *arena, size_t size)
+{
+	void *base;
+
+	size = ARENA_ROUND(size);
+	if (posix_memalign(&base, ARENA_ALIGN, size > 0 ? size : ARENA_ALIGN)
+	    != 0) {
+		return E_NO_MEMORY;
+	}
+	memset(base, 0, size);
+
+	arena->base = base;
+	arena->size = size;
+	arena->used = 0;
+	return 0;
+}
+
+/*
+ * Take size bytes from the arena
+ *
+ * Returns NULL if the arena was sized too small.
+ */
+void *
+arena_alloc(arena_t *arena, size_t size)
+{
+	void *p;
+
+	size = ARENA_ROUND(size);
+	if (arena->base == NULL || size > arena->size - arena->used) {
+		return NULL;
+	}
+	p = arena->base + arena->used;
+	arena->used += size;
+	return p;
+}
+
+void
+free_arena(arena_t *arena)
+{
+	free(arena->base);
+	arena->base = NULL;
+	arena->size = 0;
+	arena->used = 0;
+}
@@ -32,6 +32,9 @@
 #include <sys/audioio.h>
 #include <sys/types.h>
 
+#include <math.h>
+#include <stdint.h>
+
 /* Convert between signed and unsigned. */
 static inline void change_sign8(u_char *);
 static inline void change_sign16_le(u_char *);
@@ -45,6 +48,10 @@ static inline void swap_bytes32(u_char *);
 static inline float normalize8(u_char *);
 static inline float normalize16(u_char *);
 static inline float normalize32(u_char *);
+/* Denormalization, the inverse of normalization */
+static inline void denormalize8(float, u_char *);
+static inline void denormalize16(float, u_char *);
+static inline void denormalize32(float, u_char *);
 
 static inline void
 change_sign8(u_char *p)
@@ -116,8 +123,34 @@ normalize16(u_char *p)
 static inline float
 normalize32(u_char *p)
 {
-	float *f;
+	int32_t *i;
+
+	i = (int32_t *)p;
+	return (float)(i[0] / 2147483647.0);
+}
+
+static inline void
+denormalize8(float x, u_char *p)
+{
+	x = fmaxf(-1.0f, fminf(x, 127.0f / 128.0f));
+	p[0] = (u_char)(int8_t)lrintf(x * 128.0f);
+}
+
+static inline void
+denormalize16(float x, u_char *p)
+{
+	short *s;
+
+	x = fmaxf(-1.0f, fminf(x, 32767.0f / 32768.0f));
+	s = (short *)p;
+	s[0] = (short)lrintf(x * 32768.0f);
+}
+
+static inline void
+denormalize32(float x, u_char *p)
+{
+	int32_t *i;
 
-	f = (float *)p;
-	return f[0] / 2147483647.0f;
+	i = (int32_t *)p;
+	i[0] = (int32_t)lrint(fmax(-1.0, fmin(x, 1.0)) * 2147483647.0);
 }
@@ -28,10 +28,16 @@
  */
 #include <sys/audioio.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "audio_ctrl.h"
+#include "audio_file.h"
 #include "audio_stream.h"
 #include "error_codes.h"
 
@@ -99,16 +105,216 @@ get_mode(audio_ctrl_t ctrl)
 	}
 }
 
+/*
+ * Get the capture mode as a string
+ */
+const char *
+get_capture_name(audio_ctrl_t ctrl)
+{
+	switch (ctrl.capture) {
+	case CTRL_CAPTURE_READ:
+		return "read";
+	case CTRL_CAPTURE_MMAP:
+		return "mmap";
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Switch the controller to capture straight from the driver's ring buffer
+ *
+ * Not every driver can map its record buffer; if the mapping fails the
+ * controller silently stays in CTRL_CAPTURE_READ. Recordings always succeed,
+ * their own mapping stands in for the ring.
+ */
+int
+map_audio_ctrl(audio_ctrl_t *ctrl)
+{
+	void *base;
+	u_int align;
+	audio_offset_t ofs;
+	audio_ring_t *ring;
+
+	if ((ring = calloc(1, sizeof(audio_ring_t))) == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	if (ctrl->file != NULL) {
+		ring->base = ctrl->file->map + ctrl->file->data_offset;
+		align = ctrl->config.channels *
+		    (ctrl->config.precision / STREAM_BYTE_SIZE);
+		ring->size = ctrl->file->data_size - ctrl->file->data_size % align;
+		ring->byte_rate = ctrl->config.sample_rate * align;
+		clock_gettime(CLOCK_MONOTONIC, &ring->start);
+	} else {
+		base = mmap(NULL, ctrl->config.buffer_size, PROT_READ,
+		    MAP_SHARED | MAP_FILE, ctrl->fd, 0);
+		if (base == MAP_FAILED ||
+		    ioctl(ctrl->fd, AUDIO_GETIOFFS, &ofs) == -1) {
+			if (base != MAP_FAILED) {
+				munmap(base, ctrl->config.buffer_size);
+			}
+			free(ring);
+			return 0;
+		}
+		ring->base = base;
+		ring->size = ctrl->config.buffer_size;
+		ring->counter = ofs.samples;
+	}
+
+	ctrl->ring = ring;
+	ctrl->capture = CTRL_CAPTURE_MMAP;
+	return 0;
+}
+
+/*
+ * Go back to capturing with read(2)
+ */
+void
+unmap_audio_ctrl(audio_ctrl_t *ctrl)
+{
+	if (ctrl->ring == NULL) {
+		return;
+	}
+	if (ctrl->file == NULL) {
+		munmap((void *)ctrl->ring->base, ctrl->ring->size);
+	}
+	free(ctrl->ring);
+	ctrl->ring = NULL;
+	ctrl->capture = CTRL_CAPTURE_READ;
+}
+
+/*
+ * Initializes an audio controller that plays back a recording
+ *
+ * The recording is memory-mapped and stands in for a recording device. Raw
+ * recordings start out in the DEFAULT_RAW_* format until update_audio_ctrl()
+ * is called.
+ */
+static int
+build_file_ctrl(audio_ctrl_t *ctrl, const char *path, u_int mode)
+{
+	int res;
+	audio_config_t none = { 0, 0, 0, 0, 0 };
+
+	if ((ctrl->file = malloc(sizeof(audio_file_t))) == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	if ((res = open_audio_file(ctrl->file, path, none)) != 0) {
+		free(ctrl->file);
+		ctrl->file = NULL;
+		return res;
+	}
+
+	ctrl->path = path;
+	ctrl->fd = ctrl->file->fd;
+	ctrl->mode = mode;
+	ctrl->config = ctrl->file->config;
+	ctrl->blocksize = 0;
+
+	return 0;
+}
+
+/*
+ * Initializes an audio controller that plays into fd, open on path
+ *
+ * The samples are written raw, in the DEFAULT_RAW_* format until
+ * update_audio_ctrl() is called.
+ */
+static void
+set_sink_ctrl(audio_ctrl_t *ctrl, const char *path, int fd)
+{
+	ctrl->fd = fd;
+	ctrl->path = path;
+	ctrl->mode = AUMODE_PLAY;
+	ctrl->sink = 1;
+	ctrl->config.channels = DEFAULT_RAW_CHANNELS;
+	ctrl->config.sample_rate = DEFAULT_RAW_SAMPLE_RATE;
+	ctrl->config.precision = DEFAULT_RAW_PRECISION;
+	ctrl->config.encoding = DEFAULT_RAW_ENCODING;
+	ctrl->config.buffer_size = DEFAULT_RAW_SAMPLE_RATE / 10 *
+	    (DEFAULT_RAW_PRECISION / STREAM_BYTE_SIZE);
+	ctrl->blocksize = 0;
+}
+
+/*
+ * Initializes an audio controller that plays into a file or a pipe, or
+ * standard output for "-"
+ *
+ * Regular files are truncated.
+ */
+static int
+build_sink_ctrl(audio_ctrl_t *ctrl, const char *path)
+{
+	int fd;
+
+	if (strcmp(path, "-") == 0) {
+		fd = dup(STDOUT_FILENO);
+	} else {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if (fd == -1) {
+		return E_CTRL_FILE_OPEN;
+	}
+	set_sink_ctrl(ctrl, path, fd);
+
+	return 0;
+}
+
+/*
+ * The half of an audio_info_t that describes the direction of mode
+ */
+static struct audio_prinfo *
+get_prinfo(audio_info_t *info, u_int mode)
+{
+	return mode == AUMODE_PLAY ? &info->play : &info->record;
+}
+
+static void
+set_ctrl_config(audio_ctrl_t *ctrl, audio_info_t *info)
+{
+	struct audio_prinfo *pr;
+
+	pr = get_prinfo(info, ctrl->mode);
+	ctrl->config.precision = pr->precision;
+	ctrl->config.encoding = pr->encoding;
+	ctrl->config.buffer_size = pr->buffer_size;
+	ctrl->config.sample_rate = pr->sample_rate;
+	ctrl->config.channels = pr->channels;
+	ctrl->blocksize = info->blocksize;
+}
+
 /*
  * Initializes an audio controller based on the file path to the audio device
+ *
+ * Regular files are treated as recordings, see build_file_ctrl(). Playing
+ * into anything but an audio device, including character devices that do
+ * not answer AUDIO_GETINFO, writes to a file or a pipe instead, see
+ * build_sink_ctrl().
  */
 int
 build_audio_ctrl(audio_ctrl_t *ctrl, const char *path, u_int mode)
 {
 	int fd;
 	audio_info_t info, format;
+	struct audio_prinfo *pr, *fpr;
+	struct stat st;
 
-	fd = open(path, O_RDONLY);
+	ctrl->file = NULL;
+	ctrl->ring = NULL;
+	ctrl->sink = 0;
+	ctrl->capture = CTRL_CAPTURE_READ;
+	if (mode == AUMODE_PLAY) {
+		if (stat(path, &st) == -1 || !S_ISCHR(st.st_mode)) {
+			return build_sink_ctrl(ctrl, path);
+		}
+	} else if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+		return build_file_ctrl(ctrl, path, mode);
+	}
+
+	fd = open(path, mode == AUMODE_PLAY ? O_WRONLY : O_RDONLY);
 	if (fd == -1) {
 		return E_CTRL_FILE_OPEN;
 	}
@@ -119,6 +325,11 @@ build_audio_ctrl(audio_ctrl_t *ctrl, const char *path, u_int mode)
 
 	/* initialize defaults */
 	if (ioctl(ctrl->fd, AUDIO_GETINFO, &info) == -1) {
+		/* a character device that is not audio(4), such as /dev/null */
+		if (mode == AUMODE_PLAY) {
+			set_sink_ctrl(ctrl, path, fd);
+			return 0;
+		}
 		return E_CTRL_GETINFO;
 	}
 	if (ioctl(ctrl->fd, AUDIO_GETFORMAT, &format) == -1) {
@@ -126,11 +337,13 @@ build_audio_ctrl(audio_ctrl_t *ctrl, const char *path, u_int mode)
 	}
 
 	/* set device to use hardware's current settings */
-	info.record.buffer_size = format.record.buffer_size;
-	info.record.sample_rate = format.record.sample_rate;
-	info.record.precision = format.record.precision;
-	info.record.channels = format.record.channels;
-	info.record.encoding = format.record.encoding;
+	pr = get_prinfo(&info, mode);
+	fpr = get_prinfo(&format, mode);
+	pr->buffer_size = fpr->buffer_size;
+	pr->sample_rate = fpr->sample_rate;
+	pr->precision = fpr->precision;
+	pr->channels = fpr->channels;
+	pr->encoding = fpr->encoding;
 
 	if (ioctl(ctrl->fd, AUDIO_SETINFO, &info) == -1) {
 		return E_CTRL_SETINFO;
@@ -140,11 +353,7 @@ build_audio_ctrl(audio_ctrl_t *ctrl, const char *path, u_int mode)
 	if (ioctl(ctrl->fd, AUDIO_GETINFO, &info) == -1) {
 		return E_CTRL_GETINFO;
 	}
-	ctrl->config.precision = info.record.precision;
-	ctrl->config.encoding = info.record.encoding;
-	ctrl->config.buffer_size = info.record.buffer_size;
-	ctrl->config.sample_rate = info.record.sample_rate;
-	ctrl->config.channels = info.record.channels;
+	set_ctrl_config(ctrl, &info);
 
 	return 0;
 }
@@ -153,16 +362,44 @@ int
 update_audio_ctrl(audio_ctrl_t *ctrl, audio_config_t cfg)
 {
 	audio_info_t info;
+	struct audio_prinfo *pr;
+
+	/* a recording's header is authoritative, raw data is what we say */
+	if (ctrl->file != NULL) {
+		if (ctrl->file->raw) {
+			if (cfg.channels > 0) ctrl->file->config.channels = cfg.channels;
+			if (cfg.encoding > 0) ctrl->file->config.encoding = cfg.encoding;
+			if (cfg.precision > 0) ctrl->file->config.precision = cfg.precision;
+			if (cfg.sample_rate > 0) ctrl->file->config.sample_rate = cfg.sample_rate;
+		}
+		if (cfg.buffer_size > 0) ctrl->file->config.buffer_size = cfg.buffer_size;
+		ctrl->config = ctrl->file->config;
+		return 0;
+	}
+
+	/* a file or pipe takes whatever it is given */
+	if (ctrl->sink) {
+		if (cfg.channels > 0) ctrl->config.channels = cfg.channels;
+		if (cfg.encoding > 0) ctrl->config.encoding = cfg.encoding;
+		if (cfg.precision > 0) ctrl->config.precision = cfg.precision;
+		if (cfg.sample_rate > 0) ctrl->config.sample_rate = cfg.sample_rate;
+		ctrl->config.buffer_size = cfg.buffer_size > 0 ?
+		    cfg.buffer_size : ctrl->config.sample_rate / 10 *
+		    ctrl->config.channels *
+		    (ctrl->config.precision / STREAM_BYTE_SIZE);
+		return 0;
+	}
 
 	if (ioctl(ctrl->fd, AUDIO_GETINFO, &info) == -1) {
 		return E_CTRL_GETINFO;
 	}
 
-	if (cfg.buffer_size > 0) info.record.buffer_size = cfg.buffer_size;
-	if (cfg.channels > 0) info.record.channels = cfg.channels;
-	if (cfg.encoding > 0) info.record.encoding = cfg.encoding;
-	if (cfg.precision > 0) info.record.precision = cfg.precision;
-	if (cfg.sample_rate > 0) info.record.sample_rate = cfg.sample_rate;
+	pr = get_prinfo(&info, ctrl->mode);
+	if (cfg.buffer_size > 0) pr->buffer_size = cfg.buffer_size;
+	if (cfg.channels > 0) pr->channels = cfg.channels;
+	if (cfg.encoding > 0) pr->encoding = cfg.encoding;
+	if (cfg.precision > 0) pr->precision = cfg.precision;
+	if (cfg.sample_rate > 0) pr->sample_rate = cfg.sample_rate;
 
 	if (ioctl(ctrl->fd, AUDIO_SETINFO, &info) == -1) {
 		return E_CTRL_SETINFO;
@@ -172,11 +409,29 @@ update_audio_ctrl(audio_ctrl_t *ctrl, audio_config_t cfg)
 	if (ioctl(ctrl->fd, AUDIO_GETINFO, &info) == -1) {
 		return E_CTRL_GETINFO;
 	}
-	ctrl->config.precision = info.record.precision;
-	ctrl->config.encoding = info.record.encoding;
-	ctrl->config.buffer_size = info.record.buffer_size;
-	ctrl->config.sample_rate = info.record.sample_rate;
-	ctrl->config.channels = info.record.channels;
+	set_ctrl_config(ctrl, &info);
 
 	return 0;
 }
+
+/*
+ * Close the device, file or pipe of an audio controller
+ *
+ * Playback to a device is drained first so the last samples are heard.
+ */
+void
+close_audio_ctrl(audio_ctrl_t *ctrl)
+{
+	if (ctrl->mode == AUMODE_PLAY && !ctrl->sink && ctrl->fd != -1) {
+		ioctl(ctrl->fd, AUDIO_DRAIN);
+	}
+	unmap_audio_ctrl(ctrl);
+	if (ctrl->file != NULL) {
+		close_audio_file(ctrl->file);
+		free(ctrl->file);
+		ctrl->file = NULL;
+	} else if (ctrl->fd != -1) {
+		close(ctrl->fd);
+	}
+	ctrl->fd = -1;
+}
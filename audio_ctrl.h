@@ -31,9 +31,14 @@
 
 #include <sys/audioio.h>
 
+#include <time.h>
+
 #define CTRL_CFG_PAUSE 1
 #define CTRL_CFG_PLAY 0
 
+#define CTRL_CAPTURE_READ 0 /* frames are read(2) into a buffer */
+#define CTRL_CAPTURE_MMAP 1 /* frames are sliced out of the mapped ring */
+
 typedef struct audio_config_t {
 	u_int buffer_size; /* size of the audio device buffer in bytes */
 	u_int channels;    /* number of channels for the audio device */
@@ -42,16 +47,44 @@ typedef struct audio_config_t {
 	u_int sample_rate; /* number of samples per second */
 } audio_config_t;
 
+struct audio_file_t;
+
+/*
+ * The record ring buffer of the driver, mapped into our address space
+ *
+ * The driver writes the ring and advances its byte counter, we consume
+ * frames behind it. For recordings the mapping of the file stands in for the
+ * ring and a clock stands in for the driver.
+ */
+typedef struct audio_ring_t {
+	const u_char *base;    /* start of the ring */
+	size_t size;           /* size of the ring in bytes */
+	u_long produced;       /* bytes written by the driver */
+	u_long consumed;       /* bytes handed out as frames */
+	u_int counter;         /* last byte counter seen from the driver */
+	u_int byte_rate;       /* bytes per second (recordings) */
+	struct timespec start; /* time the clock started (recordings) */
+} audio_ring_t;
+
 typedef struct audio_ctrl_t {
 	int fd;                /* file descriptor to the audio device */
 	u_int mode;            /* record vs play */
 	audio_config_t config; /* the configuration of the audio device */
 	const char *path;            /* the path to the audio device */
+	u_int blocksize;       /* size of a device block in bytes */
+	struct audio_file_t *file; /* mapped recording, NULL for devices */
+	int sink;              /* playing into a file or pipe, not a device */
+	u_int capture;         /* CTRL_CAPTURE_READ or CTRL_CAPTURE_MMAP */
+	audio_ring_t *ring;    /* mapped ring, NULL unless CTRL_CAPTURE_MMAP */
 } audio_ctrl_t;
 
 int build_audio_ctrl(audio_ctrl_t *ctrl, const char *path, u_int mode);
 int update_audio_ctrl(audio_ctrl_t *ctrl, audio_config_t config);
+void close_audio_ctrl(audio_ctrl_t *ctrl);
 const char *get_encoding_name(u_int encoding);
 const char *get_mode(audio_ctrl_t ctrl);
+const char *get_capture_name(audio_ctrl_t ctrl);
+int map_audio_ctrl(audio_ctrl_t *ctrl);
+void unmap_audio_ctrl(audio_ctrl_t *ctrl);
 
 #endif
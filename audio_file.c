@@ -0,0 +1,319 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audio_ctrl.h"
+#include "audio_file.h"
+#include "error_codes.h"
+
+#define RIFF_HEADER_SIZE 12
+#define RIFF_CHUNK_SIZE 8
+
+/* KSDATAFORMAT_SUBTYPE_PCM, the SubFormat of extensible integer PCM */
+static const u_char subtype_pcm[16] = {
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+	0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71
+};
+
+static inline uint16_t
+read_le16(const u_char *p)
+{
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t
+read_le32(const u_char *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+	    (uint32_t)p[3] << 24;
+}
+
+/*
+ * Parse the RIFF/WAVE header of a mapped file
+ *
+ * Walks the chunk list looking for "fmt " and "data". Only integer PCM is
+ * supported. 8 bit WAV samples are unsigned, everything wider is signed
+ * little endian.
+ */
+static int
+parse_wav(audio_file_t *file)
+{
+	const u_char *p, *end, *chunk;
+	uint32_t size;
+	uint16_t format;
+	int have_fmt;
+
+	p = file->map + RIFF_HEADER_SIZE;
+	end = file->map + file->map_size;
+	have_fmt = 0;
+
+	while (p + RIFF_CHUNK_SIZE <= end) {
+		size = read_le32(p + 4);
+		chunk = p + RIFF_CHUNK_SIZE;
+		if ((size_t)(end - chunk) < size) {
+			/* truncated recordings still have usable data */
+			size = (uint32_t)(end - chunk);
+		}
+
+		if (memcmp(p, "fmt ", 4) == 0) {
+			if (size < 16) {
+				return E_FILE_FORMAT;
+			}
+			format = read_le16(chunk);
+			if (format != WAV_FORMAT_PCM &&
+			    format != WAV_FORMAT_EXTENSIBLE) {
+				return E_FREQ_UNSUPPORTED_ENCODING;
+			}
+			/* extensible files name their encoding in SubFormat */
+			if (format == WAV_FORMAT_EXTENSIBLE &&
+			    (size < WAV_EXTENSIBLE_SIZE ||
+			    memcmp(chunk + WAV_SUBFORMAT_OFFSET, subtype_pcm,
+			    sizeof(subtype_pcm)) != 0)) {
+				return E_FREQ_UNSUPPORTED_ENCODING;
+			}
+			file->config.channels = read_le16(chunk + 2);
+			file->config.sample_rate = read_le32(chunk + 4);
+			file->config.precision = read_le16(chunk + 14);
+			file->config.encoding = file->config.precision == 8 ?
+			    AUDIO_ENCODING_ULINEAR_LE :
+			    AUDIO_ENCODING_SLINEAR_LE;
+			have_fmt = 1;
+		} else if (memcmp(p, "data", 4) == 0) {
+			if (!have_fmt) {
+				return E_FILE_FORMAT;
+			}
+			file->data_offset = (size_t)(chunk - file->map);
+			file->data_size = size;
+			return 0;
+		}
+
+		/* chunks are padded to an even size */
+		p = chunk + size + (size & 1);
+	}
+
+	return E_FILE_FORMAT;
+}
+
+/*
+ * Memory-map a WAV or raw recording
+ *
+ * Files that do not start with a RIFF/WAVE header are treated as raw sample
+ * data in the format described by fallback. Unset fields of the fallback use
+ * the DEFAULT_RAW_* values.
+ *
+ * The mapping is read-only and nothing is ever copied out of it: the pcm
+ * conversion reads samples straight from the mapped pages. Access is
+ * sequential, so the kernel is asked to read ahead aggressively.
+ */
+int
+open_audio_file(audio_file_t *file, const char *path, audio_config_t fallback)
+{
+	int res;
+	struct stat st;
+
+	memset(file, 0, sizeof(*file));
+	file->path = path;
+	file->fd = open(path, O_RDONLY);
+	if (file->fd == -1) {
+		return E_CTRL_FILE_OPEN;
+	}
+
+	if (fstat(file->fd, &st) == -1 || st.st_size <= 0) {
+		res = E_FILE_FORMAT;
+		goto fail;
+	}
+
+	file->map_size = (size_t)st.st_size;
+	file->map = mmap(NULL, file->map_size, PROT_READ, MAP_PRIVATE | MAP_FILE,
+	    file->fd, 0);
+	if (file->map == MAP_FAILED) {
+		file->map = NULL;
+		res = E_FILE_MMAP;
+		goto fail;
+	}
+	madvise(file->map, file->map_size, MADV_SEQUENTIAL);
+
+	if (file->map_size >= RIFF_HEADER_SIZE &&
+	    memcmp(file->map, "RIFF", 4) == 0 &&
+	    memcmp(file->map + 8, "WAVE", 4) == 0) {
+		if ((res = parse_wav(file)) != 0) {
+			goto fail;
+		}
+	} else {
+		file->raw = 1;
+		file->data_offset = 0;
+		file->data_size = file->map_size;
+		file->config.channels = fallback.channels > 0 ?
+		    fallback.channels : DEFAULT_RAW_CHANNELS;
+		file->config.sample_rate = fallback.sample_rate > 0 ?
+		    fallback.sample_rate : DEFAULT_RAW_SAMPLE_RATE;
+		file->config.precision = fallback.precision > 0 ?
+		    fallback.precision : DEFAULT_RAW_PRECISION;
+		file->config.encoding = fallback.encoding > 0 ?
+		    fallback.encoding : DEFAULT_RAW_ENCODING;
+	}
+
+	if (file->config.channels == 0 || file->config.sample_rate == 0) {
+		res = E_FILE_FORMAT;
+		goto fail;
+	}
+	file->config.buffer_size = file->data_size > UINT_MAX ?
+	    UINT_MAX : (u_int)file->data_size;
+
+	return 0;
+fail:
+	close_audio_file(file);
+	return res;
+}
+
+/*
+ * Unmap and close a recording
+ */
+void
+close_audio_file(audio_file_t *file)
+{
+	if (file->map != NULL) {
+		munmap(file->map, file->map_size);
+		file->map = NULL;
+	}
+	if (file->fd != -1) {
+		close(file->fd);
+		file->fd = -1;
+	}
+}
+
+/*
+ * Drop the pages of an already analyzed range of the sample data
+ *
+ * The pages are clean file-backed pages, so they are simply discarded and the
+ * resident size stays flat no matter how large the recording is. Only pages
+ * entirely inside the range are released.
+ */
+void
+release_file_range(audio_file_t *file, size_t offset, size_t size)
+{
+	uintptr_t start, end, page;
+
+	page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	start = (uintptr_t)(file->map + file->data_offset + offset);
+	end = start + size;
+	start = (start + page - 1) & ~(page - 1);
+	end = end & ~(page - 1);
+
+	if (end > start) {
+		madvise((void *)start, end - start, MADV_DONTNEED);
+	}
+}
+
+/*
+ * Sleep until the current frame is due so that playback runs in real time
+ *
+ * If the caller fell more than a frame behind (e.g. while another screen was
+ * shown) the clock is restarted instead of rushing to catch up.
+ */
+static void
+pace_file(audio_file_t *file, u_int milliseconds)
+{
+	struct timespec now, due;
+	long long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (file->nframes == 0) {
+		file->start = now;
+	}
+
+	ns = (long long)file->nframes * milliseconds * 1000000LL;
+	due.tv_sec = file->start.tv_sec + (time_t)(ns / 1000000000LL);
+	due.tv_nsec = file->start.tv_nsec + (long)(ns % 1000000000LL);
+	if (due.tv_nsec >= 1000000000L) {
+		due.tv_sec++;
+		due.tv_nsec -= 1000000000L;
+	}
+
+	ns = (long long)(due.tv_sec - now.tv_sec) * 1000000000LL +
+	    (due.tv_nsec - now.tv_nsec);
+	if (ns > 0) {
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+	} else if (-ns > (long long)milliseconds * 1000000LL) {
+		file->start = now;
+		file->nframes = 0;
+	}
+	file->nframes++;
+}
+
+/*
+ * Get the next frame of a recording without copying it
+ *
+ * frame points into the mapping and stays valid until the next call.
+ * Playback loops back to the start once less than a frame is left.
+ */
+int
+next_file_frame(audio_file_t *file, size_t size, u_int milliseconds,
+    const u_char **frame)
+{
+	uintptr_t next, page;
+	size_t prev;
+
+	if (size == 0 || size > file->data_size) {
+		return E_FILE_FORMAT;
+	}
+
+	prev = file->position;
+	if (file->position + size > file->data_size) {
+		file->position = 0;
+	}
+
+	/* the previous frame has been consumed by now */
+	if (prev >= size) {
+		release_file_range(file, prev - size, size);
+	}
+
+	pace_file(file, milliseconds);
+
+	*frame = file->map + file->data_offset + file->position;
+	file->position += size;
+
+	/* start reading in the frame after this one */
+	if (file->position + size <= file->data_size) {
+		page = (uintptr_t)sysconf(_SC_PAGESIZE);
+		next = (uintptr_t)(file->map + file->data_offset +
+		    file->position);
+		madvise((void *)(next & ~(page - 1)), size + (next & (page - 1)),
+		    MADV_WILLNEED);
+	}
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+#include <sys/audioio.h>
+
+#include <time.h>
+
+#include "audio_ctrl.h"
+
+#define DEFAULT_RAW_CHANNELS 1
+#define DEFAULT_RAW_SAMPLE_RATE 48000
+#define DEFAULT_RAW_PRECISION 16
+#define DEFAULT_RAW_ENCODING AUDIO_ENCODING_SLINEAR_LE
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_EXTENSIBLE 0xfffe
+#define WAV_EXTENSIBLE_SIZE 40  /* fmt chunk up to the end of SubFormat */
+#define WAV_SUBFORMAT_OFFSET 24
+
+typedef struct audio_file_t {
+	int fd;                /* file descriptor of the recording */
+	u_char *map;           /* memory mapping of the whole file */
+	size_t map_size;       /* size of the mapping in bytes */
+	size_t data_offset;    /* offset of the first sample in the mapping */
+	size_t data_size;      /* number of bytes of sample data */
+	audio_config_t config; /* format of the sample data */
+	const char *path;      /* the path to the recording */
+	int raw;               /* no header, config is user supplied */
+	size_t position;       /* playback offset into the sample data */
+	u_int nframes;         /* frames played since start */
+	struct timespec start; /* wall clock time playback (re)started */
+} audio_file_t;
+
+int open_audio_file(audio_file_t *file, const char *path,
+    audio_config_t fallback);
+void close_audio_file(audio_file_t *file);
+int next_file_frame(audio_file_t *file, size_t size, u_int milliseconds,
+    const u_char **frame);
+void release_file_range(audio_file_t *file, size_t offset, size_t size);
+
+#endif
@@ -26,12 +26,21 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#include <sys/audioio.h>
+#include <sys/ioctl.h>
+
+#include <sys/uio.h>
+
+#include <errno.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "auconv.h"
 #include "audio_ctrl.h"
+#include "audio_file.h"
 #include "audio_stream.h"
 #include "error_codes.h"
 
@@ -87,6 +96,8 @@ build_stream(u_int milliseconds, u_int channels, u_int sample_rate,
 	stream->total_samples = (u_int)samples_needed;
 	stream->precision = precision;
 	stream->total_size = 0;
+	stream->read_size = buffer_size;
+	stream->stats = NULL;
 
 	i = (u_int)samples_needed;
 	while (i > 0) {
@@ -106,27 +117,353 @@ build_stream(u_int milliseconds, u_int channels, u_int sample_rate,
 int
 stream(audio_ctrl_t ctrl, audio_stream_t stream, u_char *data)
 {
-	u_int i, ns;
+	struct iovec iov;
+
+	iov.iov_base = data;
+	iov.iov_len = stream.total_size;
+	return stream_iov(ctrl, stream, &iov, 1);
+}
+
+/*
+ * Record or Play until every byte of iov was transferred
+ *
+ * iov may describe several segments, e.g. the two halves of a ring buffer
+ * that wraps, which are filled by a single readv(2). Each call transfers at
+ * most stream.read_size bytes. Calls may transfer less than requested; the
+ * remainder is picked up by the next call.
+ */
+int
+stream_iov(audio_ctrl_t ctrl, audio_stream_t stream, const struct iovec *iov,
+    int iovcnt)
+{
+	struct iovec part[STREAM_MAX_IOV];
+	size_t limit, skip, want, left;
 	ssize_t io_count;
-	io_count = 0;
+	int i, n;
+
+	limit = stream.read_size > 0 ? stream.read_size : SIZE_MAX;
+
+	/* skip is how far into iov[i] the transfer has come */
+	i = 0;
+	skip = 0;
+	while (i < iovcnt) {
+		/* gather up to read_size bytes starting at iov[i] + skip */
+		want = 0;
+		for (n = 0; n < STREAM_MAX_IOV && i + n < iovcnt &&
+		    want < limit; n++) {
+			part[n].iov_base = (u_char *)iov[i + n].iov_base +
+			    (n == 0 ? skip : 0);
+			part[n].iov_len = iov[i + n].iov_len - (n == 0 ? skip : 0);
+			if (part[n].iov_len > limit - want) {
+				part[n].iov_len = limit - want;
+			}
+			want += part[n].iov_len;
+		}
 
-	for (i = 0; i < stream.total_size; i++) {
-		/* the size of the buffer or whats left */
-		ns = (u_int)fminf((float)ctrl.config.buffer_size,
-		    (float)(stream.total_size - i));
 		if (ctrl.mode == AUMODE_RECORD) {
-			io_count = read(ctrl.fd, data, ns);
+			io_count = readv(ctrl.fd, part, n);
 		} else {
-			io_count = write(ctrl.fd, data, ns);
+			io_count = writev(ctrl.fd, part, n);
 		}
 
-		if (io_count < 0) {
+		if (io_count < 0 && errno == EINTR) {
+			continue;
+		}
+		if (io_count <= 0) {
 			return E_STREAM_IO_ERROR;
 		}
 
-		i += ns;
-		data += ns;
+		if (stream.stats != NULL) {
+			stream.stats->nreads++;
+			stream.stats->nbytes += (u_long)io_count;
+			if ((size_t)io_count < want) {
+				stream.stats->nshort++;
+			}
+		}
+
+		/* advance past what was transferred */
+		left = (size_t)io_count;
+		while (left > 0 && i < iovcnt) {
+			if (left < iov[i].iov_len - skip) {
+				skip += left;
+				left = 0;
+			} else {
+				left -= iov[i].iov_len - skip;
+				skip = 0;
+				i++;
+			}
+		}
+		/* step over empty segments */
+		while (i < iovcnt && iov[i].iov_len == skip) {
+			skip = 0;
+			i++;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Pick the device buffer size and the read size of a stream
+ *
+ * Fewer, larger reads cost fewer system calls, but a read that asks for more
+ * than the device buffer holds risks an overrun while it waits. So the device
+ * buffer is grown to hold nframes frames, at least STREAM_BUFFER_FRAMES,
+ * letting capture pause while a frame is transformed, and each read asks for
+ * as much of the frame as fits in half of that buffer. Both are multiples of
+ * the device block size. Recordings are left alone.
+ *
+ * A mapped ring is read in place, so it must also hold every frame still
+ * being worked on when the driver moves on.
+ */
+int
+tune_stream(audio_ctrl_t *ctrl, audio_stream_t *stream, u_int nframes)
+{
+	u_int block, want, read_size;
+	int res;
+	audio_config_t cfg = { 0, 0, 0, 0, 0 };
+
+	if (ctrl->file != NULL) {
+		stream->read_size = stream->total_size;
+		return 0;
+	}
+
+	block = ctrl->blocksize > 0 ? ctrl->blocksize : 1;
+	if (nframes < STREAM_BUFFER_FRAMES) {
+		nframes = STREAM_BUFFER_FRAMES;
+	}
+	want = stream->total_size * nframes;
+	want = (want + block - 1) / block * block;
+	if (want > STREAM_MAX_BUFFER) {
+		want = STREAM_MAX_BUFFER / block * block;
+	}
+
+	if (want > ctrl->config.buffer_size) {
+		cfg.buffer_size = want;
+		if ((res = update_audio_ctrl(ctrl, cfg)) != 0) {
+			return res;
+		}
+	}
+
+	block = ctrl->blocksize > 0 ? ctrl->blocksize : 1;
+	read_size = ctrl->config.buffer_size / 2 / block * block;
+	if (read_size < block) {
+		read_size = block;
+	}
+	if (read_size > stream->total_size) {
+		read_size = stream->total_size;
+	}
+	stream->read_size = read_size;
+
+	return 0;
+}
+
+/*
+ * Ask the driver whether it had to drop samples since the last frame
+ *
+ * The driver stamps every byte it records: per audio(4), record.samples of
+ * AUDIO_GETINFO, like the samples of AUDIO_GETIOFFS, is a count of bytes,
+ * and record.seek the bytes still waiting in its buffer. Whatever it
+ * recorded that was neither read by us nor is still waiting was dropped.
+ * The first call assumes nothing was dropped before it.
+ */
+static void
+check_overrun(audio_ctrl_t ctrl, audio_stream_t audio_stream)
+{
+	u_int bytes_per_sample, recorded, consumed;
+	stream_stats_t *stats;
+	audio_info_t info;
+
+	stats = audio_stream.stats;
+	if (ioctl(ctrl.fd, AUDIO_GETINFO, &info) == -1) {
+		return;
+	}
+
+	bytes_per_sample = audio_stream.precision / STREAM_BYTE_SIZE;
+	consumed = (u_int)stats->nbytes + info.record.seek;
+	if (!stats->primed) {
+		stats->base = info.record.samples - consumed;
+		stats->primed = 1;
+	}
+
+	if (info.record.error) {
+		stats->noverruns++;
+	}
+
+	recorded = info.record.samples - stats->base;
+	if (recorded > consumed) {
+		stats->dropped = (recorded - consumed) / bytes_per_sample;
+	}
+}
+
+/*
+ * Fraction of the recorded samples that were dropped by the driver
+ */
+float
+drop_rate(stream_stats_t stats, u_int precision)
+{
+	double read_samples;
+
+	read_samples = (double)stats.nbytes / (precision / STREAM_BYTE_SIZE);
+	if (stats.dropped == 0) {
+		return 0.0f;
+	}
+	return (float)(stats.dropped / (stats.dropped + read_samples));
+}
+
+/*
+ * Bring the driver's byte counter of a mapped ring up to date
+ *
+ * For recordings the counter follows the wall clock instead, rounded down to
+ * whole sample frames.
+ */
+static int
+update_ring(audio_ctrl_t ctrl, u_int align)
+{
+	audio_offset_t ofs;
+	audio_ring_t *ring;
+	struct timespec now;
+	double seconds;
+
+	ring = ctrl.ring;
+	if (ctrl.file != NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		seconds = (double)(now.tv_sec - ring->start.tv_sec) +
+		    (double)(now.tv_nsec - ring->start.tv_nsec) / 1e9;
+		ring->produced = (u_long)(seconds * ring->byte_rate);
+		ring->produced -= ring->produced % align;
+		return 0;
+	}
+
+	if (ioctl(ctrl.fd, AUDIO_GETIOFFS, &ofs) == -1) {
+		return E_STREAM_IO_ERROR;
+	}
+	/* the driver's byte stamp, see check_overrun(), is 32 bits and wraps */
+	ring->produced += (u_int)(ofs.samples - ring->counter);
+	ring->counter = ofs.samples;
+	return 0;
+}
+
+/*
+ * Slice the next frame out of the mapped ring without copying it
+ *
+ * Waits until the driver has written a whole frame past the last one. If the
+ * driver lapped us, the overwritten samples are counted as dropped and
+ * capture resumes with the oldest intact data. The frame stays valid until
+ * the driver laps it again, so the ring must hold the frames the caller may
+ * keep in flight and one more being written.
+ */
+static int
+stream_ring(audio_ctrl_t ctrl, audio_stream_t audio_stream,
+    stream_frame_t *frame)
+{
+	u_int bytes_per_sample;
+	u_long avail, lost;
+	size_t size, start, first;
+	long long wait_ns;
+	int res;
+	audio_ring_t *ring;
+	struct timespec ts;
+
+	ring = ctrl.ring;
+	size = audio_stream.total_size;
+	bytes_per_sample = audio_stream.precision / STREAM_BYTE_SIZE;
+	if (size > ring->size) {
+		return E_STREAM_IO_ERROR;
+	}
+
+	for (;;) {
+		res = update_ring(ctrl, bytes_per_sample * audio_stream.channels);
+		if (res != 0) {
+			return res;
+		}
+
+		avail = ring->produced - ring->consumed;
+		if (avail > ring->size) {
+			lost = avail - ring->size;
+			ring->consumed += lost;
+			avail = ring->size;
+			if (audio_stream.stats != NULL) {
+				audio_stream.stats->noverruns++;
+				audio_stream.stats->dropped += lost / bytes_per_sample;
+			}
+		}
+		if (avail >= size) {
+			break;
+		}
+
+		/* sleep until the rest of the frame should be there */
+		wait_ns = (long long)(size - avail) * audio_stream.milliseconds *
+		    1000000LL / audio_stream.total_size;
+		ts.tv_sec = (time_t)(wait_ns / 1000000000LL);
+		ts.tv_nsec = (long)(wait_ns % 1000000000LL);
+		nanosleep(&ts, NULL);
+	}
+
+	start = ring->consumed % ring->size;
+	first = ring->size - start < size ? ring->size - start : size;
+	frame->iov[0].iov_base = (void *)(uintptr_t)(ring->base + start);
+	frame->iov[0].iov_len = first;
+	frame->iovcnt = 1;
+	if (first < size) {
+		frame->iov[1].iov_base = (void *)(uintptr_t)ring->base;
+		frame->iov[1].iov_len = size - first;
+		frame->iovcnt = 2;
+	}
+	ring->consumed += size;
+
+	if (audio_stream.stats != NULL) {
+		audio_stream.stats->nframes++;
+		audio_stream.stats->nbytes += size;
+	}
+	return 0;
+}
+
+/*
+ * Capture the next frame of the audio stream
+ *
+ * Devices are read into data. Recordings and mapped rings are handed out
+ * straight from their mapping without touching data, which may be NULL for
+ * them. Either way frame describes audio_stream.total_size bytes of samples
+ * afterwards, in at most two segments.
+ *
+ * If the stream has stats, they are updated and the driver is checked for
+ * overruns after every frame.
+ */
+int
+stream_frame(audio_ctrl_t ctrl, audio_stream_t audio_stream, u_char *data,
+    stream_frame_t *frame)
+{
+	const u_char *mapped;
+	int res;
+
+	if (ctrl.capture == CTRL_CAPTURE_MMAP) {
+		return stream_ring(ctrl, audio_stream, frame);
+	}
+
+	frame->iovcnt = 1;
+	frame->iov[0].iov_len = audio_stream.total_size;
+
+	if (ctrl.file != NULL) {
+		res = next_file_frame(ctrl.file, audio_stream.total_size,
+		    audio_stream.milliseconds, &mapped);
+		if (res == 0 && audio_stream.stats != NULL) {
+			audio_stream.stats->nframes++;
+			audio_stream.stats->nbytes += audio_stream.total_size;
+		}
+		frame->iov[0].iov_base = (void *)(uintptr_t)mapped;
+		return res;
 	}
 
+	if ((res = stream(ctrl, audio_stream, data)) != 0) {
+		return res;
+	}
+	if (audio_stream.stats != NULL) {
+		audio_stream.stats->nframes++;
+		if (ctrl.mode == AUMODE_RECORD) {
+			check_overrun(ctrl, audio_stream);
+		}
+	}
+	frame->iov[0].iov_base = data;
 	return 0;
 }
@@ -29,9 +29,33 @@
 #ifndef AUDIO_STREAM_H
 #define AUDIO_STREAM_H
 
+#include <sys/uio.h>
+
 #include "audio_ctrl.h"
 
 #define STREAM_BYTE_SIZE 8
+#define STREAM_MAX_IOV 4
+#define STREAM_BUFFER_FRAMES 2 /* frames the device buffer must hold */
+#define STREAM_MAX_BUFFER (1024 * 1024)
+
+typedef struct stream_stats_t {
+	u_long nframes;    /* frames streamed */
+	u_long nreads;     /* read(2) or write(2) calls */
+	u_long nshort;     /* calls that transferred less than requested */
+	u_long nbytes;     /* bytes transferred */
+	u_long noverruns;  /* frames after which the driver flagged an error */
+	u_long dropped;    /* samples the driver recorded that were never read */
+	u_int base;        /* driver byte stamp when nothing was read yet */
+	int primed;        /* base is valid */
+} stream_stats_t;
+
+/*
+ * A captured frame, split in two where it wraps around a ring buffer
+ */
+typedef struct stream_frame_t {
+	struct iovec iov[2];
+	int iovcnt;
+} stream_frame_t;
 
 typedef struct audios_stream_t {
 	u_int channels;      /* number of channels on the audio device */
@@ -40,6 +64,8 @@ typedef struct audios_stream_t {
 	u_int total_size;    /* total memory size of all buffers */
 	u_int total_samples; /* total number of samples across all buffers */
 	u_int encoding;      /* the encoding of the audio device */
+	u_int read_size;     /* bytes requested per read(2) or write(2) */
+	stream_stats_t *stats; /* counters updated while streaming, or NULL */
 } audio_stream_t;
 
 int build_stream(u_int milliseconds, u_int channels, u_int sample_rate,
@@ -47,4 +73,10 @@ int build_stream(u_int milliseconds, u_int channels, u_int sample_rate,
 
 int build_stream_from_ctrl(audio_ctrl_t ctrl, u_int ms, audio_stream_t *stream);
 int stream(audio_ctrl_t ctrl, audio_stream_t stream, u_char *data);
+int stream_iov(audio_ctrl_t ctrl, audio_stream_t stream,
+    const struct iovec *iov, int iovcnt);
+int tune_stream(audio_ctrl_t *ctrl, audio_stream_t *stream, u_int nframes);
+int stream_frame(audio_ctrl_t ctrl, audio_stream_t audio_stream, u_char *data,
+    stream_frame_t *frame);
+float drop_rate(stream_stats_t stats, u_int precision);
 #endif
@@ -0,0 +1,107 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+
+#include "bars.h"
+#include "fft.h"
+
+/*
+ * Reset the bars back to their initial states
+ *
+ * Each bar is logarithmically spaced apart, meaning the frequency range of the
+ * bar increases with each one. This should provide more granular detail for
+ * the human audio spectrum.
+ */
+int
+reset_bars(bar_t *bars, u_int nbars, fft_config_t fft_config)
+{
+	u_int i;
+	for (i = 0; i < nbars; i++) {
+		float frac_start = (float)i / (float)nbars;
+		float frac_end = (float)(i + 1) / (float)nbars;
+		bars[i].fmin =
+		    fft_config.fmin *
+		    powf(fft_config.fmax / fft_config.fmin, frac_start);
+		bars[i].fmax =
+		    fft_config.fmin *
+		    powf(fft_config.fmax / fft_config.fmin, frac_end);
+		bars[i].magnitude = 0.0f;
+		bars[i].nbins = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Attribute each bin to the corresponding bar
+ */
+int
+fill_bars(bar_t *bars, u_int nbars, bin_t *bins, fft_config_t fft_config)
+{
+	u_int i, j;
+	float freq;
+
+	for (i = 0; i < fft_config.nbins; i++) {
+		freq = bins[i].frequency;
+		for (j = 0; j < nbars; j++) {
+			if (freq >= bars[j].fmin && freq < bars[j].fmax) {
+				bars[j].magnitude += bins[i].magnitude;
+				bars[j].nbins += 1;
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+const char *
+get_transform_name(u_int transform)
+{
+	switch (transform) {
+	case BARS_FFT:
+		return "fft";
+	case BARS_CQT:
+		return "cqt";
+	case BARS_MEL:
+		return "mel";
+	case BARS_BARK:
+		return "bark";
+	case BARS_WELCH:
+		return "welch";
+	case BARS_TRACK:
+		return "track";
+	case BARS_ZOOM:
+		return "zoom";
+	case BARS_MULTIRES:
+		return "multires";
+	default:
+		return NULL;
+	}
+}
@@ -0,0 +1,57 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_BARS_H
+#define AUDIO_BARS_H
+
+#include <sys/types.h>
+
+#include "fft.h"
+
+#define BARS_FFT 0 /* bars group linear fft bins */
+#define BARS_CQT 1 /* bars are constant-Q filters, see cqt.c */
+#define BARS_MEL 2 /* bars are mel filters, see filterbank.c */
+#define BARS_BARK 3 /* bars are Bark filters, see filterbank.c */
+#define BARS_WELCH 4 /* bars are Welch densities, see welch.c */
+#define BARS_TRACK 5 /* bars are tracked frequencies, see tracker.c */
+#define BARS_ZOOM 6 /* bars group bins of a zoom fft, see zoom.c */
+#define BARS_MULTIRES 7 /* bars group bins of several ffts, see multires.c */
+
+typedef struct bar_t {
+	float fmin;  /* minimum frequency of the bar */
+	float fmax;  /* maximum frequency of the bar */
+	u_int nbins; /* number of bins represented in the bar */
+	float
+	    magnitude; /* sum of all amplitudes of all bins within frequency */
+} bar_t;
+
+int reset_bars(bar_t *bars, u_int nbars, fft_config_t fft_config);
+int fill_bars(bar_t *bars, u_int nbars, bin_t *bins, fft_config_t fft_config);
+const char *get_transform_name(u_int transform);
+
+#endif
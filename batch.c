@@ -0,0 +1,378 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/types.h>
+
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_file.h"
+#include "audio_stream.h"
+#include "batch.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "pcm.h"
+
+typedef struct batch_job_t {
+	audio_file_t *file;      /* the mapped recording */
+	audio_stream_t chunk;    /* layout of a single interval */
+	fft_config_t fft_config; /* fft of a single interval */
+	u_int kind;              /* BATCH_SPECTRA or BATCH_STATS */
+	u_int nchunks;           /* number of intervals in the recording */
+	u_int next;              /* next interval to hand out */
+	int out_fd;              /* output file */
+	pthread_mutex_t lock;    /* protects next */
+} batch_job_t;
+
+typedef struct batch_worker_t {
+	pthread_t thread;
+	batch_job_t *job;
+	float *pcm;    /* normalized samples of the current interval */
+	bin_t *bins;   /* spectrum of the current interval */
+	cplx *scratch; /* scratch space of fft() */
+	float *row;    /* output row of the current interval */
+	float *min;    /* per bin minimum (BATCH_STATS) */
+	float *max;    /* per bin maximum (BATCH_STATS) */
+	double *sum;   /* per bin sum (BATCH_STATS) */
+	double *sumsq; /* per bin sum of squares (BATCH_STATS) */
+	u_int count;   /* intervals analyzed by this worker */
+	int res;       /* first error hit by this worker */
+} batch_worker_t;
+
+/*
+ * Hand out the next interval to analyze
+ */
+static u_int
+next_chunk(batch_job_t *job)
+{
+	u_int idx;
+
+	pthread_mutex_lock(&job->lock);
+	idx = job->next;
+	if (job->next < job->nchunks) {
+		job->next++;
+	}
+	pthread_mutex_unlock(&job->lock);
+
+	return idx;
+}
+
+/*
+ * Worker thread. Converts and transforms intervals until none are left.
+ *
+ * Samples are converted straight from the mapping and the pages of an interval
+ * are dropped as soon as it is converted, so the resident size does not grow
+ * with the recording.
+ *
+ * Intervals are independent, so spectra rows are written straight to their
+ * final position in the output file and statistics are kept per worker until
+ * every worker is done.
+ */
+static void *
+batch_worker(void *arg)
+{
+	u_int i, idx, nbins;
+	const u_char *data;
+	off_t offset;
+	size_t row_size;
+	float m;
+	batch_worker_t *w;
+	batch_job_t *job;
+
+	w = arg;
+	job = w->job;
+	nbins = job->fft_config.nbins;
+	row_size = sizeof(float) * nbins;
+
+	while ((idx = next_chunk(job)) < job->nchunks) {
+		data = job->file->map + job->file->data_offset +
+		    (size_t)idx * job->chunk.total_size;
+
+		w->res = to_normalized_pcm(job->chunk, data, w->pcm);
+		release_file_range(job->file, (size_t)idx * job->chunk.total_size,
+		    job->chunk.total_size);
+		if (w->res != 0) {
+			break;
+		}
+
+		reset_bins(w->bins, job->fft_config);
+		fft(job->fft_config, w->bins, w->pcm, w->scratch);
+
+		if (job->kind == BATCH_SPECTRA) {
+			for (i = 0; i < nbins; i++) {
+				w->row[i] = w->bins[i].magnitude;
+			}
+			offset = (off_t)sizeof(batch_header_t) +
+			    (off_t)idx * (off_t)row_size;
+			if (pwrite(job->out_fd, w->row, row_size, offset) !=
+			    (ssize_t)row_size) {
+				w->res = E_BATCH_OUTPUT;
+				break;
+			}
+		} else {
+			for (i = 0; i < nbins; i++) {
+				m = w->bins[i].magnitude;
+				w->min[i] = w->count == 0 ? m : fminf(w->min[i], m);
+				w->max[i] = w->count == 0 ? m : fmaxf(w->max[i], m);
+				w->sum[i] += m;
+				w->sumsq[i] += (double)m * m;
+			}
+		}
+		w->count++;
+	}
+
+	return NULL;
+}
+
+/*
+ * Merge the statistics of every worker and write them after the header
+ */
+static int
+write_stats(batch_job_t *job, batch_worker_t *workers, u_int nworkers)
+{
+	u_int i, k, nbins, count;
+	size_t row_size;
+	double mean, var, sum, sumsq;
+	float *rows;
+	int res;
+
+	nbins = job->fft_config.nbins;
+	row_size = sizeof(float) * nbins;
+	if ((rows = malloc(row_size * 4)) == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	for (i = 0; i < nbins; i++) {
+		count = 0;
+		sum = sumsq = 0.0;
+		for (k = 0; k < nworkers; k++) {
+			if (workers[k].count == 0) {
+				continue;
+			}
+			rows[i] = count == 0 ? workers[k].min[i] :
+			    fminf(rows[i], workers[k].min[i]);
+			rows[nbins + i] = count == 0 ? workers[k].max[i] :
+			    fmaxf(rows[nbins + i], workers[k].max[i]);
+			sum += workers[k].sum[i];
+			sumsq += workers[k].sumsq[i];
+			count += workers[k].count;
+		}
+		mean = sum / count;
+		var = sumsq / count - mean * mean;
+		rows[2 * nbins + i] = (float)mean;
+		rows[3 * nbins + i] = (float)sqrt(var > 0.0 ? var : 0.0);
+	}
+
+	res = 0;
+	if (pwrite(job->out_fd, rows, row_size * 4,
+	    (off_t)sizeof(batch_header_t)) != (ssize_t)(row_size * 4)) {
+		res = E_BATCH_OUTPUT;
+	}
+	free(rows);
+	return res;
+}
+
+static void
+free_worker(batch_worker_t *w)
+{
+	free(w->pcm);
+	free(w->bins);
+	free(w->scratch);
+	free(w->row);
+	free(w->min);
+	free(w->max);
+	free(w->sum);
+	free(w->sumsq);
+}
+
+static int
+alloc_worker(batch_worker_t *w, batch_job_t *job)
+{
+	u_int nbins;
+
+	nbins = job->fft_config.nbins;
+	memset(w, 0, sizeof(*w));
+	w->job = job;
+	w->pcm = malloc(sizeof(float) * job->chunk.total_samples);
+	w->bins = malloc(sizeof(bin_t) * nbins);
+	w->scratch = malloc(fft_scratch_size(job->fft_config));
+	if (w->pcm == NULL || w->bins == NULL || w->scratch == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	if (job->kind == BATCH_SPECTRA) {
+		w->row = malloc(sizeof(float) * nbins);
+		return w->row == NULL ? E_NO_MEMORY : 0;
+	}
+
+	w->min = malloc(sizeof(float) * nbins);
+	w->max = malloc(sizeof(float) * nbins);
+	w->sum = calloc(nbins, sizeof(double));
+	w->sumsq = calloc(nbins, sizeof(double));
+	if (w->min == NULL || w->max == NULL || w->sum == NULL ||
+	    w->sumsq == NULL) {
+		return E_NO_MEMORY;
+	}
+	return 0;
+}
+
+/*
+ * Analyze a whole recording on a pool of worker threads
+ *
+ * The recording is split into intervals of config.milliseconds, each rounded
+ * down to a multiple of nsamples so that no fft frame straddles two intervals.
+ * Trailing samples that do not fill an interval are not analyzed.
+ */
+int
+run_batch(audio_file_t *file, batch_config_t config, u_int nsamples,
+    float fmin, batch_result_t *result)
+{
+	u_int i, nworkers, nallocated, bytes_per_sample;
+	long ncpu;
+	int res;
+	batch_job_t job;
+	batch_header_t header;
+	batch_worker_t *workers;
+	struct timespec start, end;
+
+	res = build_stream(config.milliseconds, file->config.channels,
+	    file->config.sample_rate, file->config.buffer_size,
+	    file->config.precision, file->config.encoding, &job.chunk);
+	if (res != 0) {
+		return res;
+	}
+
+	res = build_fft_config(&job.fft_config, nsamples,
+	    file->config.sample_rate, job.chunk.total_samples, fmin);
+	if (res != 0) {
+		return res;
+	}
+
+	/* align the interval to whole fft frames */
+	bytes_per_sample = file->config.precision / STREAM_BYTE_SIZE;
+	job.chunk.total_samples = job.fft_config.nframes * nsamples;
+	job.chunk.total_size = job.chunk.total_samples * bytes_per_sample;
+	job.fft_config.total_samples = job.chunk.total_samples;
+
+	job.file = file;
+	job.kind = config.kind;
+	job.next = 0;
+	job.nchunks = (u_int)(file->data_size / job.chunk.total_size);
+	if (job.nchunks == 0) {
+		return E_BATCH_EMPTY;
+	}
+
+	nworkers = config.nthreads;
+	if (nworkers == 0) {
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nworkers = ncpu > 0 ? (u_int)ncpu : 1;
+	}
+	if (nworkers > job.nchunks) {
+		nworkers = job.nchunks;
+	}
+
+	job.out_fd = open(config.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (job.out_fd == -1) {
+		return E_BATCH_OUTPUT;
+	}
+
+	workers = calloc(nworkers, sizeof(batch_worker_t));
+	if (workers == NULL) {
+		close(job.out_fd);
+		return E_NO_MEMORY;
+	}
+
+	nallocated = nworkers;
+	for (i = 0; i < nworkers; i++) {
+		if ((res = alloc_worker(&workers[i], &job)) != 0) {
+			goto done;
+		}
+	}
+
+	pthread_mutex_init(&job.lock, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < nworkers; i++) {
+		if (pthread_create(&workers[i].thread, NULL, batch_worker,
+		    &workers[i]) != 0) {
+			/* let the threads that did start finish the job */
+			res = E_BATCH_THREAD;
+			nworkers = i;
+			break;
+		}
+	}
+	for (i = 0; i < nworkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (res == 0 && workers[i].res != 0) {
+			res = workers[i].res;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_mutex_destroy(&job.lock);
+
+	if (res == 0 && nworkers == 0) {
+		res = E_BATCH_THREAD;
+	}
+	if (res == 0 && config.kind == BATCH_STATS) {
+		res = write_stats(&job, workers, nworkers);
+	}
+
+	if (res == 0) {
+		memcpy(header.magic, BATCH_MAGIC, sizeof(header.magic));
+		header.version = BATCH_VERSION;
+		header.kind = config.kind;
+		header.fs = job.fft_config.fs;
+		header.nsamples = nsamples;
+		header.nbins = job.fft_config.nbins;
+		header.nintervals = job.nchunks;
+		/* the interval as rounded to whole fft frames */
+		header.interval = job.chunk.total_samples /
+		    file->config.channels;
+		if (pwrite(job.out_fd, &header, sizeof(header), 0) !=
+		    (ssize_t)sizeof(header)) {
+			res = E_BATCH_OUTPUT;
+		}
+	}
+
+	result->nintervals = job.nchunks;
+	result->nbytes = (size_t)job.nchunks * job.chunk.total_size;
+	result->seconds = (double)(end.tv_sec - start.tv_sec) +
+	    (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+done:
+	for (i = 0; i < nallocated; i++) {
+		free_worker(&workers[i]);
+	}
+	free(workers);
+	close(job.out_fd);
+	return res;
+}
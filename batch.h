@@ -0,0 +1,74 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+
+#include "audio_file.h"
+#include "fft.h"
+
+#define BATCH_MAGIC "AVSP"
+#define BATCH_VERSION 2
+
+#define BATCH_SPECTRA 0 /* one nbins row of magnitudes per interval */
+#define BATCH_STATS 1   /* min, max, mean and stddev rows per bin */
+
+/*
+ * Header of the batch output file. All fields and the float rows that
+ * follow are in host byte order.
+ */
+typedef struct batch_header_t {
+	char magic[4];       /* BATCH_MAGIC */
+	uint32_t version;    /* BATCH_VERSION */
+	uint32_t kind;       /* BATCH_SPECTRA or BATCH_STATS */
+	uint32_t fs;         /* sample rate of the recording */
+	uint32_t nsamples;   /* samples per fft */
+	uint32_t nbins;      /* floats per row */
+	uint32_t nintervals; /* number of intervals analyzed */
+	uint32_t interval;   /* sample frames of one interval, as analyzed */
+} batch_header_t;
+
+typedef struct batch_config_t {
+	const char *output; /* path of the output file */
+	u_int kind;         /* BATCH_SPECTRA or BATCH_STATS */
+	u_int nthreads;     /* number of worker threads */
+	u_int milliseconds; /* duration of one interval */
+} batch_config_t;
+
+typedef struct batch_result_t {
+	u_int nintervals; /* number of intervals analyzed */
+	size_t nbytes;    /* number of bytes of sample data analyzed */
+	double seconds;   /* wall clock time of the analysis */
+} batch_result_t;
+
+int run_batch(audio_file_t *file, batch_config_t config, u_int nsamples,
+    float fmin, batch_result_t *result);
+
+#endif
@@ -0,0 +1,885 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_ctrl.h"
+#include "audio_stream.h"
+#include "bars.h"
+#include "capture.h"
+#include "cqt.h"
+#include "decimate.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "filterbank.h"
+#include "fir.h"
+#include "meter.h"
+#include "mfcc.h"
+#include "multires.h"
+#include "pcm.h"
+#include "queue.h"
+#include "rt.h"
+#include "tracker.h"
+#include "waterfall.h"
+#include "welch.h"
+#include "zoom.h"
+
+/*
+ * Initialize an empty group of captures
+ */
+int
+build_capture_group(capture_group_t *group)
+{
+	memset(group, 0, sizeof(*group));
+	group->overlap = WELCH_OVERLAP;
+	group->decimation = 1;
+	group->features_fd = -1;
+	pthread_mutex_init(&group->lock, NULL);
+	pthread_mutex_init(&group->features_lock, NULL);
+	pthread_cond_init(&group->updated, NULL);
+	return 0;
+}
+
+/*
+ * Open a device and configure its stream and fft
+ *
+ * The bars span fmin to fmax, or to half the sample rate if fmax is 0. With
+ * a group decimation the fft runs at the decimated rate. With use_mmap the
+ * device is captured straight from its ring buffer when the driver allows
+ * it and the ring can hold every frame in flight plus the one being
+ * written.
+ */
+int
+add_capture(capture_group_t *group, const char *path, audio_config_t config,
+    u_int ms, u_int nsamples, float fmin, float fmax, int use_mmap)
+{
+	int res;
+	capture_t *c;
+
+	if (group->ncaptures >= MAX_CAPTURES) {
+		return E_CAPTURE_TOO_MANY;
+	}
+
+	c = &group->captures[group->ncaptures];
+	c->group = group;
+	c->cpu = CAPTURE_NO_CPU;
+	c->dsp_cpu = CAPTURE_NO_CPU;
+
+	if ((res = build_audio_ctrl(&c->ctrl, path, AUMODE_RECORD)) != 0) {
+		return res;
+	}
+
+	if ((res = update_audio_ctrl(&c->ctrl, config)) != 0) {
+		return res;
+	}
+
+	if ((res = build_stream_from_ctrl(c->ctrl, ms, &c->stream)) != 0) {
+		return res;
+	}
+
+	if (c->ctrl.config.sample_rate % group->decimation != 0) {
+		return E_DECIMATE_FACTOR;
+	}
+	res = build_fft_config(&c->fft_config, nsamples,
+	    c->ctrl.config.sample_rate / group->decimation,
+	    c->stream.total_samples / group->decimation, fmin);
+	if (res != 0) {
+		return res;
+	}
+	if (fmax > 0.0f) {
+		if (fmax <= fmin || fmax > c->fft_config.fmax) {
+			return E_FFT_CONFIG_FMAX;
+		}
+		c->fft_config.fmax = fmax;
+	}
+	/* mapped frames are slices of the ring, up to CAPTURE_FRAMES queued */
+	res = tune_stream(&c->ctrl, &c->stream,
+	    use_mmap ? CAPTURE_FRAMES + 1 : STREAM_BUFFER_FRAMES);
+	if (res != 0) {
+		return res;
+	}
+	c->stream.stats = &c->work_stats;
+
+	if (use_mmap) {
+		if ((res = map_audio_ctrl(&c->ctrl)) != 0) {
+			return res;
+		}
+		if (c->ctrl.ring != NULL && c->ctrl.ring->size <
+		    (CAPTURE_FRAMES + 1) * c->stream.total_size) {
+			unmap_audio_ctrl(&c->ctrl);
+		}
+	}
+
+	if (group->weighting != NULL) {
+		res = load_fir(&c->weighting, group->weighting,
+		    c->fft_config.fs);
+		if (res != 0) {
+			return res;
+		}
+	}
+
+	group->ncaptures++;
+	return 0;
+}
+
+/*
+ * Record the error that stopped a pipeline and wake the renderer
+ */
+static void
+fail(capture_t *c, int res)
+{
+	capture_group_t *group;
+
+	group = c->group;
+	pthread_mutex_lock(&group->lock);
+	c->res = res;
+	group->seq++;
+	pthread_cond_broadcast(&group->updated);
+	pthread_mutex_unlock(&group->lock);
+}
+
+/*
+ * Hand the spectrum in spectra[back] over to the renderer
+ */
+static void
+publish(capture_t *c)
+{
+	capture_group_t *group;
+
+	c->back = atomic_exchange(&c->middle, c->back | CAPTURE_FRESH) &
+	    ~(u_int)CAPTURE_FRESH;
+
+	/* the lock only orders the wakeup, the spectrum is already handed over */
+	group = c->group;
+	pthread_mutex_lock(&group->lock);
+	group->seq++;
+	pthread_cond_broadcast(&group->updated);
+	pthread_mutex_unlock(&group->lock);
+}
+
+/*
+ * Write size bytes to the feature stream of the group
+ *
+ * The records of one call go out in a single piece, so the records of
+ * several devices never interleave.
+ */
+static int
+write_features(capture_group_t *group, const void *buf, size_t size)
+{
+	ssize_t n;
+	const u_char *p;
+
+	p = buf;
+	pthread_mutex_lock(&group->features_lock);
+	while (size > 0) {
+		if ((n = write(group->features_fd, p, size)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		p += n;
+		size -= (size_t)n;
+	}
+	pthread_mutex_unlock(&group->features_lock);
+	return size == 0 ? 0 : E_FEATURES_OUTPUT;
+}
+
+/*
+ * Capture thread. Records frames of a single device into free frames until
+ * the group is stopped or the device fails.
+ */
+static void *
+capture_loop(void *arg)
+{
+	capture_t *c;
+	capture_frame_t *f;
+
+	c = arg;
+	while (atomic_load(&c->group->running)) {
+		if ((f = queue_pop(&c->free)) == NULL) {
+			break;
+		}
+		f->res = stream_frame(c->ctrl, c->stream, f->data, &f->frame);
+		f->stats = c->work_stats;
+		queue_push(&c->filled, f);
+		if (f->res != 0) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Compute the bars of the normalized samples in c->pcm
+ */
+static void
+transform(capture_t *c, bar_t *bars)
+{
+	reset_bars(bars, c->group->nbars, c->fft_config);
+	switch (c->group->transform) {
+	case BARS_CQT:
+		cqt(c->fft_config, &c->kernel, bars, c->pcm, c->scratch);
+		break;
+	case BARS_MEL:
+	case BARS_BARK:
+		fft_power(c->fft_config, c->power, c->pcm, c->scratch);
+		filterbank_bars(&c->bank, c->power, bars);
+		break;
+	case BARS_WELCH:
+		welch_psd(&c->welch, c->fft_config, c->pcm, c->power,
+		    c->scratch);
+		welch_bars(c->power, c->bins, bars, c->group->nbars,
+		    c->fft_config);
+		break;
+	case BARS_TRACK:
+		track(&c->tracker, c->pcm, c->npcm);
+		tracker_bars(&c->tracker, bars);
+		break;
+	case BARS_ZOOM:
+		zoom(&c->zoom, c->pcm, c->npcm, c->bins, c->scratch);
+		fill_bars(bars, c->group->nbars, c->bins, c->zoom.config);
+		break;
+	case BARS_MULTIRES:
+		multires(&c->multires, c->fft_config, c->pcm, c->npcm,
+		    c->scratch);
+		fill_bars(bars, c->group->nbars, c->multires.bins,
+		    c->multires.config);
+		break;
+	default:
+		reset_bins(c->bins, c->fft_config);
+		fft(c->fft_config, c->bins, c->pcm, c->scratch);
+		fill_bars(bars, c->group->nbars, c->bins, c->fft_config);
+		break;
+	}
+}
+
+/*
+ * DSP thread. Converts and transforms the frames of a single device and
+ * publishes their bars until the group is stopped or the device fails.
+ */
+static void *
+dsp_loop(void *arg)
+{
+	int res;
+	size_t size;
+	const u_char *records;
+	capture_t *c;
+	capture_frame_t *f;
+	capture_spectrum_t *s;
+
+	c = arg;
+	while (atomic_load(&c->group->running)) {
+		if ((f = queue_pop(&c->filled)) == NULL) {
+			break;
+		}
+		if ((res = f->res) == 0) {
+			res = to_metered_pcm_iov(c->stream, f->frame.iov,
+			    f->frame.iovcnt, c->pcm,
+			    c->group->meters ? &c->meter : NULL);
+		}
+		if (res != 0) {
+			fail(c, res);
+			break;
+		}
+		c->npcm = c->stream.total_samples;
+		if (c->group->decimation > 1) {
+			c->npcm = decimate(&c->decimator, c->pcm, c->npcm,
+			    c->pcm);
+		}
+		if (c->group->weighting != NULL) {
+			fir(&c->weighting, c->pcm, c->npcm);
+		}
+
+		s = &c->spectra[c->back];
+		s->stats = f->stats;
+		if (c->group->meters) {
+			meter_read(&c->meter, &s->levels);
+		}
+		queue_push(&c->free, f);
+
+		if (c->group->features_fd != -1) {
+			records = mfcc(&c->features, c->fft_config,
+			    (u_int)(c - c->group->captures), c->pcm, c->scratch,
+			    &size);
+			res = write_features(c->group, records, size);
+			if (res != 0) {
+				fail(c, res);
+				break;
+			}
+		}
+		transform(c, s->bars);
+		push_waterfall(&c->history, s->bars);
+		s->seq = ++c->seq;
+		publish(c);
+	}
+
+	return NULL;
+}
+
+/*
+ * Size of the arena the stages of the transform of one device take
+ *
+ * Every stage a device runs keeps its working state in the arena, so that
+ * it is locked with the rest and nothing is allocated once capturing starts.
+ */
+static size_t
+stage_arena_size(capture_t *c, u_int nbars)
+{
+	size_t size;
+
+	size = 0;
+	switch (c->group->transform) {
+	case BARS_CQT:
+		size += cqt_kernel_arena_size(nbars, c->fft_config);
+		break;
+	case BARS_MEL:
+		size += filterbank_arena_size(FILTERBANK_MEL, nbars,
+		    c->fft_config);
+		break;
+	case BARS_BARK:
+		size += filterbank_arena_size(FILTERBANK_BARK, nbars,
+		    c->fft_config);
+		break;
+	case BARS_WELCH:
+		size += welch_arena_size(c->fft_config);
+		break;
+	case BARS_TRACK:
+		size += tracker_arena_size(c->fft_config);
+		break;
+	case BARS_ZOOM:
+		size += zoom_arena_size(c->fft_config);
+		break;
+	case BARS_MULTIRES:
+		size += multires_arena_size(c->fft_config);
+		break;
+	}
+	if (c->group->meters) {
+		size += meter_arena_size(c->stream.channels);
+	}
+	if (c->group->decimation > 1) {
+		size += decimator_arena_size(c->group->decimation,
+		    c->stream.total_samples);
+	}
+	if (c->group->weighting != NULL) {
+		size += fir_arena_size(&c->weighting);
+	}
+	if (c->group->features_fd != -1) {
+		size += mfcc_arena_size(MFCC_BANDS, MFCC_COEFFS,
+		    c->fft_config);
+	}
+	return size;
+}
+
+/*
+ * Size of the arena that holds the buffers of every device of the group
+ */
+size_t
+capture_arena_size(capture_group_t *group, u_int nbars)
+{
+	u_int i;
+	size_t size;
+	capture_t *c;
+
+	size = 0;
+	for (i = 0; i < group->ncaptures; i++) {
+		c = &group->captures[i];
+		/* every frame on its own cache lines, they change threads */
+		size += CAPTURE_FRAMES * ARENA_ROUND(sizeof(capture_frame_t));
+		if (c->ctrl.file == NULL && c->ctrl.capture == CTRL_CAPTURE_READ) {
+			size += CAPTURE_FRAMES *
+			    ARENA_ROUND(sizeof(u_char) * c->stream.total_size);
+		}
+		size += 2 * ARENA_ROUND(sizeof(void *) * CAPTURE_FRAMES);
+		size += ARENA_ROUND(sizeof(float) * c->stream.total_samples);
+		size += ARENA_ROUND(sizeof(bin_t) * c->fft_config.nsamples);
+		size += ARENA_ROUND(sizeof(float) * c->fft_config.nbins);
+		size += ARENA_ROUND(fft_scratch_size(c->fft_config));
+		size += 3 * ARENA_ROUND(sizeof(bar_t) * nbars);
+		size += ARENA_ROUND(sizeof(uint8_t) * WATERFALL_ROWS * nbars);
+		size += stage_arena_size(c, nbars);
+	}
+	return size;
+}
+
+static int
+alloc_capture(capture_t *c, u_int nbars, arena_t *arena)
+{
+	u_int i;
+	int res;
+	void **free_slots, **filled_slots;
+	uint8_t *rows;
+	capture_frame_t *f;
+
+	for (i = 0; i < CAPTURE_FRAMES; i++) {
+		if ((f = arena_alloc(arena, sizeof(capture_frame_t))) == NULL) {
+			return E_NO_MEMORY;
+		}
+		if (c->ctrl.file == NULL &&
+		    c->ctrl.capture == CTRL_CAPTURE_READ) {
+			f->data = arena_alloc(arena,
+			    sizeof(u_char) * c->stream.total_size);
+			if (f->data == NULL) {
+				return E_NO_MEMORY;
+			}
+		}
+		c->frames[i] = f;
+	}
+	free_slots = arena_alloc(arena, sizeof(void *) * CAPTURE_FRAMES);
+	filled_slots = arena_alloc(arena, sizeof(void *) * CAPTURE_FRAMES);
+	c->pcm = arena_alloc(arena, sizeof(float) * c->stream.total_samples);
+	c->bins = arena_alloc(arena, sizeof(bin_t) * c->fft_config.nsamples);
+	c->power = arena_alloc(arena, sizeof(float) * c->fft_config.nbins);
+	c->scratch = arena_alloc(arena, fft_scratch_size(c->fft_config));
+	if (free_slots == NULL || filled_slots == NULL || c->pcm == NULL ||
+	    c->bins == NULL || c->power == NULL || c->scratch == NULL) {
+		return E_NO_MEMORY;
+	}
+	for (i = 0; i < 3; i++) {
+		c->spectra[i].bars = arena_alloc(arena, sizeof(bar_t) * nbars);
+		if (c->spectra[i].bars == NULL) {
+			return E_NO_MEMORY;
+		}
+		reset_bars(c->spectra[i].bars, nbars, c->fft_config);
+		c->spectra[i].levels.rms = METER_FLOOR;
+		c->spectra[i].levels.peak = METER_FLOOR;
+		c->spectra[i].levels.true_peak = METER_FLOOR;
+		c->spectra[i].levels.momentary = METER_FLOOR;
+		c->spectra[i].levels.short_term = METER_FLOOR;
+		c->spectra[i].levels.integrated = METER_FLOOR;
+		c->spectra[i].seq = 0;
+	}
+	c->front = 0;
+	atomic_init(&c->middle, 1);
+	c->back = 2;
+
+	res = 0;
+	switch (c->group->transform) {
+	case BARS_CQT:
+		res = build_cqt_kernel(&c->kernel, c->spectra[0].bars, nbars,
+		    c->fft_config, arena);
+		break;
+	case BARS_MEL:
+		res = build_filterbank(&c->bank, FILTERBANK_MEL, nbars,
+		    c->fft_config, arena);
+		break;
+	case BARS_BARK:
+		res = build_filterbank(&c->bank, FILTERBANK_BARK, nbars,
+		    c->fft_config, arena);
+		break;
+	case BARS_WELCH:
+		res = build_welch(&c->welch, c->group->overlap, c->fft_config,
+		    arena);
+		break;
+	case BARS_TRACK:
+		res = build_tracker(&c->tracker, c->group->track, nbars,
+		    c->fft_config, arena);
+		break;
+	case BARS_ZOOM:
+		res = build_zoom(&c->zoom, c->fft_config, arena);
+		break;
+	case BARS_MULTIRES:
+		res = build_multires(&c->multires, c->fft_config, arena);
+		break;
+	}
+	if (res != 0) {
+		return res;
+	}
+	if (c->group->meters) {
+		res = build_meter(&c->meter, c->stream.channels,
+		    c->ctrl.config.sample_rate, arena);
+		if (res != 0) {
+			return res;
+		}
+	}
+	if (c->group->decimation > 1) {
+		res = build_decimator(&c->decimator, c->group->decimation,
+		    c->stream.total_samples, arena);
+		if (res != 0) {
+			return res;
+		}
+	}
+	if (c->group->weighting != NULL) {
+		res = build_fir(&c->weighting, arena);
+		if (res != 0) {
+			return res;
+		}
+	}
+	if (c->group->features_fd != -1) {
+		res = build_mfcc(&c->features, MFCC_BANDS, MFCC_COEFFS,
+		    c->fft_config, arena);
+		if (res != 0) {
+			return res;
+		}
+	}
+
+	rows = arena_alloc(arena, sizeof(uint8_t) * WATERFALL_ROWS * nbars);
+	if (rows == NULL) {
+		return E_NO_MEMORY;
+	}
+	build_waterfall(&c->history, rows, WATERFALL_ROWS, nbars);
+
+	if ((res = build_queue(&c->free, free_slots, CAPTURE_FRAMES)) != 0) {
+		return res;
+	}
+	if ((res = build_queue(&c->filled, filled_slots, CAPTURE_FRAMES)) != 0) {
+		return res;
+	}
+	for (i = 0; i < CAPTURE_FRAMES; i++) {
+		queue_push(&c->free, c->frames[i]);
+	}
+	return 0;
+}
+
+/*
+ * Pick the cpu to pin thread i to, capture threads first, or none if no
+ * cpus were listed
+ */
+static int
+pick_cpu(rt_config_t rt, u_int i)
+{
+	if (rt.ncpus > 0) {
+		return rt.cpus[i % rt.ncpus];
+	}
+	return CAPTURE_NO_CPU;
+}
+
+/*
+ * Lock the memory of the captures and prefault the arena and the driver
+ * rings they read from
+ *
+ * Called once every buffer of the pipelines is built and before any thread
+ * starts. With devices only, the whole process is locked, so that the lock
+ * covers the stacks of the threads as well. A recording is mapped whole,
+ * and mlockall() would wire every page of it and defeat the release of what
+ * was read, so with recordings only the arena and the rings are locked.
+ * Recordings are neither locked nor prefaulted.
+ */
+static void
+lock_captures(capture_group_t *group, arena_t *arena)
+{
+	u_int i;
+	int res;
+	audio_ring_t *ring;
+
+	group->lock_all = 1;
+	for (i = 0; i < group->ncaptures; i++) {
+		if (group->captures[i].ctrl.file != NULL) {
+			group->lock_all = 0;
+		}
+	}
+	if (group->lock_all) {
+		group->lock_res = rt_lockall();
+	} else {
+		group->lock_res = rt_lock(arena->base, arena->used);
+	}
+
+	rt_prefault(arena->base, arena->used, 1);
+	group->nprefaulted = arena->used;
+	for (i = 0; i < group->ncaptures; i++) {
+		ring = group->captures[i].ctrl.ring;
+		if (ring == NULL || group->captures[i].ctrl.file != NULL) {
+			continue;
+		}
+		if (!group->lock_all && group->lock_res == 0 &&
+		    (res = rt_lock(ring->base, ring->size)) != 0) {
+			group->lock_res = res;
+		}
+		rt_prefault(ring->base, ring->size, 0);
+		group->nprefaulted += ring->size;
+	}
+}
+
+/*
+ * Start a thread and apply the scheduling asked for in rt
+ *
+ * Returns the cpu the thread was pinned to, or CAPTURE_NO_CPU.
+ */
+static int
+start_thread(capture_t *c, pthread_t *thread, void *(*loop)(void *),
+    int cpu, rt_config_t rt)
+{
+	int res;
+
+	if (pthread_create(thread, NULL, loop, c) != 0) {
+		return E_CAPTURE_THREAD;
+	}
+	c->nstarted++;
+
+	if (cpu != CAPTURE_NO_CPU && (res = rt_pin(*thread, cpu)) != 0) {
+		c->pin_res = res;
+		cpu = CAPTURE_NO_CPU;
+	}
+	if (thread == &c->thread) {
+		c->cpu = cpu;
+	} else {
+		c->dsp_cpu = cpu;
+	}
+	if (rt.priority > 0) {
+		if ((res = rt_priority(*thread, rt.priority)) == 0) {
+			c->priority = rt.priority;
+		} else {
+			c->priority = 0;
+			c->priority_res = res;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Start the capture and dsp threads of every device of the group
+ *
+ * With cpus listed in rt, each thread is pinned to the next of them,
+ * capture threads first, so a slow device cannot stall the others;
+ * otherwise the scheduler places them. With a priority in rt the threads run SCHED_FIFO. Pinning and
+ * priorities may require privileges; what was actually granted is kept in
+ * every capture and reported by print_rt_status().
+ *
+ * The buffers of every device are taken from arena, which must hold at least
+ * capture_arena_size() bytes and outlive the capture threads. With a
+ * features_fd the header of every device is written before any thread
+ * starts.
+ */
+int
+start_captures(capture_group_t *group, u_int nbars, arena_t *arena,
+    rt_config_t rt)
+{
+	u_int i;
+	int res;
+	capture_t *c;
+	mfcc_header_t header;
+
+	group->nbars = nbars;
+	atomic_store(&group->running, 1);
+	group->rt = rt;
+
+	for (i = 0; i < group->ncaptures; i++) {
+		if ((res = alloc_capture(&group->captures[i], nbars, arena)) != 0) {
+			return res;
+		}
+	}
+	if (rt.lock) {
+		lock_captures(group, arena);
+	}
+	if (group->features_fd != -1) {
+		for (i = 0; i < group->ncaptures; i++) {
+			c = &group->captures[i];
+			mfcc_header(&c->features, c->fft_config, i,
+			    group->ncaptures, &header);
+			if ((res = write_features(group, &header,
+			    sizeof(header))) != 0) {
+				return res;
+			}
+		}
+	}
+
+	res = 0;
+	for (i = 0; i < group->ncaptures && res == 0; i++) {
+		c = &group->captures[i];
+		res = start_thread(c, &c->dsp_thread, dsp_loop,
+		    pick_cpu(rt, group->ncaptures + i), rt);
+		if (res == 0) {
+			res = start_thread(c, &c->thread, capture_loop,
+			    pick_cpu(rt, i), rt);
+		}
+	}
+
+	if (res != 0) {
+		stop_captures(group);
+	}
+	return res;
+}
+
+/*
+ * Report what the scheduler and the vm system granted the pipelines
+ */
+void
+print_rt_status(FILE *fp, capture_group_t *group)
+{
+	u_int i;
+	capture_t *c;
+
+	if (group->rt.lock) {
+		if (group->lock_res == 0) {
+			fprintf(fp, "%s locked, %zu bytes of buffers "
+			    "prefaulted\n", group->lock_all ? "memory" :
+			    "buffers", group->nprefaulted);
+		} else {
+			fprintf(fp, "memory not locked: %s, %zu bytes of "
+			    "buffers prefaulted only\n",
+			    strerror(group->lock_res), group->nprefaulted);
+		}
+	}
+
+	for (i = 0; i < group->ncaptures; i++) {
+		c = &group->captures[i];
+		fprintf(fp, "%u %s:", i, c->ctrl.path);
+		if (c->cpu != CAPTURE_NO_CPU || c->dsp_cpu != CAPTURE_NO_CPU) {
+			fprintf(fp, " capture cpu %d, dsp cpu %d", c->cpu,
+			    c->dsp_cpu);
+		} else if (c->pin_res != 0) {
+			fprintf(fp, " not pinned (%s)", strerror(c->pin_res));
+		} else {
+			fprintf(fp, " not pinned");
+		}
+		if (c->priority > 0) {
+			fprintf(fp, ", SCHED_FIFO priority %d", c->priority);
+		} else if (group->rt.priority > 0) {
+			fprintf(fp, ", no realtime priority (%s)",
+			    strerror(c->priority_res));
+		}
+		fputc('\n', fp);
+	}
+}
+
+/*
+ * Stop the threads of every device and close it once they are gone
+ *
+ * The buffers of the devices stay in the arena, which the caller frees once
+ * the threads are gone.
+ */
+void
+stop_captures(capture_group_t *group)
+{
+	u_int i;
+	capture_t *c;
+
+	atomic_store(&group->running, 0);
+
+	for (i = 0; i < group->ncaptures; i++) {
+		c = &group->captures[i];
+		if (c->nstarted > 0) {
+			queue_wake(&c->free);
+			queue_wake(&c->filled);
+			if (c->nstarted > 1) {
+				pthread_join(c->thread, NULL);
+			}
+			pthread_join(c->dsp_thread, NULL);
+			c->nstarted = 0;
+		}
+		if (c->free.slots != NULL) {
+			destroy_queue(&c->free);
+			c->free.slots = NULL;
+		}
+		if (c->filled.slots != NULL) {
+			destroy_queue(&c->filled);
+			c->filled.slots = NULL;
+		}
+		close_audio_ctrl(&c->ctrl);
+		free_fir(&c->weighting);
+		c->pcm = NULL;
+		c->bins = NULL;
+		c->power = NULL;
+		c->scratch = NULL;
+	}
+}
+
+/*
+ * Wait up to ms milliseconds for any device to publish past seq
+ *
+ * Returns the current group sequence number.
+ */
+u_int
+wait_captures(capture_group_t *group, u_int seq, u_int ms)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&group->lock);
+	while (group->seq == seq) {
+		if (pthread_cond_timedwait(&group->updated, &group->lock,
+		    &ts) != 0) {
+			break;
+		}
+	}
+	seq = group->seq;
+	pthread_mutex_unlock(&group->lock);
+
+	return seq;
+}
+
+/*
+ * Get the newest bars of a device and the stream counters as of those bars
+ *
+ * Only the renderer may call this. bars stays valid until the next call for
+ * the same device. Any of bars and stats may be NULL. Returns the error that
+ * stopped the device, if any.
+ */
+int
+read_capture(capture_t *c, const bar_t **bars, u_int *seq,
+    stream_stats_t *stats)
+{
+	int res;
+	capture_spectrum_t *s;
+
+	if (atomic_load(&c->middle) & CAPTURE_FRESH) {
+		c->front = atomic_exchange(&c->middle, c->front) &
+		    ~(u_int)CAPTURE_FRESH;
+	}
+	s = &c->spectra[c->front];
+	if (bars != NULL) {
+		*bars = s->bars;
+	}
+	if (stats != NULL) {
+		*stats = s->stats;
+	}
+	*seq = s->seq;
+
+	pthread_mutex_lock(&c->group->lock);
+	res = c->res;
+	pthread_mutex_unlock(&c->group->lock);
+
+	return res;
+}
+
+/*
+ * Get the levels of the bars last returned by read_capture()
+ *
+ * Only the renderer may call this.
+ */
+const meter_levels_t *
+capture_levels(capture_t *c)
+{
+	return &c->spectra[c->front].levels;
+}
@@ -0,0 +1,176 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_CAPTURE_H
+#define AUDIO_CAPTURE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "audio_ctrl.h"
+#include "audio_stream.h"
+#include "bars.h"
+#include "cqt.h"
+#include "decimate.h"
+#include "fft.h"
+#include "filterbank.h"
+#include "fir.h"
+#include "meter.h"
+#include "mfcc.h"
+#include "multires.h"
+#include "queue.h"
+#include "rt.h"
+#include "tracker.h"
+#include "waterfall.h"
+#include "welch.h"
+#include "zoom.h"
+
+#define MAX_CAPTURES 32
+#define CAPTURE_NO_CPU -1
+#define CAPTURE_FRAMES 4 /* frames in flight per device, a power of two */
+#define CAPTURE_FRESH 4  /* flags a spectrum the renderer has not seen */
+
+struct capture_group_t;
+
+/*
+ * A captured frame on its way from the capture to the dsp thread
+ */
+typedef struct capture_frame_t {
+	u_char *data;          /* raw samples, NULL unless read(2) is used */
+	stream_frame_t frame;  /* the samples, in data or in a mapping */
+	stream_stats_t stats;  /* stream counters as of this frame */
+	int res;               /* error that ended the capture */
+} capture_frame_t;
+
+/*
+ * A complete spectrum on its way from the dsp thread to the renderer
+ */
+typedef struct capture_spectrum_t {
+	bar_t *bars;           /* bars of the spectrum */
+	stream_stats_t stats;  /* stream counters as of the spectrum */
+	meter_levels_t levels; /* levels of the frame, with meters */
+	u_int seq;             /* number of the spectrum */
+} capture_spectrum_t;
+
+/*
+ * A single device together with its own pipeline
+ *
+ * The capture thread records into frames taken from the free queue and
+ * hands them to the dsp thread through the filled queue, which converts and
+ * transforms them and sends them back. Neither waits on the other until all
+ * CAPTURE_FRAMES frames are in flight, so the pipeline runs at the pace of
+ * its slowest stage.
+ *
+ * The dsp thread hands spectra to the renderer through a triple buffer: it
+ * fills spectra[back] and swaps it with middle, the renderer swaps front with
+ * middle whenever middle is flagged CAPTURE_FRESH. Both always have a
+ * spectrum of their own, so neither ever waits and the renderer always
+ * draws the newest complete one.
+ *
+ * The buffers are taken from the arena given to start_captures().
+ */
+typedef struct capture_t {
+	audio_ctrl_t ctrl;       /* the device captured from */
+	audio_stream_t stream;   /* layout of one captured frame */
+	fft_config_t fft_config; /* fft of one captured frame */
+	capture_frame_t *frames[CAPTURE_FRAMES];
+	queue_t free;            /* frames ready to be captured into */
+	queue_t filled;          /* frames ready to be transformed */
+	meter_t meter;           /* levels of the frames, with meters */
+	decimator_t decimator;   /* ahead of the transform, with decimation */
+	fir_t weighting;         /* ahead of the transform, with weighting */
+	float *pcm;              /* normalized samples */
+	u_int npcm;              /* samples in pcm after decimation */
+	bin_t *bins;             /* spectrum of the current frame, nsamples */
+	float *power;            /* power spectrum of the current frame */
+	cplx *scratch;           /* scratch space of fft() */
+	cqt_kernel_t kernel;     /* kernel of the bars with BARS_CQT */
+	filterbank_t bank;       /* filters of the bars with BARS_MEL, BARS_BARK */
+	welch_t welch;           /* segments of the bars with BARS_WELCH */
+	tracker_t tracker;       /* targets of the bars with BARS_TRACK */
+	zoom_t zoom;             /* decimator of the bars with BARS_ZOOM */
+	multires_t multires;     /* levels of the bars with BARS_MULTIRES */
+	mfcc_t features;         /* features of every frame, with features_fd */
+	capture_spectrum_t spectra[3];
+	u_int back;              /* spectrum the dsp thread fills */
+	atomic_uint middle;      /* spectrum in between, with CAPTURE_FRESH */
+	u_int front;             /* spectrum the renderer reads */
+	waterfall_t history;     /* every spectrum published, quantized */
+	stream_stats_t work_stats; /* stream counters of the capture thread */
+	u_int seq;               /* number of spectra published */
+	int res;                 /* error that stopped the pipeline */
+	int cpu;                 /* cpu the capture thread is pinned to */
+	int dsp_cpu;             /* cpu the dsp thread is pinned to */
+	int pin_res;             /* errno of a refused pinning */
+	int priority;            /* SCHED_FIFO priority granted, or 0 */
+	int priority_res;        /* errno of a refused priority */
+	int nstarted;            /* number of threads started */
+	pthread_t thread;        /* capture thread */
+	pthread_t dsp_thread;
+	struct capture_group_t *group;
+} capture_t;
+
+typedef struct capture_group_t {
+	capture_t captures[MAX_CAPTURES];
+	u_int ncaptures;        /* number of devices */
+	u_int nbars;            /* number of bars per device */
+	u_int transform;        /* how bars are computed, one of BARS_* */
+	u_int overlap;          /* overlap of BARS_WELCH segments, percent */
+	u_int decimation;       /* samples per transformed sample, 1 for all */
+	const char *weighting;  /* filter ahead of the transform, or NULL */
+	int meters;             /* meter levels and loudness while converting */
+	float track[TRACK_MAX]; /* frequencies of BARS_TRACK, one per bar */
+	u_int seq;              /* spectra published by all devices */
+	atomic_int running;     /* cleared to stop the pipelines */
+	rt_config_t rt;         /* scheduling asked for the threads */
+	size_t nprefaulted;     /* bytes of buffers prefaulted */
+	int lock_all;           /* mlockall(), else the buffers only */
+	int lock_res;           /* errno of a refused lock */
+	int features_fd;        /* where features are written, or -1 */
+	pthread_mutex_t lock;   /* protects seq and res */
+	pthread_mutex_t features_lock; /* keeps records of devices apart */
+	pthread_cond_t updated; /* signaled for every published spectrum */
+} capture_group_t;
+
+int build_capture_group(capture_group_t *group);
+int add_capture(capture_group_t *group, const char *path,
+    audio_config_t config, u_int ms, u_int nsamples, float fmin, float fmax,
+    int use_mmap);
+size_t capture_arena_size(capture_group_t *group, u_int nbars);
+int start_captures(capture_group_t *group, u_int nbars, arena_t *arena,
+    rt_config_t rt);
+void print_rt_status(FILE *fp, capture_group_t *group);
+void stop_captures(capture_group_t *group);
+u_int wait_captures(capture_group_t *group, u_int seq, u_int ms);
+int read_capture(capture_t *capture, const bar_t **bars, u_int *seq,
+    stream_stats_t *stats);
+const meter_levels_t *capture_levels(capture_t *capture);
+
+#endif
@@ -0,0 +1,224 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "cqt.h"
+#include "error_codes.h"
+#include "fft.h"
+
+/*
+ * Compute the spectral kernel of a single bar into spectrum
+ *
+ * The temporal kernel is a Hamming windowed complex sinusoid at the center
+ * frequency of the bar, as long as the quality factor of the bar asks for
+ * but at most a frame, centered in the frame. It is normalized by the sum of
+ * its window, so that a sinusoid at the center frequency reads as its peak
+ * fft bin would.
+ */
+static void
+bar_kernel(const bar_t *bar, fft_config_t config, cplx *spectrum, cplx *tmp)
+{
+	u_int j, len, start;
+	double fc, q, w, sum, PI;
+
+	PI = atan2(1, 1) * 4;
+	fc = sqrt((double)bar->fmin * (double)bar->fmax);
+	q = fc / ((double)bar->fmax - (double)bar->fmin);
+	len = (u_int)ceil(q * (double)config.fs / fc);
+	if (len > config.nsamples) {
+		len = config.nsamples;
+	}
+	if (len < 2) {
+		len = 2;
+	}
+	start = (config.nsamples - len) / 2;
+
+	for (j = 0; j < config.nsamples; j++) {
+		spectrum[j] = 0;
+	}
+	sum = 0;
+	for (j = 0; j < len; j++) {
+		w = 0.54 - 0.46 * cos(2 * PI * j / (len - 1));
+		spectrum[start + j] = w * cexp(2 * PI * I * fc * (start + j) /
+		    (double)config.fs);
+		sum += w;
+	}
+	for (j = 0; j < len; j++) {
+		spectrum[start + j] /= sum;
+	}
+
+	fft_cplx(spectrum, tmp, config.nsamples);
+}
+
+/*
+ * Walk the kernel entries of every bar that are kept
+ *
+ * Only counts them into kernel->nnz while kernel->val is NULL, else fills
+ * row, col and val in as well.
+ */
+static int
+walk_kernel(cqt_kernel_t *kernel, const bar_t *bars, fft_config_t config)
+{
+	u_int b, j;
+	double peak;
+	cplx *spectrum, *tmp;
+
+	if ((spectrum = malloc(2 * sizeof(cplx) * config.nsamples)) == NULL) {
+		return E_NO_MEMORY;
+	}
+	tmp = spectrum + config.nsamples;
+
+	kernel->nnz = 0;
+	for (b = 0; b < kernel->nbars; b++) {
+		bar_kernel(&bars[b], config, spectrum, tmp);
+
+		peak = 0;
+		for (j = 0; j < config.nbins; j++) {
+			peak = fmax(peak, cabs(spectrum[j]));
+		}
+
+		if (kernel->val != NULL) {
+			kernel->row[b] = kernel->nnz;
+		}
+		for (j = 0; j < config.nbins; j++) {
+			if (cabs(spectrum[j]) < CQT_THRESHOLD * peak) {
+				continue;
+			}
+			if (kernel->val != NULL) {
+				kernel->col[kernel->nnz] = j;
+				kernel->val[kernel->nnz] = conj(spectrum[j]);
+			}
+			kernel->nnz++;
+		}
+	}
+	if (kernel->val != NULL) {
+		kernel->row[kernel->nbars] = kernel->nnz;
+	}
+
+	free(spectrum);
+	return 0;
+}
+
+/*
+ * Size of the arena the kernel of nbars bars takes
+ *
+ * The entries kept depend on the bars, so they are counted here. Returns 0
+ * if there is no memory to count them, which makes build_cqt_kernel() fail.
+ */
+size_t
+cqt_kernel_arena_size(u_int nbars, fft_config_t config)
+{
+	cqt_kernel_t kernel;
+	bar_t *bars;
+
+	if ((bars = malloc(sizeof(bar_t) * nbars)) == NULL) {
+		return 0;
+	}
+	reset_bars(bars, nbars, config);
+	kernel.nbars = nbars;
+	kernel.val = NULL;
+	if (walk_kernel(&kernel, bars, config) != 0) {
+		free(bars);
+		return 0;
+	}
+	free(bars);
+
+	return ARENA_ROUND(sizeof(u_int) * (nbars + 1)) +
+	    ARENA_ROUND(sizeof(u_int) * kernel.nnz) +
+	    ARENA_ROUND(sizeof(cplx) * kernel.nnz);
+}
+
+/*
+ * Build the kernel of the bars, taken from the arena
+ *
+ * Each bar becomes a filter centered on the geometric mean of its edges with
+ * a quality factor of center / bandwidth. Low bars whose filters would be
+ * longer than a frame get a frame long filter, and so a wider band, instead.
+ */
+int
+build_cqt_kernel(cqt_kernel_t *kernel, const bar_t *bars, u_int nbars,
+    fft_config_t config, arena_t *arena)
+{
+	int res;
+
+	kernel->nbars = nbars;
+	kernel->val = NULL;
+	if ((res = walk_kernel(kernel, bars, config)) != 0) {
+		return res;
+	}
+
+	kernel->row = arena_alloc(arena, sizeof(u_int) * (nbars + 1));
+	kernel->col = arena_alloc(arena, sizeof(u_int) * kernel->nnz);
+	kernel->val = arena_alloc(arena, sizeof(cplx) * kernel->nnz);
+	if (kernel->row == NULL || kernel->col == NULL || kernel->val == NULL) {
+		return E_NO_MEMORY;
+	}
+	return walk_kernel(kernel, bars, config);
+}
+
+/*
+ * Perform the constant-Q transform of the normalized pcm data into the bars
+ *
+ * Every frame is transformed with the fft, then each bar is the product of
+ * its kernel row with the spectrum. The magnitude of each bar is averaged
+ * over the frames; each bar counts as a single bin.
+ */
+int
+cqt(fft_config_t config, const cqt_kernel_t *kernel, bar_t *bars,
+    const float *pcm, cplx *scratch)
+{
+	u_int i, b, k;
+	cplx *spectrum, acc;
+
+	for (b = 0; b < kernel->nbars; b++) {
+		bars[b].magnitude = 0.0f;
+		bars[b].nbins = 1;
+	}
+
+	for (i = 0; i < config.nframes; i++) {
+		spectrum = fft_frame(config, pcm + i * config.nsamples, scratch);
+		for (b = 0; b < kernel->nbars; b++) {
+			acc = 0;
+			for (k = kernel->row[b]; k < kernel->row[b + 1]; k++) {
+				acc += kernel->val[k] * spectrum[kernel->col[k]];
+			}
+			bars[b].magnitude += (float)cabs(acc);
+		}
+	}
+
+	for (b = 0; b < kernel->nbars; b++) {
+		bars[b].magnitude /= (float)config.nframes;
+	}
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_CQT_H
+#define AUDIO_CQT_H
+
+#include <sys/types.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "fft.h"
+
+#define CQT_THRESHOLD 0.0054f /* kernel entries below this share are dropped */
+
+/*
+ * Sparse spectral kernel of a constant-Q transform, one row per bar
+ *
+ * Row b holds the conjugated spectrum of a windowed complex sinusoid at the
+ * center frequency of bar b, as in Brown and Puckette, "An efficient
+ * algorithm for the calculation of a constant Q transform". Only the
+ * entries that matter are kept, in compressed sparse rows.
+ */
+typedef struct cqt_kernel_t {
+	u_int nbars;  /* number of rows */
+	u_int nnz;    /* number of entries kept */
+	u_int *row;   /* nbars + 1 offsets of the rows into col and val */
+	u_int *col;   /* fft bin of every entry */
+	cplx *val;    /* conjugated kernel value of every entry */
+} cqt_kernel_t;
+
+size_t cqt_kernel_arena_size(u_int nbars, fft_config_t config);
+int build_cqt_kernel(cqt_kernel_t *kernel, const bar_t *bars, u_int nbars,
+    fft_config_t config, arena_t *arena);
+int cqt(fft_config_t config, const cqt_kernel_t *kernel, bar_t *bars,
+    const float *pcm, cplx *scratch);
+
+#endif
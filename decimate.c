@@ -0,0 +1,143 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decimate.h"
+#include "error_codes.h"
+
+/*
+ * Size of the arena a decimator by factor taking at most nmax inputs per
+ * call takes
+ */
+size_t
+decimator_arena_size(u_int factor, u_int nmax)
+{
+	u_int ntaps;
+
+	ntaps = DECIMATE_TAPS_PER_PHASE * factor;
+	return ARENA_ROUND(sizeof(float) * ntaps) +
+	    ARENA_ROUND(sizeof(float) * (ntaps - 1 + nmax));
+}
+
+/*
+ * Design a decimator by factor taking at most nmax inputs per call, taken
+ * from the arena
+ *
+ * The filter is a Blackman windowed sinc. It is flat to about 70% of the
+ * decimated Nyquist frequency; what aliases lands above 90% of it.
+ */
+int
+build_decimator(decimator_t *d, u_int factor, u_int nmax, arena_t *arena)
+{
+	u_int j;
+	double fc, t, w, sum;
+
+	memset(d, 0, sizeof(*d));
+	if (factor < 2) {
+		return E_DECIMATE_FACTOR;
+	}
+	d->factor = factor;
+	d->ntaps = DECIMATE_TAPS_PER_PHASE * factor;
+	d->nmax = nmax;
+	d->skip = 0;
+
+	d->taps = arena_alloc(arena, sizeof(float) * d->ntaps);
+	d->buf = arena_alloc(arena, sizeof(float) * (d->ntaps - 1 + nmax));
+	if (d->taps == NULL || d->buf == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	fc = DECIMATE_CUTOFF / factor;
+	sum = 0.0;
+	for (j = 0; j < d->ntaps; j++) {
+		t = j - (d->ntaps - 1) / 2.0;
+		w = 0.42 - 0.5 * cos(2.0 * M_PI * j / (d->ntaps - 1)) +
+		    0.08 * cos(4.0 * M_PI * j / (d->ntaps - 1));
+		d->taps[j] = (float)(w * (t == 0.0 ? 2.0 * fc :
+		    sin(2.0 * M_PI * fc * t) / (M_PI * t)));
+		sum += d->taps[j];
+	}
+	for (j = 0; j < d->ntaps; j++) {
+		d->taps[j] /= (float)sum;
+	}
+
+	return 0;
+}
+
+/*
+ * Dot product of n taps and samples
+ *
+ * Four independent sums, so that the multiplies of consecutive taps do not
+ * wait on each other and can be done side by side.
+ */
+static inline float
+dot(const float *restrict h, const float *restrict x, u_int n)
+{
+	u_int j;
+	float s0, s1, s2, s3;
+
+	s0 = s1 = s2 = s3 = 0.0f;
+	for (j = 0; j + 4 <= n; j += 4) {
+		s0 += h[j] * x[j];
+		s1 += h[j + 1] * x[j + 1];
+		s2 += h[j + 2] * x[j + 2];
+		s3 += h[j + 3] * x[j + 3];
+	}
+	for (; j < n; j++) {
+		s0 += h[j] * x[j];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+/*
+ * Decimate n inputs, at most nmax, into out
+ *
+ * Returns the number of outputs, n / factor rounded up or down depending on
+ * where the previous call left off. out may be in.
+ */
+u_int
+decimate(decimator_t *d, const float *in, u_int n, float *out)
+{
+	u_int i, nout, keep;
+
+	keep = d->ntaps - 1;
+	memcpy(d->buf + keep, in, sizeof(float) * n);
+
+	/* output m ends on input skip + m * factor of this call */
+	nout = 0;
+	for (i = d->skip; i < n; i += d->factor) {
+		out[nout++] = dot(d->taps, d->buf + i, d->ntaps);
+	}
+	d->skip = i - n;
+
+	memmove(d->buf, d->buf + n, sizeof(float) * keep);
+	return nout;
+}
@@ -0,0 +1,62 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_DECIMATE_H
+#define AUDIO_DECIMATE_H
+
+#include <sys/types.h>
+
+#include "arena.h"
+
+#define DECIMATE_TAPS_PER_PHASE 32 /* taps of the low-pass per output */
+#define DECIMATE_CUTOFF 0.45       /* cutoff, in decimated sample rates */
+
+/*
+ * Polyphase low-pass decimator of a real stream
+ *
+ * Only the samples that are kept are ever computed: every output is the
+ * dot product of the taps with the ntaps inputs that end on it, one
+ * polyphase branch of DECIMATE_TAPS_PER_PHASE taps per input sample in
+ * effect. The last ntaps - 1 inputs and the position of the next output are
+ * carried from one frame to the next, so the output is one continuous
+ * stream whatever the frame size.
+ */
+typedef struct decimator_t {
+	u_int factor;    /* inputs per output */
+	u_int ntaps;     /* taps of the low-pass filter */
+	u_int skip;      /* inputs to skip before the next output */
+	u_int nmax;      /* most inputs per call */
+	float *taps;     /* ntaps coefficients */
+	float *buf;      /* ntaps - 1 carried inputs, then those of a call */
+} decimator_t;
+
+size_t decimator_arena_size(u_int factor, u_int nmax);
+int build_decimator(decimator_t *d, u_int factor, u_int nmax, arena_t *arena);
+u_int decimate(decimator_t *d, const float *in, u_int n, float *out);
+
+#endif
@@ -38,11 +38,15 @@ __RCSID("$NetBSD: decode.c,v 1.1.8.1 2024/03/12 12:47:40 martin Exp $");
 
 #include <curses.h>
 #include <ctype.h>
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <err.h>
 
+#include "bars.h"
+#include "thdn.h"
+
 void
 decode_int(const char *arg, int *intp)
 {
@@ -116,3 +120,121 @@ decode_encoding(const char *arg, unsigned *u)
 		errx(1, "%s is not a valid encoding", arg);
 	}
 }
+
+/*
+ * Decode a comma separated list of cpu numbers, such as 2,3,5
+ */
+void
+decode_cpus(const char *arg, int *cpus, unsigned max, unsigned *ncpus)
+{
+	char	*ep;
+	const char	*p;
+	unsigned long	cpu;
+
+	*ncpus = 0;
+	for (p = arg;; p = ep + 1) {
+		cpu = strtoul(p, &ep, 10);
+		if (ep == p || (ep[0] != ',' && ep[0] != '\0') || cpu > INT_MAX) {
+			errx(1, "argument `%s' not a valid cpu list", arg);
+		}
+		if (*ncpus >= max) {
+			errx(1, "more than %u cpus in `%s'", max, arg);
+		}
+		cpus[(*ncpus)++] = (int)cpu;
+		if (ep[0] == '\0') {
+			return;
+		}
+	}
+}
+
+/*
+ * Decode a comma separated list of frequencies in Hz, such as 50,60,1000
+ */
+void
+decode_freqs(const char *arg, float *freqs, unsigned max, unsigned *nfreqs)
+{
+	char	*ep;
+	const char	*p;
+	float	f;
+
+	*nfreqs = 0;
+	for (p = arg;; p = ep + 1) {
+		f = strtof(p, &ep);
+		if (ep == p || (ep[0] != ',' && ep[0] != '\0') || !(f > 0.0f)) {
+			errx(1, "argument `%s' not a valid frequency list", arg);
+		}
+		if (*nfreqs >= max) {
+			errx(1, "more than %u frequencies in `%s'", max, arg);
+		}
+		freqs[(*nfreqs)++] = f;
+		if (ep[0] == '\0') {
+			return;
+		}
+	}
+}
+
+/*
+ * Parse a comma separated list of name=dB measurement limits, or - for none
+ *
+ * Limits that are not listed are set to NAN and never checked.
+ */
+void
+decode_limits(const char *arg, double *limits)
+{
+	char	*ep;
+	const char	*p, *name;
+	size_t	len;
+	u_int	i;
+
+	for (i = 0; i < THDN_NLIMITS; i++) {
+		limits[i] = NAN;
+	}
+	if (strcmp(arg, "-") == 0) {
+		return;
+	}
+	for (p = arg;; p = ep + 1) {
+		len = strcspn(p, "=");
+		for (i = 0; i < THDN_NLIMITS; i++) {
+			name = get_thdn_limit_name(i);
+			if (strlen(name) == len &&
+			    strncasecmp(p, name, len) == 0) {
+				break;
+			}
+		}
+		if (i == THDN_NLIMITS || p[len] != '=') {
+			errx(1, "argument `%s' not a valid list of limits",
+			    arg);
+		}
+		p += len + 1;
+		limits[i] = strtod(p, &ep);
+		if (ep == p || (ep[0] != ',' && ep[0] != '\0')) {
+			errx(1, "argument `%s' not a valid list of limits",
+			    arg);
+		}
+		if (ep[0] == '\0') {
+			return;
+		}
+	}
+}
+
+void
+decode_transform(const char *arg, unsigned *u)
+{
+	if (strcasecmp(arg, "fft") == 0) {
+		*u = BARS_FFT;
+	} else if (strcasecmp(arg, "cqt") == 0) {
+		*u = BARS_CQT;
+	} else if (strcasecmp(arg, "mel") == 0) {
+		*u = BARS_MEL;
+	} else if (strcasecmp(arg, "bark") == 0) {
+		*u = BARS_BARK;
+	} else if (strcasecmp(arg, "welch") == 0) {
+		*u = BARS_WELCH;
+	} else if (strcasecmp(arg, "zoom") == 0) {
+		*u = BARS_ZOOM;
+	} else if (strcasecmp(arg, "multires") == 0) {
+		*u = BARS_MULTIRES;
+	} else {
+		errx(1, "%s is not a valid transform", arg);
+	}
+}
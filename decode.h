@@ -33,5 +33,9 @@ void decode_int (const char *, int *);
 void decode_uint (const char *, unsigned *);
 void decode_color(const char *, short *);
 void decode_encoding(const char *, unsigned *);
+void decode_transform(const char *, unsigned *);
+void decode_cpus(const char *, int *, unsigned, unsigned *);
+void decode_freqs(const char *, float *, unsigned, unsigned *);
+void decode_limits(const char *, double *);
 
 #endif
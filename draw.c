@@ -28,15 +28,19 @@
  */
 #include <curses.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "audio_ctrl.h"
 #include "audio_stream.h"
+#include "bars.h"
+#include "capture.h"
 #include "draw.h"
 #include "draw_config.h"
 #include "error_codes.h"
 #include "fft.h"
-#include "pcm.h"
+#include "waterfall.h"
 
 /*
  * Print details about the audio controller
@@ -52,13 +56,17 @@ print_ctrl(WINDOW *w, audio_ctrl_t ctrl)
 	wprintw(w, "Audio Controller\n"
 	       "\tdevice:\t\t%s\n"
 	       "\tmode:\t\t%s\n"
+	       "\tcapture:\t%s\n"
 	       "\tbuffer_size:\t%d\n"
+	       "\tblocksize:\t%d\n"
 	       "\tsample_rate:\t%d\n"
 	       "\tprecision:\t%d\n"
 	       "\tchannels:\t%d\n"
 	       "\tencoding:\t%s\n\n",
-	    ctrl.path, mode, ctrl.config.buffer_size, ctrl.config.sample_rate,
-	    ctrl.config.precision, ctrl.config.channels, config_encoding);
+	    ctrl.path, mode, get_capture_name(ctrl), ctrl.config.buffer_size,
+	    ctrl.blocksize,
+	    ctrl.config.sample_rate, ctrl.config.precision,
+	    ctrl.config.channels, config_encoding);
 }
 
 static void
@@ -74,8 +82,11 @@ print_stream(WINDOW *w, audio_stream_t audio_stream)
 		"\tprecision:\t%d\n"
 		"\ttotal_size:\t%d\n"
 		"\ttotal_samples:\t%d\n"
+		"\tread_size:\t%d\n"
+		"\treads/frame:\t%d\n"
 		"\tencoding:\t%s\n\n",
-		audio_stream.channels, audio_stream.milliseconds, audio_stream.precision, audio_stream.total_size, audio_stream.total_samples, config_encoding);
+		audio_stream.channels, audio_stream.milliseconds, audio_stream.precision, audio_stream.total_size, audio_stream.total_samples, audio_stream.read_size,
+		(audio_stream.total_size + audio_stream.read_size - 1) / audio_stream.read_size, config_encoding);
 }
 
 static void
@@ -92,6 +103,43 @@ print_fft_config(WINDOW *w, fft_config_t config)
 		config.fs, config.nbins, config.nframes, config.nsamples, config.total_samples,config.fmin,config.fmax);
 }
 
+static void
+print_capture(WINDOW *w, u_int i, capture_t *capture)
+{
+	u_int seq;
+	stream_stats_t stats;
+
+	read_capture(capture, NULL, &seq, &stats);
+	wprintw(w, "Capture %u\n"
+		"\tcpu:\t\t%d\n"
+		"\tdsp_cpu:\t%d\n"
+		"\tpriority:\t%d\n"
+		"\tlocked:\t\t%s\n"
+		"\tprefaulted:\t%zu\n"
+		"\ttransform:\t%s\n"
+		"\tkernel_nnz:\t%u\n"
+		"\tsegments:\t%u\n"
+		"\tdecimation:\t%u\n"
+		"\tzoom_factor:\t%u\n"
+		"\tframes:\t\t%lu\n"
+		"\treads:\t\t%lu\n"
+		"\tshort_reads:\t%lu\n"
+		"\toverruns:\t%lu\n"
+		"\tdropped:\t%lu\n"
+		"\tdrop_rate:\t%.3f%%\n\n",
+		i, capture->cpu, capture->dsp_cpu, capture->priority,
+		!capture->group->rt.lock ? "no" :
+		capture->group->lock_res != 0 ? "refused" :
+		capture->group->lock_all ? "all" : "buffers",
+		capture->group->nprefaulted,
+		get_transform_name(capture->group->transform),
+		capture->kernel.nnz, capture->welch.nsegments,
+		capture->group->decimation, capture->zoom.decimation,
+		stats.nframes, stats.nreads, stats.nshort,
+		stats.noverruns, stats.dropped,
+		100.0f * drop_rate(stats, capture->stream.precision));
+}
+
 static void
 print_draw_config(WINDOW *w,draw_config_t config)
 {
@@ -111,8 +159,11 @@ print_draw_config(WINDOW *w,draw_config_t config)
 		"\tbox_height:\t%d\n"
 		"\tuse_color:\t%d\n"
 		"\tbar_color:\t%d\n"
-		"\tbar_color2:\t%d\n",
-		config.rows, config.cols, config.max_h, config.max_w, config.y_padding, config.x_padding, config.nbars, config.bar_width, config.bar_space, config.use_boxes, config.nboxes, config.box_space, config.box_height, config.use_color, config.bar_color, config.bar_color2);
+		"\tbar_color2:\t%d\n"
+		"\tntiles:\t\t%d\n"
+		"\ttile_w:\t\t%d\n"
+		"\ttile_h:\t\t%d\n",
+		config.rows, config.cols, config.max_h, config.max_w, config.y_padding, config.x_padding, config.nbars, config.bar_width, config.bar_space, config.use_boxes, config.nboxes, config.box_space, config.box_height, config.use_color, config.bar_color, config.bar_color2, config.ntiles, config.tile_w, config.tile_h);
 }
 
 /*
@@ -127,6 +178,8 @@ check_options(int keypress)
 		return DRAW_EXIT;
 	} else if (keypress == 'V') {
 		return DRAW_FREQ;
+	} else if (keypress == 'W') {
+		return DRAW_WATERFALL;
 	} else {
 		return 0;
 	}
@@ -151,23 +204,29 @@ handle_scroll(char keypress, int *scroll_pos)
  * navigation option so the main routine can render the next screen
  */
 int
-draw_info(audio_ctrl_t ctrl, audio_stream_t audio_stream, fft_config_t fft_config, draw_config_t draw_config)
+draw_info(capture_group_t *group, draw_config_t draw_config)
 {
 	char keypress;
 	int option, scroll_pos;
+	u_int i;
+	capture_t *c;
 	WINDOW *dpad;
 
 	scroll_pos = 0;
-	dpad = newpad(150, draw_config.cols);
+	dpad = newpad(INFO_LINES * (int)(group->ncaptures + 1), draw_config.cols);
 	scrollok(dpad, TRUE);
 
 	move(0, 0);
 	nodelay(stdscr, FALSE);
 	for (;;) {
 		wmove(dpad, 0, 0);
-		print_ctrl(dpad, ctrl);
-		print_stream(dpad, audio_stream);
-		print_fft_config(dpad, fft_config);
+		for (i = 0; i < group->ncaptures; i++) {
+			c = &group->captures[i];
+			print_capture(dpad, i, c);
+			print_ctrl(dpad, c->ctrl);
+			print_stream(dpad, c->stream);
+			print_fft_config(dpad, c->fft_config);
+		}
 		print_draw_config(dpad, draw_config);
 		wscrl(dpad, scroll_pos);
 		prefresh(dpad, 0, 0, 0, 0, draw_config.rows, draw_config.cols);
@@ -184,60 +243,155 @@ draw_info(audio_ctrl_t ctrl, audio_stream_t audio_stream, fft_config_t fft_confi
 }
 
 /*
- * Reset the bars back to their initial states
+ * Draw the bars of a single device into its tile
  *
- * Each bar is logarithmically spaced apart, meaning the frequency range of the
- * bar increases with each one. This should provide more granular detail for
- * the human audio spectrum.
+ * bwin holds nbars * nboxes windows of the tile. x0 and y0 are the left and
+ * top edges of the tile.
  */
-inline int
-reset_bars(bar_t *bars, draw_config_t draw_config, fft_config_t fft_config)
+static void
+draw_tile(WINDOW *fwin, WINDOW **bwin, const bar_t *bars,
+    draw_config_t draw_config, int x0, int y0)
 {
-	u_int i;
+	int active_bars, bottom, draw_start, draw_height, k;
+	u_int i, j;
+	float avg, scaled_magnitude;
+	WINDOW **bw;
+
+	active_bars = 0;
 	for (i = 0; i < draw_config.nbars; i++) {
-		float frac_start = (float)i / (float)draw_config.nbars;
-		float frac_end = (float)(i + 1) / (float)draw_config.nbars;
-		bars[i].fmin =
-		    fft_config.fmin *
-		    powf(fft_config.fmax / fft_config.fmin, frac_start);
-		bars[i].fmax =
-		    fft_config.fmin *
-		    powf(fft_config.fmax / fft_config.fmin, frac_end);
-		bars[i].magnitude = 0.0f;
-		bars[i].nbins = 0;
+		/*
+		 * Based on the number of bins / number of bars it is
+		 * possible that some bars just have no data. We are
+		 * going to skip drawing these so there are no gaps
+		 * in the bar graph
+		 */
+		if (bars[i].nbins <= 0)
+			continue;
+		active_bars++;
 	}
 
+	draw_start = x0 +
+		     (int)(draw_config.tile_w - active_bars * (int)draw_config.bar_width - active_bars * (int)draw_config.bar_space) / 2;
+	bottom = y0 + draw_config.tile_h;
+	j = 0;
+
+	for (i = 0; i < draw_config.nbars; i++) {
+		if (bars[i].nbins <= 0)
+			continue;
+
+		bw = &bwin[i * draw_config.nboxes];
+		avg = bars[i].magnitude / (float)bars[i].nbins;
+		avg = ceilf(avg * FREQ_SCALE_FACTOR);
+		scaled_magnitude = fminf(avg,
+		    (float)(draw_config.tile_h - draw_config.y_padding));
+		// need at least a height of 2 to draw a box
+		scaled_magnitude = scaled_magnitude < 2 ? 2 : scaled_magnitude;
+
+		k = 0;
+		if (draw_config.nboxes == 1) {
+			delwin(bw[0]);
+			bw[0] = subwin(fwin,(int) scaled_magnitude, (int)draw_config.bar_width, bottom - (int)scaled_magnitude, (int)(j * draw_config.bar_width) + draw_start + (int)(j * draw_config.bar_space));
+		} else {
+			draw_height = 0;
+			while (draw_height < (int) ceilf(scaled_magnitude)) {
+				delwin(bw[k]);
+				bw[k] = subwin(fwin, (int)draw_config.box_height, (int)draw_config.bar_width, bottom - (int)k*draw_config.box_height - (int)k*draw_config.box_space, (int)(j * draw_config.bar_width) + draw_start + (int)(j * draw_config.bar_space));
+				draw_height += (draw_config.box_height + draw_config.box_space);
+				k++;
+			}
+			k--;
+		}
+
+		if (draw_config.use_color) {
+			do {
+				// TODO i dont know why i need pidx + 1 but i do
+				int pidx = draw_config.ncolors > 1 ? k + 1 : 1;
+				wbkgd(bw[k], COLOR_PAIR(pidx) | A_REVERSE);
+				k--;
+			} while (k >= 0);
+		} else {
+			do {
+				box(bw[k], 0, 0);
+				k--;
+			} while (k >= 0);
+		}
+		j++;
+	}
+}
+
+/*
+ * Draw the levels of a device in a column at the right edge of its tile
+ */
+static void
+draw_meters(WINDOW *fwin, const meter_levels_t *levels,
+    draw_config_t draw_config, int x0, int y0)
+{
+	int x;
+
+	x = x0 + draw_config.tile_w - DRAW_METER_WIDTH;
+	if (x < x0) {
+		return;
+	}
+	mvwprintw(fwin, y0 + 1, x, "RMS %6.1f", levels->rms);
+	mvwprintw(fwin, y0 + 2, x, "PK  %6.1f", levels->peak);
+	mvwprintw(fwin, y0 + 3, x, "TP  %6.1f", levels->true_peak);
+	mvwprintw(fwin, y0 + 4, x, "M   %6.1f", levels->momentary);
+	mvwprintw(fwin, y0 + 5, x, "S   %6.1f", levels->short_term);
+	mvwprintw(fwin, y0 + 6, x, "I   %6.1f", levels->integrated);
+}
+
+/*
+ * Size of the arena that holds the screen buffers of ntiles devices
+ */
+size_t
+draw_arena_size(draw_config_t draw_config, u_int ntiles)
+{
+	return ARENA_ROUND(sizeof(WINDOW *) * draw_config.nbars *
+	    draw_config.nboxes * ntiles);
+}
+
+/*
+ * Take the screen buffers from the session arena
+ */
+int
+build_draw_buffers(draw_buffers_t *buffers, arena_t *arena,
+    draw_config_t draw_config, u_int ntiles)
+{
+	buffers->nwin = draw_config.nbars * draw_config.nboxes;
+	buffers->bwin = arena_alloc(arena,
+	    sizeof(WINDOW *) * buffers->nwin * ntiles);
+	if (buffers->bwin == NULL) {
+		return E_NO_MEMORY;
+	}
 	return 0;
 }
 
 /*
- * Displays a screen to record audio and display the data in the frequency
- * spectrum.
+ * Displays a screen with the frequency spectrum of every device
+ *
+ * Each device is recorded and transformed by its own capture thread, this
+ * screen only draws the newest spectrum of each. Its buffers come from
+ * build_draw_buffers(), so switching screens allocates nothing but the curses
+ * windows. With several devices, the
+ * spectra are tiled in a grid labeled with the device path.
  *
  * Wait for a user to press one of navigation options. Returns the pressed
  * navigation option so the main routine can render the next screen
  */
 int
-draw_frequency(audio_ctrl_t ctrl, audio_stream_t audio_stream,
-    fft_config_t fft_config, draw_config_t draw_config)
+draw_frequency(capture_group_t *group, draw_config_t draw_config,
+    draw_buffers_t *buffers)
 {
-	char keypress, debug_on;
-	int active_bars, draw_start, option, res, scroll_pos, draw_height, k;
-	u_int i, j;
-	float avg, freq, scaled_magnitude;
-	u_char *data;
-	float *pcm;
-	bar_t *bars;
-	bin_t *bins;
-	WINDOW *dpad, *fwin, ***bwin;
-
-	data = malloc(sizeof(u_char) * audio_stream.total_size);
-	pcm = malloc(sizeof(float) * audio_stream.total_samples);
-	bars = malloc(sizeof(bar_t) * draw_config.nbars);
-	bins = malloc(sizeof(bin_t) * fft_config.nbins);
-	bwin = malloc(sizeof(WINDOW **) * draw_config.nbars);
-	for (i = 0; i < draw_config.nbars; i++) {
-		bwin[i] = malloc(sizeof(WINDOW *) * draw_config.nboxes);
+	char keypress;
+	int option, res, x0, y0;
+	u_int i, t, nwin, seq, drawn, cseq;
+	const bar_t *bars;
+	WINDOW *fwin, **bwin;
+
+	nwin = buffers->nwin;
+	bwin = buffers->bwin;
+	for (i = 0; i < nwin * group->ncaptures; i++) {
+		bwin[i] = NULL;
 	}
 
 	nodelay(stdscr, TRUE);
@@ -245,124 +399,193 @@ draw_frequency(audio_ctrl_t ctrl, audio_stream_t audio_stream,
 	fwin = newwin(draw_config.rows, draw_config.cols, 0, 0);
 	wrefresh(fwin);
 
-	for (i = 0; i < draw_config.nbars; i++) {
-		for (j = 0; j < draw_config.nboxes; j++) {
-			bwin[i][j] = NULL;
-		}
-	}
-
+	/* force the first draw */
+	seq = 0;
+	drawn = ~0U;
 	for (;;) {
-		reset_bins(bins, fft_config);
-		reset_bars(bars, draw_config, fft_config);
+		if (seq != drawn) {
+			drawn = seq;
+			werase(fwin);
+			for (t = 0; t < group->ncaptures; t++) {
+				res = read_capture(&group->captures[t], &bars,
+				    &cseq, NULL);
+				if (res != 0) {
+					goto finish;
+				}
 
-		if ((res = stream(ctrl, audio_stream, data)) != 0) {
-			goto finish;
+				x0 = draw_config.x_padding +
+				    (int)(t % draw_config.tile_cols) * draw_config.tile_w;
+				y0 = (int)(t / draw_config.tile_cols) * draw_config.tile_h;
+				if (group->ncaptures > 1) {
+					mvwaddnstr(fwin, y0, x0,
+					    group->captures[t].ctrl.path,
+					    draw_config.tile_w);
+				}
+				draw_tile(fwin, &bwin[t * nwin], bars, draw_config,
+				    x0, y0);
+				if (group->meters) {
+					draw_meters(fwin,
+					    capture_levels(&group->captures[t]),
+					    draw_config, x0, y0);
+				}
+			}
+			wnoutrefresh(fwin);
+			doupdate();
 		}
 
-		if ((res = to_normalized_pcm(audio_stream, data, pcm)) != 0) {
+		/* listen for input */
+		keypress = (char)getch();
+		option = check_options(keypress);
+		if (option != 0 && option != DRAW_FREQ && option != DRAW_DEBUG) {
+			res = option;
 			goto finish;
 		}
 
-		fft(fft_config, bins, pcm);
-
-		/* Attribute a bin to the corresponding bar */
-		for (i = 0; i < fft_config.nbins; i++) {
-			freq = bins[i].frequency;
-			for (j = 0; j < draw_config.nbars; j++) {
-				if (freq >= bars[j].fmin &&
-				    freq < bars[j].fmax) {
-					bars[j].magnitude += bins[i].magnitude;
-					bars[j].nbins += 1;
-					break;
-				}
-			}
-		}
+		seq = wait_captures(group, seq, DRAW_POLL_MS);
+	}
+finish:
+	for (i = 0; i < nwin * group->ncaptures; i++) {
+		delwin(bwin[i]);
+	}
+	delwin(fwin);
+	return res;
+}
+
+/*
+ * Draw one row of a waterfall, stretching its bars over the window width
+ *
+ * Levels are drawn as characters of increasing density, colored from color
+ * to color-end in color mode. Rows that are not in the history are cleared.
+ */
+static void
+draw_waterfall_row(WINDOW *w, int y, const uint8_t *row, u_int ncols,
+    draw_config_t draw_config)
+{
+	static const char ramp[] = " .:-=+*#%@";
+	int x, width;
+	u_int level;
+	chtype ch;
+
+	wmove(w, y, 0);
+	if (row == NULL) {
+		wclrtoeol(w);
+		return;
+	}
 
-		active_bars = 0;
-		for (i = 0; i < draw_config.nbars; i++) {
-			/*
-			 * Based on the number of bins / number of bars it is
-			 * possible that some bars just have no data. We are
-			 * going to skip drawing these so there are no gaps
-			 * in the bar graph
-			 */
-			if (bars[i].nbins <= 0)
-				continue;
-			active_bars++;
+	width = getmaxx(w);
+	for (x = 0; x < width; x++) {
+		level = row[(u_int)x * ncols / (u_int)width];
+		ch = (chtype)ramp[level * (sizeof(ramp) - 2) /
+		    (WATERFALL_LEVELS - 1)];
+		if (draw_config.use_color) {
+			ch |= COLOR_PAIR(draw_config.ncolors > 1 ?
+			    1 + (int)(level * (draw_config.ncolors - 1) /
+			    (WATERFALL_LEVELS - 1)) : 1);
 		}
+		waddch(w, ch);
+	}
+}
 
-		draw_start = (int)draw_config.x_padding +
-			     (int)(draw_config.max_w - active_bars * (int)draw_config.bar_width - active_bars * (int)draw_config.bar_space) / 2;
-		j = 0;
-
-		werase(fwin);
-		for (i = 0; i < draw_config.nbars; i++) {
-			if (bars[i].nbins <= 0)
-				continue;
-
-			avg = bars[i].magnitude / (float)bars[i].nbins;
-			avg = ceilf(avg * FREQ_SCALE_FACTOR);
-			scaled_magnitude = fminf(avg,
-			    (float)(draw_config.max_h - draw_config.y_padding));
-			// need at least a height of 2 to draw a box
-			scaled_magnitude = scaled_magnitude < 2 ? 2 : scaled_magnitude;
-
-			k = 0;
-			if (draw_config.nboxes == 1) {
-				delwin(bwin[i][0]);
-				bwin[i][0] = subwin(fwin,(int) scaled_magnitude, (int)draw_config.bar_width, draw_config.max_h - (int)scaled_magnitude, (int)(j * draw_config.bar_width) + draw_start + (int)(j * draw_config.bar_space));
-			} else {
-				draw_height = 0;
-				while (draw_height < (int) ceilf(scaled_magnitude)) {
-					delwin(bwin[i][k]);
-					bwin[i][k] = subwin(fwin, (int)draw_config.box_height, (int)draw_config.bar_width, draw_config.max_h - (int)k*draw_config.box_height - (int)k*draw_config.box_space, (int)(j * draw_config.bar_width) + draw_start + (int)(j * draw_config.bar_space));
-					draw_height += (draw_config.box_height + draw_config.box_space);
-					k++;
-				}
-				k--;
-			}
+/*
+ * Bring the waterfall of a device up to the newest spectrum
+ *
+ * The newest row is drawn at the top. Only rows pushed since the last call
+ * are drawn: the window is scrolled down by their number so the terminal can
+ * move the older rows itself, and the whole window is only repainted when
+ * more rows than fit were pushed. Returns the count drawn up to.
+ */
+static u_int
+update_waterfall(WINDOW *w, waterfall_t *waterfall, u_int drawn,
+    draw_config_t draw_config)
+{
+	u_int count, n, age, height;
+
+	count = atomic_load_explicit(&waterfall->count, memory_order_acquire);
+	n = count - drawn;
+	if (n == 0) {
+		return count;
+	}
+
+	height = (u_int)getmaxy(w);
+	if (n >= height) {
+		n = height;
+	} else {
+		wscrl(w, -(int)n);
+	}
+	for (age = 0; age < n; age++) {
+		draw_waterfall_row(w, (int)age,
+		    waterfall_row(waterfall, count, age), waterfall->ncols,
+		    draw_config);
+	}
+	wnoutrefresh(w);
+	return count;
+}
+
+/*
+ * Displays a scrolling spectrogram of every device
+ *
+ * Every spectrum published by a device is kept in its history ring, so the
+ * screen shows the last WATERFALL_ROWS spectra at most, newest on top, even
+ * ones published while another screen was shown.
+ *
+ * Wait for a user to press one of navigation options. Returns the pressed
+ * navigation option so the main routine can render the next screen
+ */
+int
+draw_waterfall(capture_group_t *group, draw_config_t draw_config)
+{
+	char keypress;
+	int label, option, res, x0, y0;
+	u_int t, seq, cseq;
+	u_int drawn[MAX_CAPTURES];
+	WINDOW *fwin, *wwin[MAX_CAPTURES];
 
-			if (draw_config.use_color) {
-				do {
-					// TODO i dont know why i need pidx + 1 but i do
-					int pidx = draw_config.ncolors > 1 ? k + 1 : 1;
-					wbkgd(bwin[i][k], COLOR_PAIR(pidx) | A_REVERSE);
-					k--;
-				} while (k >= 0);
-			} else {
-				do {
-					box(bwin[i][k], 0, 0);
-					k--;
-				} while (k >= 0);
+	nodelay(stdscr, TRUE);
+
+	fwin = newwin(draw_config.rows, draw_config.cols, 0, 0);
+	label = group->ncaptures > 1;
+	for (t = 0; t < group->ncaptures; t++) {
+		x0 = draw_config.x_padding +
+		    (int)(t % draw_config.tile_cols) * draw_config.tile_w;
+		y0 = (int)(t / draw_config.tile_cols) * draw_config.tile_h;
+		if (label) {
+			mvwaddnstr(fwin, y0, x0, group->captures[t].ctrl.path,
+			    draw_config.tile_w);
+		}
+		wwin[t] = derwin(fwin, draw_config.tile_h - label,
+		    draw_config.tile_w, y0 + label, x0);
+		scrollok(wwin[t], TRUE);
+		idlok(wwin[t], TRUE);
+		drawn[t] = 0;
+	}
+	wnoutrefresh(fwin);
+
+	seq = 0;
+	for (;;) {
+		for (t = 0; t < group->ncaptures; t++) {
+			res = read_capture(&group->captures[t], NULL, &cseq, NULL);
+			if (res != 0) {
+				goto finish;
 			}
-			j++;
+			drawn[t] = update_waterfall(wwin[t],
+			    &group->captures[t].history, drawn[t], draw_config);
 		}
-		wnoutrefresh(fwin);
 		doupdate();
 
 		/* listen for input */
-		flushinp();
 		keypress = (char)getch();
 		option = check_options(keypress);
-		if (option != 0 && option != DRAW_FREQ && option != DRAW_DEBUG) {
+		if (option != 0 && option != DRAW_WATERFALL) {
 			res = option;
 			goto finish;
 		}
+
+		seq = wait_captures(group, seq, DRAW_POLL_MS);
 	}
 finish:
-	for (i = 0; i < draw_config.nbars; i++) {
-		for (j = 0; j < draw_config.nboxes; j++) {
-			delwin(bwin[i][j]);
-		}
-	}
-	for (i = 0; i < draw_config.nbars; i++) {
-		free(bwin[i]);
+	for (t = 0; t < group->ncaptures; t++) {
+		delwin(wwin[t]);
 	}
-	free(bwin);
-	free(bins);
-	free(bars);
-	free(pcm);
-	free(data);
 	delwin(fwin);
 	return res;
 }
@@ -29,31 +29,42 @@
 #ifndef AUDIO_DRAW_H
 #define AUDIO_DRAW_H
 
-#include "audio_ctrl.h"
-#include "audio_stream.h"
+#include <curses.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "capture.h"
 #include "draw_config.h"
-#include "fft.h"
 
 #define DRAW_EXIT -1
 #define DRAW_RECORD 1
 #define DRAW_INFO 2
 #define DRAW_FREQ 3
 #define DRAW_DEBUG 4
+#define DRAW_WATERFALL 5
 
 #define FREQ_SCALE_FACTOR 1.2f
 #define DEFAULT_BAR_COUNT 50
 
+#define DRAW_POLL_MS 50
+#define INFO_LINES 40 /* lines of the info screen, per device and once */
+
 #define PADDING_PCT 0.1f
+#define DRAW_METER_WIDTH 10 /* columns of the levels, with meters */
+
+/*
+ * Working buffers of the screens, allocated once per session
+ */
+typedef struct draw_buffers_t {
+	WINDOW **bwin; /* box windows of every tile */
+	u_int nwin;    /* box windows per tile */
+} draw_buffers_t;
 
-typedef struct bar_t {
-	float fmin;  /* minimum frequency of the bar */
-	float fmax;  /* maximum frequency of the bar */
-	u_int nbins; /* number of bins represented in the bar */
-	float
-	    magnitude; /* sum of all amplitudes of all bins within frequency */
-} bar_t;
-
-int draw_info(audio_ctrl_t ctrl, audio_stream_t audio_stream, fft_config_t fft_config, draw_config_t draw_config);
-int draw_frequency(audio_ctrl_t ctrl, audio_stream_t audio_stream,
-    fft_config_t fft_config, draw_config_t draw_config);
+size_t draw_arena_size(draw_config_t draw_config, u_int ntiles);
+int build_draw_buffers(draw_buffers_t *buffers, arena_t *arena,
+    draw_config_t draw_config, u_int ntiles);
+int draw_info(capture_group_t *group, draw_config_t draw_config);
+int draw_frequency(capture_group_t *group, draw_config_t draw_config,
+    draw_buffers_t *buffers);
+int draw_waterfall(capture_group_t *group, draw_config_t draw_config);
 #endif
@@ -49,12 +49,12 @@ validate_draw_config(draw_config_t *config)
 	}
 
 	computed = config->box_height * config->nboxes + config->box_space * config->nboxes;
-	if (computed > config->max_h) {
+	if (computed > (u_int)config->tile_h) {
 		return E_DRW_CONFIG_NBOXES;
 	}
 
 	computed = config->nbars * config->bar_width + config->nbars * config->bar_space;
-	if (computed > (u_int)config->max_w) {
+	if (computed > (u_int)config->tile_w) {
 		return E_DRW_CONFIG_NBARS;
 	}
 
@@ -47,6 +47,11 @@ typedef struct draw_config_t {
 	u_int box_space; /* amount of space between each box */
 	u_int box_height; /* height of each box */
 	u_int ncolors;	/* total number of colors */
+	u_int ntiles;	/* number of spectra drawn, one per device */
+	u_int tile_cols; /* number of tiles per row */
+	u_int tile_rows; /* number of rows of tiles */
+	int tile_w;    /* width of each tile */
+	int tile_h;    /* height of each tile */
 	short bar_color; /* color to paint inside of each bar */
 	short bar_color2; /* second color to transition to */
 } draw_config_t;
@@ -8,8 +8,16 @@
 #define E_CTRL_GETFORMAT 1003
 #define E_CTRL_SETINFO 1004
 
+#define E_NO_MEMORY 1050
+
 #define E_FFT_CONFIG_TOTAL_SAMPLES 1100
 #define E_FFT_CONFIG_NSAMPLES_BY_2 1101
+#define E_FFT_CONFIG_FMAX 1102
+#define E_WELCH_OVERLAP 1103
+#define E_TRACK_FREQUENCY 1104
+#define E_ZOOM_BAND 1105
+#define E_DECIMATE_FACTOR 1106
+#define E_FIR_TAPS 1107
 
 #define E_DRW_CONFIG_NBARS 1201
 #define E_DRW_CONFIG_NBOXES 1202
@@ -26,6 +34,34 @@
 
 #define E_STREAM_IO_ERROR 3000
 
+#define E_FILE_FORMAT 3100
+#define E_FILE_MMAP 3101
+
+#define E_BATCH_OUTPUT 3200
+#define E_BATCH_EMPTY 3201
+#define E_BATCH_THREAD 3202
+
+#define E_CAPTURE_TOO_MANY 3300
+#define E_CAPTURE_THREAD 3301
+#define E_CAPTURE_QUEUE 3302
+
+#define E_FEATURES_OUTPUT 3400
+
+#define E_THDN_FUNDAMENTAL 3500
+#define E_THDN_SYNTH 3501
+
+#define E_SWEEP_BAND 3600
+#define E_SWEEP_LENGTH 3601
+#define E_SWEEP_RATE 3602
+#define E_SWEEP_THREAD 3603
+
+#define E_GEN_SIGNAL 3700
+#define E_GEN_THREAD 3701
+
+#define E_ALIGN_CHANNELS 3800
+#define E_ALIGN_BAND 3801
+#define E_ALIGN_RATE 3802
+
 static inline const char * get_error_msg(int code);
 
 static inline const char *
@@ -40,10 +76,24 @@ get_error_msg(int code)
 		return "Failed to call AUDIO_GETFORMAT";
 	case E_CTRL_SETINFO:
 		return "Failed to call AUDIO_SETINFO";
+	case E_NO_MEMORY:
+		return "Out of memory";
 	case E_FFT_CONFIG_TOTAL_SAMPLES:
 		return "FFT nsamples cannot be greater than total samples";
 	case E_FFT_CONFIG_NSAMPLES_BY_2:
 		return "FFT nsamples must be a power of 2";
+	case E_FFT_CONFIG_FMAX:
+		return "FFT fmax must lie between fmin and half the sample rate";
+	case E_WELCH_OVERLAP:
+		return "Welch overlap must not exceed 90 percent";
+	case E_TRACK_FREQUENCY:
+		return "Tracked frequencies must lie below half the sample rate";
+	case E_ZOOM_BAND:
+		return "Zoom band must be narrower than a quarter of the sample rate";
+	case E_DECIMATE_FACTOR:
+		return "Decimation factor must divide the sample rate";
+	case E_FIR_TAPS:
+		return "Unknown weighting or unreadable file of taps";
 	case E_DRW_CONFIG_NBARS:
 		return "Draw config has nbars that exceeds drawing space";
 	case E_DRW_CONFIG_NBARS_ZERO:
@@ -66,6 +116,48 @@ get_error_msg(int code)
 		return "Unsupported encoding";
 	case E_STREAM_IO_ERROR:
 		return "Streaming I/O error";
+	case E_FILE_FORMAT:
+		return "Unsupported or truncated recording";
+	case E_FILE_MMAP:
+		return "Failed to map recording";
+	case E_BATCH_OUTPUT:
+		return "Failed to write batch output";
+	case E_BATCH_EMPTY:
+		return "Recording is shorter than one interval";
+	case E_BATCH_THREAD:
+		return "Failed to start batch worker";
+	case E_CAPTURE_TOO_MANY:
+		return "Too many devices";
+	case E_CAPTURE_THREAD:
+		return "Failed to start capture thread";
+	case E_CAPTURE_QUEUE:
+		return "Failed to create capture queue";
+	case E_FEATURES_OUTPUT:
+		return "Failed to write features";
+	case E_THDN_FUNDAMENTAL:
+		return "No fundamental resolved between fmin and fmax";
+	case E_THDN_SYNTH:
+		return "Synthetic tone must be synth:frequency[,thd[,snr]]";
+	case E_SWEEP_BAND:
+		return "Sweep must span over an octave below half the sample rate";
+	case E_SWEEP_LENGTH:
+		return "Sweep must last from 1 to 60 seconds";
+	case E_SWEEP_RATE:
+		return "Playback device does not support the recording sample rate";
+	case E_SWEEP_THREAD:
+		return "Failed to start playback thread";
+	case E_GEN_SIGNAL:
+		return "Signal must be sine:f, tones:f1,f2,..., white, pink, "
+		    "sweep:f1,f2,seconds or impulse:rate below half the "
+		    "sample rate";
+	case E_GEN_THREAD:
+		return "Failed to start writer thread";
+	case E_ALIGN_CHANNELS:
+		return "Alignment takes 2 to 16 channels";
+	case E_ALIGN_BAND:
+		return "No bins between fmin and fmax";
+	case E_ALIGN_RATE:
+		return "Sources to align differ in sample rate";
 	case E_UNHANDLED:
 	default:
 		return "Unhandled Error";
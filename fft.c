@@ -28,6 +28,7 @@
  */
 #include "fft.h"
 #include <math.h>
+#include <string.h>
 #include "error_codes.h"
 
 /*
@@ -53,6 +54,97 @@ _fft(cplx *buf, cplx *out, u_int n, u_int step)
 	}
 }
 
+/*
+ * _fft() with the twiddle factors looked up in the table of fft_twiddles()
+ */
+static void
+_fft_table(cplx *buf, cplx *out, const cplx *w, u_int n, u_int step)
+{
+	u_int i;
+
+	if (step < n) {
+		_fft_table(out, buf, w, n, step * 2);
+		_fft_table(out + step, buf + step, w, n, step * 2);
+
+		for (i = 0; i < n; i += 2 * step) {
+			cplx t = w[i / 2] * out[i + step];
+			buf[i / 2] = out[i] + t;
+			buf[(i + n) / 2] = out[i] - t;
+		}
+	}
+}
+
+/*
+ * Fill w with the n / 2 twiddle factors of a transform of n samples
+ *
+ * They are the very factors _fft() works out in every butterfly, so a
+ * transform with the table gives the same result without a cexp() per
+ * butterfly, which matters for long transforms done more than once.
+ */
+void
+fft_twiddles(cplx *w, u_int n)
+{
+	u_int i;
+	double PI;
+
+	PI = atan2(1, 1) * 4;
+	for (i = 0; i < n / 2; i++) {
+		w[i] = cexp(-I * PI * (2 * i) / n);
+	}
+}
+
+/*
+ * fft_cplx() with the twiddle factors of fft_twiddles(w, n)
+ */
+void
+fft_cplx_table(cplx *data, cplx *tmp, const cplx *w, u_int n)
+{
+	memcpy(tmp, data, sizeof(cplx) * n);
+	_fft_table(data, tmp, w, n, 1);
+}
+
+/*
+ * Size in bytes of the scratch space fft() needs for config
+ */
+size_t
+fft_scratch_size(fft_config_t config)
+{
+	return 2 * sizeof(cplx) * config.nsamples;
+}
+
+/*
+ * Transform n complex samples in place. tmp must hold n samples.
+ */
+void
+fft_cplx(cplx *data, cplx *tmp, u_int n)
+{
+	memcpy(tmp, data, sizeof(cplx) * n);
+	_fft(data, tmp, n, 1);
+}
+
+/*
+ * Transform a single frame of nsamples pcm samples
+ *
+ * Returns the complex spectrum, which is kept in scratch until it is used
+ * again. Only its first nbins bins are of interest for real samples.
+ */
+cplx *
+fft_frame(fft_config_t config, const float *frame, cplx *scratch)
+{
+	u_int j;
+	cplx *buf, *out;
+
+	buf = scratch;
+	out = scratch + config.nsamples;
+	for (j = 0; j < config.nsamples; j++) {
+		buf[j] = frame[j];
+		out[j] = frame[j];
+	}
+	_fft(buf, out, config.nsamples, 1);
+
+	return buf;
+}
+
 /*
  * Perform the fft on the normalized pcm data
  *
@@ -62,23 +154,20 @@ _fft(cplx *buf, cplx *out, u_int n, u_int step)
  * The fft is then calculated on that
  * specific frame, and the magnitude is each frequency bin is summed up and
  * averaged over each frame.
+ *
+ * scratch must hold fft_scratch_size() bytes. Nothing is kept on the stack,
+ * so any thread can transform large frames as long as it brings its own
+ * scratch space.
  */
 int
-fft(fft_config_t config, bin_t *bins, float *pcm)
+fft(fft_config_t config, bin_t *bins, float *pcm, cplx *scratch)
 {
-	u_int i, j, start;
+	u_int i, j;
 	float real, imag;
-	cplx buf[config.nsamples];
-	cplx out[config.nsamples];
+	cplx *buf;
 
 	for (i = 0; i < config.nframes; i++) {
-		start = i * config.nsamples;
-		for (j = 0; j < config.nsamples; j++) {
-			buf[j] = pcm[start + j];
-			out[j] = pcm[start + j];
-		}
-
-		_fft(buf, out, config.nsamples, 1);
+		buf = fft_frame(config, pcm + i * config.nsamples, scratch);
 
 		for (j = 0; j < config.nbins; j++) {
 			real = (float)creal(buf[j]);
@@ -94,6 +183,50 @@ fft(fft_config_t config, bin_t *bins, float *pcm)
 	return 0;
 }
 
+/*
+ * Add |X|^2 of the first n bins of a spectrum to power
+ *
+ * A straight pass over both arrays with no square root and no branch, which
+ * the compiler turns into vector code.
+ */
+void
+fft_accumulate_power(const cplx *restrict buf, float *restrict power, u_int n)
+{
+	u_int j;
+	const double *x;
+
+	x = (const double *)buf;
+	for (j = 0; j < n; j++) {
+		power[j] += (float)(x[2 * j] * x[2 * j] +
+		    x[2 * j + 1] * x[2 * j + 1]);
+	}
+}
+
+/*
+ * Average the power spectrum of every frame of the normalized pcm data
+ *
+ * power receives config.nbins bins of |X|^2, averaged over the frames.
+ */
+int
+fft_power(fft_config_t config, float *power, const float *pcm, cplx *scratch)
+{
+	u_int i, j;
+	cplx *buf;
+
+	for (j = 0; j < config.nbins; j++) {
+		power[j] = 0.0f;
+	}
+	for (i = 0; i < config.nframes; i++) {
+		buf = fft_frame(config, pcm + i * config.nsamples, scratch);
+		fft_accumulate_power(buf, power, config.nbins);
+	}
+	for (j = 0; j < config.nbins; j++) {
+		power[j] /= (float)config.nframes;
+	}
+
+	return 0;
+}
+
 /*
  * Initialize the fft_config
  */
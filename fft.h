@@ -30,6 +30,7 @@
 #define FFT_H
 
 #include <complex.h>
+#include <stddef.h>
 #include <sys/audioio.h>
 
 #define DEFAULT_NSAMPLES 1024
@@ -52,7 +53,16 @@ typedef struct fft_config_t {
 	float fmax;          /* max frequency for the bars. (fs / 2) */
 } fft_config_t;
 
-int fft(fft_config_t config, bin_t *bins, float *pcm);
+int fft(fft_config_t config, bin_t *bins, float *pcm, cplx *scratch);
+size_t fft_scratch_size(fft_config_t config);
+int fft_power(fft_config_t config, float *power, const float *pcm,
+    cplx *scratch);
+void fft_accumulate_power(const cplx *restrict buf, float *restrict power,
+    u_int n);
+cplx *fft_frame(fft_config_t config, const float *frame, cplx *scratch);
+void fft_cplx(cplx *data, cplx *tmp, u_int n);
+void fft_twiddles(cplx *w, u_int n);
+void fft_cplx_table(cplx *data, cplx *tmp, const cplx *w, u_int n);
 int build_fft_config(fft_config_t *config, u_int size, u_int fs, u_int total_samples, float f_min);
 int reset_bins(bin_t *bins, fft_config_t config);
 #endif
@@ -0,0 +1,237 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "filterbank.h"
+
+/*
+ * Convert between Hz and the mel (O'Shaughnessy) or Bark (Traunmuller)
+ * scale
+ */
+static double
+to_scale(u_int scale, double f)
+{
+	if (scale == FILTERBANK_BARK) {
+		return 26.81 * f / (1960.0 + f) - 0.53;
+	}
+	return 2595.0 * log10(1.0 + f / 700.0);
+}
+
+static double
+from_scale(u_int scale, double z)
+{
+	if (scale == FILTERBANK_BARK) {
+		return 1960.0 * (z + 0.53) / (26.28 - z);
+	}
+	return 700.0 * (pow(10.0, z / 2595.0) - 1.0);
+}
+
+/*
+ * Edge b of nbands bands from config.fmin to config.fmax
+ */
+static float
+band_edge(u_int scale, u_int nbands, u_int b, fft_config_t config)
+{
+	double zmin, zmax;
+
+	zmin = to_scale(scale, config.fmin);
+	zmax = to_scale(scale, config.fmax);
+	return (float)from_scale(scale,
+	    zmin + (zmax - zmin) * b / (nbands + 1));
+}
+
+/*
+ * First and last fft bin of band b
+ *
+ * A band narrower than an fft bin gets the bin nearest to its center.
+ */
+static void
+band_bins(u_int scale, u_int nbands, u_int b, fft_config_t config,
+    u_int *lo, u_int *hi)
+{
+	double df;
+	float left, center, right;
+
+	df = (double)config.fs / (double)config.nsamples;
+	left = band_edge(scale, nbands, b, config);
+	center = band_edge(scale, nbands, b + 1, config);
+	right = band_edge(scale, nbands, b + 2, config);
+	*lo = (u_int)ceil(left / df);
+	*hi = (u_int)floor(right / df);
+	if (*hi >= config.nbins) {
+		*hi = config.nbins - 1;
+	}
+	if (*lo > *hi || *lo * df >= right) {
+		*lo = *hi = (u_int)lround(center / df);
+		if (*lo >= config.nbins) {
+			*lo = *hi = config.nbins - 1;
+		}
+	}
+}
+
+/*
+ * Size of the arena nbands filters take
+ */
+size_t
+filterbank_arena_size(u_int scale, u_int nbands, fft_config_t config)
+{
+	u_int b, lo, hi;
+	size_t nnz;
+
+	nnz = 0;
+	for (b = 0; b < nbands; b++) {
+		band_bins(scale, nbands, b, config, &lo, &hi);
+		nnz += hi - lo + 1;
+	}
+	return ARENA_ROUND(sizeof(u_int) * (nbands + 1)) +
+	    ARENA_ROUND(sizeof(u_int) * nbands) +
+	    ARENA_ROUND(sizeof(float) * (nbands + 2)) +
+	    ARENA_ROUND(sizeof(float) * nnz);
+}
+
+/*
+ * Build nbands filters from config.fmin to config.fmax, taken from the arena
+ *
+ * The filters peak at 1 on their center and fall to 0 on the centers of
+ * their neighbours. A filter narrower than an fft bin gets the bin nearest to
+ * its center, so that no band is left without any.
+ */
+int
+build_filterbank(filterbank_t *bank, u_int scale, u_int nbands,
+    fft_config_t config, arena_t *arena)
+{
+	u_int b, k, lo, hi, cap;
+	double df, f, left, center, right;
+
+	bank->nbands = nbands;
+	bank->row = arena_alloc(arena, sizeof(u_int) * (nbands + 1));
+	bank->first = arena_alloc(arena, sizeof(u_int) * nbands);
+	bank->edges = arena_alloc(arena, sizeof(float) * (nbands + 2));
+	if (bank->row == NULL || bank->first == NULL || bank->edges == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	for (b = 0; b < nbands + 2; b++) {
+		bank->edges[b] = band_edge(scale, nbands, b, config);
+	}
+
+	/* count the weights first, so they can live in a single array */
+	cap = 0;
+	for (b = 0; b < nbands; b++) {
+		band_bins(scale, nbands, b, config, &lo, &hi);
+		bank->first[b] = lo;
+		bank->row[b] = cap;
+		cap += hi - lo + 1;
+	}
+	bank->row[nbands] = cap;
+
+	if ((bank->weight = arena_alloc(arena, sizeof(float) * cap)) == NULL) {
+		return E_NO_MEMORY;
+	}
+	bank->nnz = cap;
+
+	df = (double)config.fs / (double)config.nsamples;
+	for (b = 0; b < nbands; b++) {
+		left = bank->edges[b];
+		center = bank->edges[b + 1];
+		right = bank->edges[b + 2];
+		for (k = bank->row[b]; k < bank->row[b + 1]; k++) {
+			f = (bank->first[b] + (k - bank->row[b])) * df;
+			if (bank->row[b + 1] - bank->row[b] == 1) {
+				bank->weight[k] = 1.0f;
+			} else if (f <= center) {
+				bank->weight[k] = (float)((f - left) / (center - left));
+			} else {
+				bank->weight[k] = (float)((right - f) / (right - center));
+			}
+			if (bank->weight[k] < 0.0f) {
+				bank->weight[k] = 0.0f;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Energy of band b in the power spectrum
+ */
+static inline float
+band_energy(const filterbank_t *bank, const float *power, u_int b)
+{
+	u_int k;
+	const float *p;
+	float acc;
+
+	p = power + bank->first[b] - bank->row[b];
+	acc = 0.0f;
+	for (k = bank->row[b]; k < bank->row[b + 1]; k++) {
+		acc += bank->weight[k] * p[k];
+	}
+	return acc;
+}
+
+/*
+ * Sum the power spectrum into the energy of every band
+ *
+ * power holds config.nbins bins. The weights and the bins are both walked
+ * forward, in a single pass over the weights.
+ */
+void
+apply_filterbank(const filterbank_t *bank, const float *power, float *bands)
+{
+	u_int b;
+
+	for (b = 0; b < bank->nbands; b++) {
+		bands[b] = band_energy(bank, power, b);
+	}
+}
+
+/*
+ * Fill one bar per band with the amplitude of the band
+ *
+ * The bars span the edges of their filters, which overlap.
+ */
+void
+filterbank_bars(const filterbank_t *bank, const float *power, bar_t *bars)
+{
+	u_int b;
+
+	for (b = 0; b < bank->nbands; b++) {
+		bars[b].fmin = bank->edges[b];
+		bars[b].fmax = bank->edges[b + 2];
+		bars[b].magnitude = sqrtf(band_energy(bank, power, b));
+		bars[b].nbins = 1;
+	}
+}
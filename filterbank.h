@@ -0,0 +1,65 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_FILTERBANK_H
+#define AUDIO_FILTERBANK_H
+
+#include <sys/types.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "fft.h"
+
+#define FILTERBANK_MEL 0
+#define FILTERBANK_BARK 1
+
+/*
+ * Overlapping triangular filters equally spaced on a perceptual scale
+ *
+ * Every filter covers a contiguous run of fft bins, so the weights are kept
+ * in a compact variant of compressed sparse rows: the weights of all bands
+ * back to back, each band knowing its first bin and where its weights start.
+ */
+typedef struct filterbank_t {
+	u_int nbands;  /* number of filters */
+	u_int nnz;     /* number of weights */
+	u_int *row;    /* nbands + 1 offsets of the bands into weight */
+	u_int *first;  /* fft bin of the first weight of every band */
+	float *weight; /* weights of the bands */
+	float *edges;  /* nbands + 2 band edges in Hz, band b spans b to b + 2 */
+} filterbank_t;
+
+size_t filterbank_arena_size(u_int scale, u_int nbands, fft_config_t config);
+int build_filterbank(filterbank_t *bank, u_int scale, u_int nbands,
+    fft_config_t config, arena_t *arena);
+void apply_filterbank(const filterbank_t *bank, const float *power,
+    float *bands);
+void filterbank_bars(const filterbank_t *bank, const float *power,
+    bar_t *bars);
+
+#endif
@@ -0,0 +1,295 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <complex.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "arena.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "fir.h"
+
+/*
+ * A and C weighting curves of IEC 61672-1, before normalization
+ */
+static double
+weighting_c(double f2)
+{
+	return 12194.0 * 12194.0 * f2 /
+	    ((f2 + 20.6 * 20.6) * (f2 + 12194.0 * 12194.0));
+}
+
+static double
+weighting_a(double f2)
+{
+	return weighting_c(f2) * f2 /
+	    sqrt((f2 + 107.7 * 107.7) * (f2 + 737.9 * 737.9));
+}
+
+/*
+ * Magnitude response of the built-in filter name at f Hz, or -1 if there is
+ * no such filter
+ *
+ * A and C weighting are 1 at 1 kHz. highpass is a fourth order Butterworth
+ * magnitude with its corner at FIR_HIGHPASS.
+ */
+static double
+preset_response(const char *name, double f)
+{
+	if (strcasecmp(name, "a") == 0) {
+		return weighting_a(f * f) / weighting_a(1e6);
+	}
+	if (strcasecmp(name, "c") == 0) {
+		return weighting_c(f * f) / weighting_c(1e6);
+	}
+	if (strcasecmp(name, "highpass") == 0) {
+		if (f == 0.0) {
+			return 0.0;
+		}
+		return 1.0 / sqrt(1.0 + pow(FIR_HIGHPASS / f, 8.0));
+	}
+	return -1.0;
+}
+
+/*
+ * Design FIR_PRESET_TAPS linear phase taps of a built-in filter by sampling
+ * its response, which is real and even, so its inverse fft is a forward
+ * one scaled down
+ */
+static int
+design_preset(const char *name, u_int fs, float **taps, u_int *ntaps)
+{
+	u_int k, n;
+	cplx *buf;
+
+	n = FIR_PRESET_TAPS;
+	if ((buf = malloc(sizeof(cplx) * 2 * n)) == NULL) {
+		return E_NO_MEMORY;
+	}
+	if ((*taps = malloc(sizeof(float) * n)) == NULL) {
+		free(buf);
+		return E_NO_MEMORY;
+	}
+	for (k = 0; k < n; k++) {
+		buf[k] = preset_response(name,
+		    (double)(k <= n / 2 ? k : n - k) * fs / n);
+	}
+	fft_cplx(buf, buf + n, n);
+
+	/* centered, and windowed to smooth what falls between the samples */
+	for (k = 0; k < n; k++) {
+		(*taps)[k] = (float)(creal(buf[(k + n / 2) % n]) / n *
+		    (0.5 - 0.5 * cos(2.0 * M_PI * k / n)));
+	}
+	*ntaps = n;
+	free(buf);
+	return 0;
+}
+
+/*
+ * Read the taps of a filter from path, as numbers separated by white space
+ */
+static int
+load_taps(const char *path, float **taps, u_int *ntaps)
+{
+	FILE *fp;
+	float tap;
+	int res;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		return E_FIR_TAPS;
+	}
+	if ((*taps = malloc(sizeof(float) * FIR_MAX_TAPS)) == NULL) {
+		fclose(fp);
+		return E_NO_MEMORY;
+	}
+	*ntaps = 0;
+	while ((res = fscanf(fp, "%f", &tap)) == 1 && *ntaps < FIR_MAX_TAPS) {
+		(*taps)[(*ntaps)++] = tap;
+	}
+	if (res != EOF || ferror(fp) || *ntaps == 0) {
+		fclose(fp);
+		free(*taps);
+		*taps = NULL;
+		return E_FIR_TAPS;
+	}
+	fclose(fp);
+	return 0;
+}
+
+/*
+ * Load the taps of the filter name, a built-in one (a, c or highpass)
+ * designed for a sample rate of fs, or the path of a file of taps
+ *
+ * The taps are kept until build_fir() turns them into the partitions, so
+ * that the arena can be sized to the length of the filter first.
+ */
+int
+load_fir(fir_t *fir, const char *name, u_int fs)
+{
+	memset(fir, 0, sizeof(*fir));
+	if (preset_response(name, 1000.0) >= 0.0) {
+		return design_preset(name, fs, &fir->taps, &fir->ntaps);
+	}
+	return load_taps(name, &fir->taps, &fir->ntaps);
+}
+
+/*
+ * Size of the arena the filter loaded in fir takes
+ */
+size_t
+fir_arena_size(const fir_t *fir)
+{
+	size_t n, npart;
+
+	n = 2 * FIR_BLOCK;
+	npart = (fir->ntaps + FIR_BLOCK - 1) / FIR_BLOCK;
+	return 2 * ARENA_ROUND(sizeof(cplx) * npart * n) +
+	    ARENA_ROUND(sizeof(cplx) * 2 * n) +
+	    ARENA_ROUND(sizeof(cplx) * n / 2) +
+	    ARENA_ROUND(sizeof(float) * n) +
+	    ARENA_ROUND(sizeof(float) * FIR_BLOCK);
+}
+
+/*
+ * Turn the taps loaded in fir into the spectra of the partitions, with the
+ * buffers taken from the arena
+ */
+int
+build_fir(fir_t *fir, arena_t *arena)
+{
+	u_int p, j, n;
+
+	n = 2 * FIR_BLOCK;
+	fir->npart = (fir->ntaps + FIR_BLOCK - 1) / FIR_BLOCK;
+	fir->parts = arena_alloc(arena, sizeof(cplx) * fir->npart * n);
+	fir->line = arena_alloc(arena, sizeof(cplx) * fir->npart * n);
+	fir->work = arena_alloc(arena, sizeof(cplx) * 2 * n);
+	fir->twiddles = arena_alloc(arena, sizeof(cplx) * n / 2);
+	fir->input = arena_alloc(arena, sizeof(float) * n);
+	fir->output = arena_alloc(arena, sizeof(float) * FIR_BLOCK);
+	if (fir->parts == NULL || fir->line == NULL || fir->work == NULL ||
+	    fir->twiddles == NULL || fir->input == NULL ||
+	    fir->output == NULL) {
+		return E_NO_MEMORY;
+	}
+	fft_twiddles(fir->twiddles, n);
+
+	for (p = 0; p < fir->npart; p++) {
+		for (j = 0; j < n; j++) {
+			fir->work[j] = j < FIR_BLOCK &&
+			    p * FIR_BLOCK + j < fir->ntaps ?
+			    fir->taps[p * FIR_BLOCK + j] : 0.0f;
+		}
+		fft_cplx_table(fir->work, fir->work + n, fir->twiddles, n);
+		memcpy(fir->parts + (size_t)p * n, fir->work, sizeof(cplx) * n);
+	}
+	free_fir(fir);
+
+	return 0;
+}
+
+/*
+ * Free the taps, if they were loaded but never built, the rest belongs to
+ * the arena
+ */
+void
+free_fir(fir_t *fir)
+{
+	free(fir->taps);
+	fir->taps = NULL;
+}
+
+/*
+ * Filter the block of inputs just completed into the next outputs
+ */
+static void
+fir_block(fir_t *fir)
+{
+	u_int p, j, n, k;
+	const cplx *h, *x;
+	cplx *y;
+
+	n = 2 * FIR_BLOCK;
+	fir->newest = (fir->newest + 1) % fir->npart;
+	y = fir->line + (size_t)fir->newest * n;
+	for (j = 0; j < n; j++) {
+		y[j] = fir->input[j];
+	}
+	fft_cplx_table(y, fir->work, fir->twiddles, n);
+
+	y = fir->work;
+	memset(y, 0, sizeof(cplx) * n);
+	for (p = 0; p < fir->npart; p++) {
+		k = (fir->newest + fir->npart - p) % fir->npart;
+		h = fir->parts + (size_t)p * n;
+		x = fir->line + (size_t)k * n;
+		for (j = 0; j < n; j++) {
+			y[j] += h[j] * x[j];
+		}
+	}
+
+	/* the inverse fft, as the forward one of the conjugate */
+	for (j = 0; j < n; j++) {
+		y[j] = conj(y[j]);
+	}
+	fft_cplx_table(y, y + n, fir->twiddles, n);
+	for (j = 0; j < FIR_BLOCK; j++) {
+		fir->output[j] = (float)(creal(y[FIR_BLOCK + j]) / n);
+	}
+
+	memmove(fir->input, fir->input + FIR_BLOCK,
+	    sizeof(float) * FIR_BLOCK);
+}
+
+/*
+ * Filter n normalized samples in place
+ *
+ * The samples come out FIR_BLOCK samples late, so any frame size works and
+ * the filter runs on as one stream from frame to frame.
+ */
+void
+fir(fir_t *fir, float *pcm, u_int n)
+{
+	u_int i;
+	float x;
+
+	for (i = 0; i < n; i++) {
+		x = pcm[i];
+		pcm[i] = fir->output[fir->fill];
+		fir->input[FIR_BLOCK + fir->fill] = x;
+		if (++fir->fill == FIR_BLOCK) {
+			fir_block(fir);
+			fir->fill = 0;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_FIR_H
+#define AUDIO_FIR_H
+
+#include <sys/types.h>
+
+#include "arena.h"
+#include "fft.h"
+
+#define FIR_BLOCK 256           /* samples per partition, and of latency */
+#define FIR_PRESET_TAPS 8192    /* taps of the built-in filters */
+#define FIR_MAX_TAPS 65536      /* taps read from a file at most */
+#define FIR_HIGHPASS 40.0       /* corner of the "highpass" preset, Hz */
+
+/*
+ * FIR filter applied by uniformly partitioned overlap-save convolution
+ *
+ * The taps are cut into npart partitions of FIR_BLOCK taps, each kept as
+ * the spectrum of an fft of 2 * FIR_BLOCK points. Every FIR_BLOCK input
+ * samples, the spectrum of the last 2 * FIR_BLOCK inputs is pushed into a
+ * delay line of npart spectra, each multiplied with the spectrum of its
+ * partition and summed, and the inverse fft of the sum yields the next
+ * FIR_BLOCK outputs. A long response thus costs one pair of small ffts per
+ * block plus a multiply per tap, instead of a multiply per tap per sample,
+ * and the latency stays at one block whatever the length.
+ */
+typedef struct fir_t {
+	u_int ntaps;     /* taps of the filter */
+	u_int npart;     /* partitions of the taps */
+	u_int newest;    /* spectrum of the delay line last pushed */
+	u_int fill;      /* samples of the current block */
+	float *taps;     /* ntaps taps, until build_fir() */
+	cplx *parts;     /* npart spectra of the partitions */
+	cplx *line;      /* npart spectra of the past input blocks */
+	cplx *work;      /* 2 * 2 * FIR_BLOCK points of fft and its scratch */
+	cplx *twiddles;  /* FIR_BLOCK twiddle factors of the ffts */
+	float *input;    /* the last 2 * FIR_BLOCK inputs */
+	float *output;   /* the outputs of the previous block */
+} fir_t;
+
+int load_fir(fir_t *fir, const char *name, u_int fs);
+size_t fir_arena_size(const fir_t *fir);
+int build_fir(fir_t *fir, arena_t *arena);
+void free_fir(fir_t *fir);
+void fir(fir_t *fir, float *pcm, u_int n);
+
+#endif
@@ -0,0 +1,570 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/types.h>
+#include <sys/audioio.h>
+#include <sys/ioctl.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_ctrl.h"
+#include "audio_stream.h"
+#include "error_codes.h"
+#include "generator.h"
+#include "pcm.h"
+#include "rt.h"
+
+#define GEN_BLOCK 1024 /* samples generated at a time */
+
+/*
+ * Two buffers of the output, one filled by the generator while the other is
+ * written out by the writer thread
+ */
+typedef struct gen_writer_t {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;    /* a buffer was filled or emptied */
+	audio_ctrl_t *ctrl;
+	audio_stream_t stream;  /* layout of a full buffer */
+	u_char *data[2];
+	u_int size[2];          /* bytes to write, 0 while the buffer is free */
+	int done;               /* no more buffers will be filled */
+	int res;                /* error of the writer, which stops */
+} gen_writer_t;
+
+static const char *signal_names[] = {
+	"sine", "tones", "white", "pink", "sweep", "impulse"
+};
+
+/*
+ * Parse a comma separated list of up to max numbers
+ */
+static int
+parse_numbers(const char *p, double *v, u_int max, u_int *n)
+{
+	char *ep;
+
+	*n = 0;
+	for (;;) {
+		if (*n >= max) {
+			return E_GEN_SIGNAL;
+		}
+		v[(*n)++] = strtod(p, &ep);
+		if (ep == p) {
+			return E_GEN_SIGNAL;
+		}
+		if (ep[0] == '\0') {
+			return 0;
+		}
+		if (ep[0] != ',') {
+			return E_GEN_SIGNAL;
+		}
+		p = ep + 1;
+	}
+}
+
+static float
+uniform(uint64_t *x)
+{
+	*x ^= *x >> 12;
+	*x ^= *x << 25;
+	*x ^= *x >> 27;
+	return (float)(int32_t)((*x * 0x2545f4914f6cdd1dULL) >> 32) /
+	    2147483648.0f;
+}
+
+/*
+ * Fill block with n samples of noise, uniform white noise of unit rms run
+ * through a pinking filter if pink
+ *
+ * The filter is Paul Kellet's, a sum of first order low-passes within
+ * 0.05 dB of -3 dB per octave above 10 Hz.
+ */
+static void
+noise_block(gen_noise_t *s, float *block, u_int n, int pink, float gain)
+{
+	u_int i;
+	float w, x, *b;
+
+	b = s->b;
+	for (i = 0; i < n; i++) {
+		w = uniform(&s->rng) * 1.7320508f;
+		if (pink) {
+			b[0] = 0.99886f * b[0] + w * 0.0555179f;
+			b[1] = 0.99332f * b[1] + w * 0.0750759f;
+			b[2] = 0.96900f * b[2] + w * 0.1538520f;
+			b[3] = 0.86650f * b[3] + w * 0.3104856f;
+			b[4] = 0.55000f * b[4] + w * 0.5329522f;
+			b[5] = -0.7616f * b[5] - w * 0.0168980f;
+			x = b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] +
+			    w * 0.5362f;
+			b[6] = w * 0.115926f;
+			w = x;
+		}
+		block[i] = w * gain;
+	}
+}
+
+/*
+ * Add n samples of a sine of amplitude from the table to out
+ */
+static void
+oscillate(const float *restrict table, float *restrict out, u_int n,
+    uint32_t phase, uint32_t step, float amplitude)
+{
+	u_int i;
+	uint32_t p, idx;
+	float frac;
+
+	for (i = 0; i < n; i++) {
+		p = phase + (uint32_t)i * step;
+		idx = p >> GEN_FRAC_BITS;
+		frac = (float)(p & ((1U << GEN_FRAC_BITS) - 1)) *
+		    (1.0f / (float)(1U << GEN_FRAC_BITS));
+		out[i] += amplitude *
+		    (table[idx] + frac * (table[idx + 1] - table[idx]));
+	}
+}
+
+/*
+ * Parse the signal spec and set up its oscillators
+ *
+ * spec is sine:f, tones:f1,f2,..., white, pink, sweep:f1,f2,seconds or
+ * impulse:rate. level is the peak of the signal in dBFS, or for noise the
+ * level of a sine of the same rms; the tones of a multitone share it.
+ */
+int
+build_generator(generator_t *g, const char *spec, int level,
+    u_int channels, u_int fs, u_int nblock)
+{
+	u_int i, k, n, c;
+	size_t len;
+	const char *args;
+	double v[GEN_MAX_TONES];
+	float rms, block[GEN_BLOCK];
+	gen_noise_t probe;
+	int res;
+
+	memset(g, 0, sizeof(*g));
+	g->fs = fs;
+	g->channels = channels;
+	g->amplitude = (float)pow(10.0, level / 20.0);
+
+	len = strcspn(spec, ":");
+	args = spec[len] == ':' ? spec + len + 1 : NULL;
+	for (k = 0; k < sizeof(signal_names) / sizeof(signal_names[0]); k++) {
+		if (strlen(signal_names[k]) == len &&
+		    strncmp(spec, signal_names[k], len) == 0) {
+			break;
+		}
+	}
+	g->kind = k;
+
+	n = 0;
+	if (args != NULL &&
+	    (res = parse_numbers(args, v, GEN_MAX_TONES, &n)) != 0) {
+		return res;
+	}
+	switch (g->kind) {
+	case GEN_SINE:
+	case GEN_TONES:
+		if (n == 0 || (g->kind == GEN_SINE && n != 1)) {
+			return E_GEN_SIGNAL;
+		}
+		break;
+	case GEN_WHITE:
+	case GEN_PINK:
+		if (n != 0) {
+			return E_GEN_SIGNAL;
+		}
+		break;
+	case GEN_SWEEP:
+		if (n != 3 || !(v[1] > v[0]) || !(v[2] > 0.0)) {
+			return E_GEN_SIGNAL;
+		}
+		n = 2;
+		break;
+	case GEN_IMPULSE:
+		if (n != 1) {
+			return E_GEN_SIGNAL;
+		}
+		break;
+	default:
+		return E_GEN_SIGNAL;
+	}
+	for (i = 0; i < n; i++) {
+		if (!(v[i] > 0.0) || v[i] >= fs / 2.0) {
+			return E_GEN_SIGNAL;
+		}
+	}
+
+	for (i = 0; i <= GEN_TABLE_SIZE; i++) {
+		g->table[i] = (float)sin(2.0 * M_PI * i / GEN_TABLE_SIZE);
+	}
+
+	switch (g->kind) {
+	case GEN_SINE:
+	case GEN_TONES:
+		g->ntones = n;
+		for (i = 0; i < n; i++) {
+			g->step[i] = (uint32_t)llround(v[i] / fs * 4294967296.0);
+		}
+		g->amplitude /= (float)n;
+		break;
+	case GEN_SWEEP:
+		g->f1 = v[0];
+		g->f2 = v[1];
+		g->length = (u_long)(v[2] * fs);
+		g->rate = g->f1 / fs;
+		g->ratio = pow(g->f2 / g->f1, 1.0 / g->length);
+		break;
+	case GEN_IMPULSE:
+		g->period = fs / v[0];
+		break;
+	default:
+		g->noise = calloc(channels, sizeof(gen_noise_t));
+		if (g->noise == NULL) {
+			return E_NO_MEMORY;
+		}
+		for (c = 0; c < channels; c++) {
+			g->noise[c].rng = 0x9e3779b97f4a7c15ULL * (c + 1);
+		}
+		/* rms of a sine of the peak amplitude */
+		g->amplitude *= (float)M_SQRT1_2;
+		if (g->kind == GEN_PINK) {
+			/* bring the pinking filter to unit rms */
+			memset(&probe, 0, sizeof(probe));
+			probe.rng = 0x9e3779b97f4a7c15ULL;
+			rms = 0.0f;
+			for (i = 0; i < 64; i++) {
+				noise_block(&probe, block, GEN_BLOCK, 1, 1.0f);
+				for (k = 0; k < GEN_BLOCK; k++) {
+					rms += block[k] * block[k];
+				}
+			}
+			g->amplitude /= sqrtf(rms / (64 * GEN_BLOCK));
+		}
+		break;
+	}
+
+	g->nblock = nblock > 0 ? nblock : GEN_BLOCK;
+	if ((g->block = malloc(sizeof(float) * g->nblock)) == NULL) {
+		free_generator(g);
+		return E_NO_MEMORY;
+	}
+	return 0;
+}
+
+void
+free_generator(generator_t *g)
+{
+	free(g->noise);
+	free(g->block);
+	g->noise = NULL;
+	g->block = NULL;
+}
+
+static void
+sweep_block(generator_t *g, float *block, u_int n)
+{
+	u_int i, idx;
+	double x, frac;
+
+	for (i = 0; i < n; i++) {
+		x = g->sweep * GEN_TABLE_SIZE;
+		idx = (u_int)x;
+		frac = x - idx;
+		block[i] = g->amplitude * (float)(g->table[idx] +
+		    frac * (g->table[idx + 1] - g->table[idx]));
+		g->sweep += g->rate;
+		if (g->sweep >= 1.0) {
+			g->sweep -= 1.0;
+		}
+		g->rate *= g->ratio;
+		if (++g->position == g->length) {
+			g->position = 0;
+			g->sweep = 0.0;
+			g->rate = g->f1 / g->fs;
+		}
+	}
+}
+
+static void
+impulse_block(generator_t *g, float *block, u_int n)
+{
+	memset(block, 0, sizeof(float) * n);
+	for (; g->next < n; g->next += g->period) {
+		block[(u_int)g->next] = g->amplitude;
+	}
+	g->next -= n;
+}
+
+/*
+ * Generate nframes interleaved sample frames
+ */
+void
+generate(generator_t *g, float *pcm, u_int nframes)
+{
+	u_int i, c, t, n, done, channels;
+	float *out, *block;
+
+	channels = g->channels;
+	block = g->block;
+	for (done = 0; done < nframes; done += n) {
+		n = nframes - done < g->nblock ? nframes - done : g->nblock;
+		out = pcm + (size_t)done * channels;
+
+		switch (g->kind) {
+		case GEN_WHITE:
+		case GEN_PINK:
+			for (c = 0; c < channels; c++) {
+				noise_block(&g->noise[c], block, n,
+				    g->kind == GEN_PINK, g->amplitude);
+				for (i = 0; i < n; i++) {
+					out[(size_t)i * channels + c] =
+					    block[i];
+				}
+			}
+			continue;
+		case GEN_SWEEP:
+			sweep_block(g, block, n);
+			break;
+		case GEN_IMPULSE:
+			impulse_block(g, block, n);
+			break;
+		default:
+			memset(block, 0, sizeof(float) * n);
+			for (t = 0; t < g->ntones; t++) {
+				oscillate(g->table, block, n, g->phase[t],
+				    g->step[t], g->amplitude);
+				g->phase[t] += (uint32_t)n * g->step[t];
+			}
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			for (c = 0; c < channels; c++) {
+				out[(size_t)i * channels + c] = block[i];
+			}
+		}
+	}
+}
+
+static void *
+writer_thread(void *arg)
+{
+	gen_writer_t *w;
+	audio_stream_t s;
+	u_int k;
+	int res;
+
+	w = arg;
+	pthread_mutex_lock(&w->lock);
+	for (k = 0;; k ^= 1) {
+		while (w->size[k] == 0 && !w->done) {
+			pthread_cond_wait(&w->cond, &w->lock);
+		}
+		if (w->size[k] == 0) {
+			break;
+		}
+		s = w->stream;
+		if (w->size[k] != s.total_size) {
+			/* the last buffer, cut short */
+			s.total_size = w->size[k];
+			s.total_samples = s.total_size /
+			    (w->ctrl->config.precision / STREAM_BYTE_SIZE);
+		}
+		pthread_mutex_unlock(&w->lock);
+		res = stream(*w->ctrl, s, w->data[k]);
+		pthread_mutex_lock(&w->lock);
+		w->size[k] = 0;
+		pthread_cond_signal(&w->cond);
+		if (res != 0) {
+			w->res = res;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+/*
+ * Play a generated signal into play, a device, file or pipe
+ *
+ * The signal is generated and converted into one of two buffers of ms
+ * while the writer thread streams out the other, so the device is kept fed
+ * as long as a buffer is generated faster than it plays. seconds of 0 play
+ * until an error, such as the reader of a pipe going away.
+ */
+int
+run_generator(const char *play, const char *spec, int level,
+    audio_config_t config, u_int ms, u_int seconds, rt_config_t rt,
+    gen_result_t *result)
+{
+	audio_ctrl_t ctrl;
+	generator_t g;
+	gen_writer_t w;
+	pcm_converter_t converter;
+	audio_info_t info;
+	struct timespec start, end;
+	float *pcm;
+	u_long total;
+	u_int k, n, nframes, bps;
+	int res, started;
+
+	memset(result, 0, sizeof(*result));
+	memset(&w, 0, sizeof(w));
+	memset(&g, 0, sizeof(g));
+	pcm = NULL;
+	started = 0;
+
+	if ((res = build_audio_ctrl(&ctrl, play, AUMODE_PLAY)) != 0) {
+		return res;
+	}
+	if ((res = update_audio_ctrl(&ctrl, config)) != 0) {
+		goto done;
+	}
+	res = build_generator(&g, spec, level, ctrl.config.channels,
+	    ctrl.config.sample_rate, GEN_BLOCK);
+	if (res != 0) {
+		goto done;
+	}
+	res = build_stream_from_ctrl(ctrl, ms, &w.stream);
+	if (res != 0) {
+		goto done;
+	}
+	/* the format the device settled on must be one we can write */
+	res = build_converter(&converter, ctrl.config.precision,
+	    ctrl.config.encoding);
+	if (res != 0) {
+		goto done;
+	}
+
+	w.ctrl = &ctrl;
+	result->sample_rate = ctrl.config.sample_rate;
+	bps = ctrl.config.precision / STREAM_BYTE_SIZE;
+	nframes = w.stream.total_samples / ctrl.config.channels;
+	pcm = malloc(sizeof(float) * w.stream.total_samples);
+	w.data[0] = malloc(w.stream.total_size);
+	w.data[1] = malloc(w.stream.total_size);
+	if (pcm == NULL || w.data[0] == NULL || w.data[1] == NULL) {
+		res = E_NO_MEMORY;
+		goto done;
+	}
+	if (rt.lock) {
+		result->lock_res = rt_lockall();
+		rt_prefault(pcm, sizeof(float) * w.stream.total_samples, 1);
+		rt_prefault(w.data[0], w.stream.total_size, 1);
+		rt_prefault(w.data[1], w.stream.total_size, 1);
+	}
+
+	pthread_mutex_init(&w.lock, NULL);
+	pthread_cond_init(&w.cond, NULL);
+	if (pthread_create(&w.thread, NULL, writer_thread, &w) != 0) {
+		res = E_GEN_THREAD;
+		goto destroy;
+	}
+	started = 1;
+	if (rt.priority > 0) {
+		result->rt_res = rt_priority(w.thread, rt.priority);
+	}
+
+	total = (u_long)seconds * ctrl.config.sample_rate;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (k = 0; seconds == 0 || result->nframes < total; k ^= 1) {
+		n = nframes;
+		if (seconds != 0 && total - result->nframes < n) {
+			n = total - result->nframes;
+		}
+		generate(&g, pcm, n);
+
+		pthread_mutex_lock(&w.lock);
+		if (w.size[k] != 0 && w.res == 0) {
+			result->nwaits++;
+		}
+		while (w.size[k] != 0 && w.res == 0) {
+			pthread_cond_wait(&w.cond, &w.lock);
+		}
+		pthread_mutex_unlock(&w.lock);
+		if (w.res != 0) {
+			break;
+		}
+
+		w.stream.total_samples = n * ctrl.config.channels;
+		res = from_normalized_pcm(w.stream, pcm, w.data[k]);
+		w.stream.total_samples = nframes * ctrl.config.channels;
+		if (res != 0) {
+			break;
+		}
+
+		pthread_mutex_lock(&w.lock);
+		w.size[k] = n * ctrl.config.channels * bps;
+		pthread_cond_signal(&w.cond);
+		pthread_mutex_unlock(&w.lock);
+		result->nframes += n;
+	}
+
+	pthread_mutex_lock(&w.lock);
+	w.done = 1;
+	pthread_cond_signal(&w.cond);
+	pthread_mutex_unlock(&w.lock);
+	pthread_join(w.thread, NULL);
+	started = 0;
+	if (res == 0) {
+		res = w.res;
+	}
+
+	if (!ctrl.sink) {
+		/* let the device play what it was given */
+		ioctl(ctrl.fd, AUDIO_DRAIN);
+		if (ioctl(ctrl.fd, AUDIO_GETINFO, &info) == 0) {
+			result->underrun = info.play.error != 0;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	result->seconds = (end.tv_sec - start.tv_sec) +
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+
+destroy:
+	if (started) {
+		pthread_join(w.thread, NULL);
+	}
+	pthread_cond_destroy(&w.cond);
+	pthread_mutex_destroy(&w.lock);
+done:
+	free(pcm);
+	free(w.data[0]);
+	free(w.data[1]);
+	free_generator(&g);
+	close_audio_ctrl(&ctrl);
+	return res;
+}
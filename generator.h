@@ -0,0 +1,110 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_GENERATOR_H
+#define AUDIO_GENERATOR_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "audio_ctrl.h"
+#include "rt.h"
+
+#define GEN_TABLE_BITS 12     /* log2 of the points of the sine table */
+#define GEN_TABLE_SIZE (1 << GEN_TABLE_BITS)
+#define GEN_FRAC_BITS (32 - GEN_TABLE_BITS) /* phase bits between points */
+#define GEN_MAX_TONES 32
+#define GEN_DEFAULT_LEVEL -6  /* dBFS */
+
+#define GEN_SINE 0
+#define GEN_TONES 1
+#define GEN_WHITE 2
+#define GEN_PINK 3
+#define GEN_SWEEP 4
+#define GEN_IMPULSE 5
+
+/*
+ * Noise state of one channel
+ */
+typedef struct gen_noise_t {
+	uint64_t rng;  /* xorshift state */
+	float b[7];    /* state of the pinking filter */
+} gen_noise_t;
+
+/*
+ * Test signal generator
+ *
+ * Oscillators read a sine table with linear interpolation, driven by a 32
+ * bit phase accumulator whose top GEN_TABLE_BITS pick the point. The phase
+ * of every sample of a block is worked out from the phase at the start of
+ * the block, so the loops carry no dependency from one sample to the next
+ * and are turned into vector code. Periodic signals are generated once and
+ * copied to every channel, noise is generated for every channel on its own
+ * so that channels are uncorrelated.
+ */
+typedef struct generator_t {
+	u_int kind;        /* GEN_* */
+	u_int fs;          /* sample rate */
+	u_int channels;    /* channels of the output */
+	float amplitude;   /* peak, or for noise the rms of a sine of that peak */
+	float table[GEN_TABLE_SIZE + 1]; /* one period, and the first again */
+	u_int ntones;      /* oscillators of GEN_SINE and GEN_TONES */
+	uint32_t phase[GEN_MAX_TONES];
+	uint32_t step[GEN_MAX_TONES];
+	double f1, f2;     /* GEN_SWEEP range */
+	double sweep;      /* GEN_SWEEP phase, in periods */
+	double rate;       /* GEN_SWEEP frequency, in periods per sample */
+	double ratio;      /* GEN_SWEEP growth of rate per sample */
+	u_long position;   /* GEN_SWEEP sample of the sweep */
+	u_long length;     /* GEN_SWEEP samples of one sweep */
+	double period;     /* GEN_IMPULSE samples between impulses */
+	double next;       /* GEN_IMPULSE samples to the next impulse */
+	gen_noise_t *noise; /* per channel, GEN_WHITE and GEN_PINK */
+	float *block;      /* one channel of a block */
+	u_int nblock;      /* samples of block */
+} generator_t;
+
+typedef struct gen_result_t {
+	u_long nframes;    /* sample frames written */
+	u_int sample_rate; /* of the output */
+	double seconds;    /* wall clock time */
+	u_long nwaits;     /* buffers the generator had to wait for */
+	int underrun;      /* the device flagged an underrun */
+	int rt_res;        /* errno of the refused priority, or 0 */
+	int lock_res;      /* errno of the refused mlockall(), or 0 */
+} gen_result_t;
+
+int build_generator(generator_t *g, const char *spec, int level,
+    u_int channels, u_int fs, u_int nblock);
+void free_generator(generator_t *g);
+void generate(generator_t *g, float *pcm, u_int nframes);
+int run_generator(const char *play, const char *spec, int level,
+    audio_config_t config, u_int ms, u_int seconds, rt_config_t rt,
+    gen_result_t *result);
+
+#endif
@@ -0,0 +1,122 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bars.h"
+#include "capture.h"
+#include "error_codes.h"
+#include "headless.h"
+#include "welch.h"
+
+static volatile sig_atomic_t headless_done;
+
+static void
+stop_headless(int sig)
+{
+	headless_done = 1;
+}
+
+/*
+ * Value of a bar as printed: its average magnitude, or its density in
+ * dBFS/Hz with BARS_WELCH
+ */
+static float
+bar_level(const capture_group_t *group, const bar_t *bar)
+{
+	if (bar->nbins == 0) {
+		return group->transform == BARS_WELCH ? WELCH_DB_FLOOR : 0.0f;
+	}
+	if (group->transform == BARS_WELCH) {
+		return bar->magnitude / (float)bar->nbins + WELCH_DB_FLOOR;
+	}
+	return bar->magnitude / (float)bar->nbins;
+}
+
+/*
+ * Print the spectrum of every device to stdout instead of drawing it
+ *
+ * One line is printed per spectrum: the index of the device, the number of
+ * the spectrum, the number of samples dropped by the driver so far, the drop
+ * rate in percent, with meters the levels of the frame, and the average
+ * magnitude of every bar. Runs until
+ * interrupted or until a device fails.
+ */
+int
+headless(capture_group_t *group)
+{
+	u_int i, j, seq, cseq;
+	u_int printed[MAX_CAPTURES];
+	int res;
+	const bar_t *bars;
+	const meter_levels_t *levels;
+	capture_t *c;
+	stream_stats_t stats;
+
+	signal(SIGINT, stop_headless);
+	signal(SIGTERM, stop_headless);
+	signal(SIGPIPE, stop_headless);
+
+	for (i = 0; i < group->ncaptures; i++) {
+		printed[i] = 0;
+	}
+
+	res = 0;
+	seq = 0;
+	while (!headless_done) {
+		seq = wait_captures(group, seq, HEADLESS_POLL_MS);
+		for (i = 0; i < group->ncaptures; i++) {
+			c = &group->captures[i];
+			if ((res = read_capture(c, &bars, &cseq, &stats)) != 0) {
+				return res;
+			}
+			if (cseq == printed[i]) {
+				continue;
+			}
+			printed[i] = cseq;
+
+			printf("%u %u %lu %.3f", i, cseq, stats.dropped,
+			    100.0f * drop_rate(stats, c->stream.precision));
+			if (group->meters) {
+				levels = capture_levels(c);
+				printf(" %.1f %.1f %.1f %.1f %.1f %.1f",
+				    levels->rms, levels->peak, levels->true_peak,
+				    levels->momentary, levels->short_term,
+				    levels->integrated);
+			}
+			for (j = 0; j < group->nbars; j++) {
+				printf(" %.3f", bar_level(group, &bars[j]));
+			}
+			putchar('\n');
+		}
+		fflush(stdout);
+	}
+	return res;
+}
@@ -31,6 +31,7 @@
 #include <curses.h>
 #include <err.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <math.h>
 #include <stdio.h>
@@ -38,14 +39,28 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "align.h"
+#include "arena.h"
 #include "audio_ctrl.h"
+#include "audio_file.h"
 #include "audio_stream.h"
+#include "bars.h"
+#include "batch.h"
+#include "capture.h"
 #include "colors.h"
 #include "decode.h"
 #include "draw.h"
 #include "draw_config.h"
 #include "error_codes.h"
 #include "fft.h"
+#include "generator.h"
+#include "headless.h"
+#include "qualify.h"
+#include "rt.h"
+#include "sweep.h"
+#include "thdn.h"
+#include "tracker.h"
+#include "welch.h"
 
 #define UNSET 0
 #define DEFAULT_STREAM_DURATION 150
@@ -57,8 +72,14 @@
 
 #define IS_UNSET(p) (p == UNSET)
 
+/*
+ * Build the draw config for the current screen
+ *
+ * The drawing space is split into a grid of ntiles tiles, one per device.
+ * Bars and boxes are sized to fit in a single tile.
+ */
 static inline int
-build_draw_config(draw_config_t *config)
+build_draw_config(draw_config_t *config, u_int ntiles)
 {
 	int rows, cols, x_padding, y_padding;
 
@@ -73,19 +94,25 @@ build_draw_config(draw_config_t *config)
 	config->max_h = rows - y_padding * 2;
 	config->max_w = cols - x_padding * 2;
 
+	config->ntiles = ntiles;
+	config->tile_cols = (u_int)ceilf(sqrtf((float)ntiles));
+	config->tile_rows = (ntiles + config->tile_cols - 1) / config->tile_cols;
+	config->tile_w = config->max_w / (int)config->tile_cols;
+	config->tile_h = config->max_h / (int)config->tile_rows;
+
 	if (IS_UNSET(config->bar_width)) {
 		config->bar_width = DEFAULT_BAR_WIDTH;
 	}
 
 	if (IS_UNSET(config->nbars)) {
-		config->nbars = (u_int)config->max_w/(config->bar_width + config->bar_space);
+		config->nbars = (u_int)config->tile_w/(config->bar_width + config->bar_space);
 	}
 
 	if (config->use_boxes) {
-		config->nboxes = (u_int)config->max_h/(config->box_height + config->box_space);
+		config->nboxes = (u_int)config->tile_h/(config->box_height + config->box_space);
 	} else {
 		config->nboxes = 1;
-		config->box_height = config->max_h / (config->nboxes + config->box_space);
+		config->box_height = config->tile_h / (config->nboxes + config->box_space);
 	}
 
 	if (config->use_color && config->use_boxes && config->bar_color2 >= 0) {
@@ -95,46 +122,113 @@ build_draw_config(draw_config_t *config)
 	return 0;
 }
 
-static const char * shortopts = "c:d:e:f:m:p:s:H:N:W:C:E:M:S:XU";
+/*
+ * Open the report of -t, -x or -k, standard output without a path
+ */
+static FILE *
+open_report(const char *path)
+{
+	FILE *fp;
+
+	if (path == NULL) {
+		return stdout;
+	}
+	if ((fp = fopen(path, "w")) == NULL) {
+		err(1, "%s", path);
+	}
+	return fp;
+}
+
+static void
+close_report(FILE *fp, const char *path)
+{
+	if (fp != stdout && fclose(fp) == EOF) {
+		err(1, "%s", path);
+	}
+}
+
+static const char * shortopts = "ab:c:d:e:f:g:j:klm:n:o:p:qr:s:t:w:x:y:A:DF:G:H:K:LN:P:R:T:W:Y:C:E:M:OS:XU";
 static struct option longopts[] = {
+	{ "aggregate",		no_argument,		NULL,	'a' },
+	{ "batch",		required_argument,	NULL,	'b' },
 	{ "channels", 		required_argument, 	NULL,	'c' },
 	{ "device", 		required_argument, 	NULL,	'd' },
 	{ "encoding",		required_argument,	NULL,	'e' },
 	{ "fft-samples",	required_argument,	NULL,	'f' },
+	{ "generate",		required_argument,	NULL,	'g' },
+	{ "jobs",		required_argument,	NULL,	'j' },
+	{ "align",		no_argument,		NULL,	'k' },
+	{ "meter",		no_argument,		NULL,	'l' },
 	{ "fft-fmin",		required_argument,	NULL,	'm' },
+	{ "duration",		required_argument,	NULL,	'n' },
+	{ "overlap",		required_argument,	NULL,	'o' },
 	{ "precision",		required_argument,	NULL,	'p' },
+	{ "qualify",		no_argument,		NULL,	'q' },
+	{ "report",		required_argument,	NULL,	'r' },
 	{ "sample-rate",	required_argument,	NULL,	's' },
+	{ "thdn",		required_argument,	NULL,	't' },
+	{ "weighting",		required_argument,	NULL,	'w' },
+	{ "sweep",		required_argument,	NULL,	'x' },
+	{ "play",		required_argument,	NULL,	'y' },
+	{ "level",		required_argument,	NULL,	'A' },
 	{ "color",		required_argument,	NULL,	'C' },
+	{ "mmap",		no_argument,		NULL,	'D' },
+	{ "fft-fmax",		required_argument,	NULL,	'F' },
 	{ "color-end",		required_argument,	NULL,	'E' },
+	{ "track",		required_argument,	NULL,	'G' },
 	{ "box-height",		required_argument,	NULL,	'H' },
+	{ "features",		required_argument,	NULL,	'K' },
+	{ "lock",		no_argument,		NULL,	'L' },
 	{ "milliseconds",	required_argument,	NULL,	'M' },
 	{ "num-bars",		required_argument,	NULL,	'N' },
+	{ "headless",		no_argument,		NULL,	'O' },
+	{ "cpus",		required_argument,	NULL,	'P' },
+	{ "rtprio",		required_argument,	NULL,	'R' },
 	{ "box-space",		required_argument,	NULL,	'S' },
+	{ "transform",		required_argument,	NULL,	'T' },
 	{ "use-colors",		no_argument,		NULL,	'U' },
 	{ "use-boxes",		no_argument,		NULL,	'X' },
 	{ "bar-width",		required_argument,	NULL,	'W' },
+	{ "decimate",		required_argument,	NULL,	'Y' },
 };
 
 int
 main(int argc, char *argv[])
 {
-	int c, ch, option, res;
-	u_int fft_samples, fft_fmin, ms;
-	const char *path;
-	float t;
+	int ch, headless_mode, mmap_mode, qualify_mode, meters, option, res;
+	int thdn_mode, align_mode, failed, nfailed, level;
+	u_int i, fft_samples, fft_fmin, fft_fmax, ms, npaths, transform;
+	u_int overlap, ntrack, decimation, sweep, duration;
+	float track[TRACK_MAX];
+	double limits[THDN_NLIMITS];
+	const char *paths[MAX_CAPTURES];
+	const char *features, *weighting, *play, *signal, *report_path;
+	FILE *report;
 	audio_ctrl_t rctrl;
 	audio_config_t audio_config;
-	audio_stream_t rstream;
 	color_t cstart, cend;
-	color_pair_t *cp;
 	color_pair_t **color_pairs;
-	fft_config_t fft_config;
 	draw_config_t draw_config;
+	capture_group_t group;
+	arena_t arena;
+	draw_buffers_t draw_buffers;
+	rt_config_t rt_config;
+	audio_file_t afile;
+	batch_config_t batch_config;
+	batch_result_t batch_result;
+	gen_result_t gen_result;
 
 	setprogname(argv[0]);
 	color_pairs = NULL;
+	arena.base = NULL;
 
-	path =                      DEFAULT_PATH;
+	npaths =                    0;
+	headless_mode =             0;
+	mmap_mode =                 0;
+	qualify_mode =              0;
+	thdn_mode =                 0;
+	align_mode =                0;
+	meters =                    0;
 
 	audio_config.buffer_size =  UNSET;
 	audio_config.channels =     UNSET;
@@ -153,17 +247,47 @@ main(int argc, char *argv[])
 	draw_config.box_space =     DEFAULT_BOX_SPACE;
 	draw_config.box_height =    DEFAULT_BOX_HEIGHT;
 
+	batch_config.output =       NULL;
+	batch_config.kind =         BATCH_SPECTRA;
+	batch_config.nthreads =     UNSET;
+
+	rt_config.priority =        0;
+	rt_config.lock =            0;
+	rt_config.ncpus =           0;
+
+	transform =                 BARS_FFT;
+	overlap =                   WELCH_OVERLAP;
+	ntrack =                    0;
+	decimation =                1;
 	fft_samples =               DEFAULT_NSAMPLES;
 	fft_fmin =                  DEFAULT_FMIN;
+	fft_fmax =                  0;
 	ms =                        DEFAULT_STREAM_DURATION;
+	features =                  NULL;
+	weighting =                 NULL;
+	play =                      NULL;
+	sweep =                     0;
+	signal =                    NULL;
+	level =                     GEN_DEFAULT_LEVEL;
+	duration =                  0;
+	report_path =               NULL;
 
 	while ((ch = getopt_long(argc, argv,shortopts, longopts, NULL)) != -1) {
 		switch (ch) {
+		case 'a':
+			batch_config.kind = BATCH_STATS;
+			break;
+		case 'b':
+			batch_config.output = optarg;
+			break;
 		case 'c':
 			decode_uint(optarg, &(audio_config.channels));
 			break;
 		case 'd':
-			path = optarg;
+			if (npaths >= MAX_CAPTURES) {
+				errx(1, get_error_msg(E_CAPTURE_TOO_MANY));
+			}
+			paths[npaths++] = optarg;
 			break;
 		case 'e':
 			decode_encoding(optarg, &(audio_config.encoding));
@@ -171,21 +295,86 @@ main(int argc, char *argv[])
 		case 'f':
 			decode_uint(optarg, &fft_samples);
 			break;
+		case 'g':
+			signal = optarg;
+			break;
+		case 'j':
+			decode_uint(optarg, &(batch_config.nthreads));
+			break;
+		case 'k':
+			align_mode = 1;
+			break;
+		case 'l':
+			meters = 1;
+			break;
 		case 'm':
 			decode_uint(optarg, &fft_fmin);
 			break;
+		case 'n':
+			decode_uint(optarg, &duration);
+			break;
+		case 'o':
+			decode_uint(optarg, &overlap);
+			break;
 		case 'p':
 			decode_uint(optarg, &(audio_config.precision));
 			break;
+		case 'q':
+			qualify_mode = 1;
+			break;
+		case 'r':
+			report_path = optarg;
+			break;
 		case 's':
 			decode_uint(optarg, &(audio_config.sample_rate));
 			break;
+		case 't':
+			thdn_mode = 1;
+			decode_limits(optarg, limits);
+			break;
+		case 'w':
+			weighting = optarg;
+			break;
+		case 'x':
+			decode_uint(optarg, &sweep);
+			break;
+		case 'y':
+			play = optarg;
+			break;
+		case 'A':
+			decode_int(optarg, &level);
+			break;
+		case 'D':
+			mmap_mode = 1;
+			break;
+		case 'F':
+			decode_uint(optarg, &fft_fmax);
+			break;
+		case 'G':
+			decode_freqs(optarg, track, TRACK_MAX, &ntrack);
+			break;
 		case 'H':
 			decode_uint(optarg, &(draw_config.box_height));
 			break;
+		case 'K':
+			features = optarg;
+			break;
+		case 'L':
+			rt_config.lock = 1;
+			break;
 		case 'N':
 			decode_uint(optarg, &(draw_config.nbars));
 			break;
+		case 'P':
+			decode_cpus(optarg, rt_config.cpus, RT_MAX_CPUS,
+			    &(rt_config.ncpus));
+			break;
+		case 'R':
+			decode_int(optarg, &(rt_config.priority));
+			break;
+		case 'T':
+			decode_transform(optarg, &transform);
+			break;
 		case 'C':
 			draw_config.use_color = 1;
 			decode_color(optarg, &(draw_config.bar_color));
@@ -200,6 +389,9 @@ main(int argc, char *argv[])
 		case 'M':
 			decode_uint(optarg, &ms);
 			break;
+		case 'O':
+			headless_mode = 1;
+			break;
 		case 'S':
 			decode_uint(optarg, &(draw_config.box_space));
 			break;
@@ -214,39 +406,177 @@ main(int argc, char *argv[])
 		case 'W':
 			decode_uint(optarg, &(draw_config.bar_width));
 			break;
+		case 'Y':
+			decode_uint(optarg, &decimation);
+			if (decimation == 0) {
+				errx(1, get_error_msg(E_DECIMATE_FACTOR));
+			}
+			break;
 		default:
 			// TODO - usage()
 			err(1, "%c is invalid argument", (char)ch);
 		}
 	}
 
-	if (initscr() == NULL) {
-		err(1, "can't initialize curses");
+	if (signal != NULL) {
+		res = run_generator(play != NULL ? play : DEFAULT_PATH, signal,
+		    level, audio_config, ms, duration, rt_config, &gen_result);
+		if (gen_result.rt_res != 0) {
+			warnx("rtprio %d: %s", rt_config.priority,
+			    strerror(gen_result.rt_res));
+		}
+		if (gen_result.lock_res != 0) {
+			warnx("memory not locked: %s",
+			    strerror(gen_result.lock_res));
+		}
+		if (res != 0) {
+			errx(1, get_error_msg(res));
+		}
+		/* not on stdout, which may carry the samples */
+		fprintf(stderr,
+		    "%lu frames in %.3f s (%.1fx real time), %lu waits%s\n",
+		    gen_result.nframes, gen_result.seconds,
+		    (double)gen_result.nframes / gen_result.sample_rate /
+		    gen_result.seconds, gen_result.nwaits,
+		    gen_result.underrun ? ", underrun" : "");
+		return 0;
 	}
 
-	cbreak();
-	noecho();
-	curs_set(0);
+	if (sweep > 0) {
+		report = open_report(report_path);
+		res = run_sweep(npaths > 0 ? paths[0] : NULL, play,
+		    audio_config, sweep, (float)fft_fmin, (float)fft_fmax,
+		    report);
+		if (res != 0) {
+			errx(1, get_error_msg(res));
+		}
+		close_report(report, report_path);
+		return 0;
+	}
 
-	if ((res = build_audio_ctrl(&rctrl, path, AUMODE_RECORD)) != 0) {
-		goto handle_error;
+	if (npaths == 0) {
+		paths[npaths++] = DEFAULT_PATH;
 	}
 
-	if ((res = update_audio_ctrl(&rctrl, audio_config)) != 0) {
-		goto handle_error;
+	if (qualify_mode) {
+		for (i = 0; i < npaths; i++) {
+			res = build_audio_ctrl(&rctrl, paths[i], AUMODE_RECORD);
+			if (res == 0) {
+				res = qualify(&rctrl, audio_config, ms, stdout);
+				close_audio_ctrl(&rctrl);
+			}
+			if (res != 0) {
+				errx(1, "%s: %s", paths[i], get_error_msg(res));
+			}
+		}
+		return 0;
 	}
 
-	if ((res = build_stream_from_ctrl(rctrl, ms, &rstream)) != 0) {
-		goto handle_error;
+	if (thdn_mode) {
+		report = open_report(report_path);
+		nfailed = 0;
+		for (i = 0; i < npaths; i++) {
+			res = measure_thdn(paths[i], audio_config, ms,
+			    fft_samples, (float)fft_fmin, (float)fft_fmax,
+			    limits, report, &failed);
+			if (res != 0) {
+				errx(1, "%s: %s", paths[i], get_error_msg(res));
+			}
+			nfailed += failed;
+		}
+		close_report(report, report_path);
+		return nfailed > 0 ? 2 : 0;
 	}
 
+	if (align_mode) {
+		report = open_report(report_path);
+		res = measure_align(paths, npaths, audio_config, ms,
+		    fft_samples, duration, (float)fft_fmin, (float)fft_fmax,
+		    report);
+		if (res != 0) {
+			errx(1, get_error_msg(res));
+		}
+		close_report(report, report_path);
+		return 0;
+	}
 
-	res = build_fft_config(&fft_config, fft_samples, rctrl.config.sample_rate, rstream.total_samples, (float)fft_fmin);
-	if (res != 0) {
-		goto handle_error;
+	if (batch_config.output != NULL) {
+		batch_config.milliseconds = ms;
+		if ((res = open_audio_file(&afile, paths[0], audio_config)) != 0) {
+			errx(1, get_error_msg(res));
+		}
+		res = run_batch(&afile, batch_config, fft_samples,
+		    (float)fft_fmin, &batch_result);
+		close_audio_file(&afile);
+		if (res != 0) {
+			errx(1, get_error_msg(res));
+		}
+		printf("%u intervals, %zu bytes in %.3f s (%.1f MB/s)\n",
+		    batch_result.nintervals, batch_result.nbytes,
+		    batch_result.seconds,
+		    (double)batch_result.nbytes / 1e6 / batch_result.seconds);
+		return 0;
+	}
+
+	build_capture_group(&group);
+	group.transform = transform;
+	group.overlap = overlap;
+	group.decimation = decimation;
+	group.weighting = weighting;
+	group.meters = meters;
+	if (ntrack > 0) {
+		group.transform = BARS_TRACK;
+		memcpy(group.track, track, sizeof(float) * ntrack);
+		draw_config.nbars = ntrack;
+	}
+	if (features != NULL) {
+		group.features_fd = open(features,
+		    O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (group.features_fd == -1) {
+			err(1, "%s", features);
+		}
+	}
+	for (i = 0; i < npaths; i++) {
+		res = add_capture(&group, paths[i], audio_config, ms,
+		    fft_samples, (float)fft_fmin, (float)fft_fmax, mmap_mode);
+		if (res != 0) {
+			errx(1, "%s: %s", paths[i], get_error_msg(res));
+		}
 	}
 
-	if ((res = build_draw_config(&draw_config)) != 0) {
+	if (headless_mode) {
+		if (IS_UNSET(draw_config.nbars)) {
+			draw_config.nbars = DEFAULT_BAR_COUNT;
+		}
+		res = build_arena(&arena,
+		    capture_arena_size(&group, draw_config.nbars));
+		if (res != 0) {
+			errx(1, get_error_msg(res));
+		}
+		res = start_captures(&group, draw_config.nbars, &arena,
+		    rt_config);
+		if (res != 0) {
+			errx(1, get_error_msg(res));
+		}
+		print_rt_status(stderr, &group);
+		res = headless(&group);
+		stop_captures(&group);
+		free_arena(&arena);
+		if (res != 0) {
+			errx(1, get_error_msg(res));
+		}
+		return 0;
+	}
+
+	if (initscr() == NULL) {
+		err(1, "can't initialize curses");
+	}
+
+	cbreak();
+	noecho();
+	curs_set(0);
+
+	if ((res = build_draw_config(&draw_config, group.ncaptures)) != 0) {
 		goto handle_error;
 	}
 
@@ -260,7 +590,7 @@ main(int argc, char *argv[])
 		start_color();
 	}
 
-	build_draw_config(&draw_config);
+	build_draw_config(&draw_config, group.ncaptures);
 	if ((res = validate_draw_config(&draw_config)) != 0) {
 		goto handle_error;
 	}
@@ -282,6 +612,22 @@ main(int argc, char *argv[])
 		}
 	}
 
+	/* every working buffer of the session comes from a single arena */
+	res = build_arena(&arena, capture_arena_size(&group, draw_config.nbars) +
+	    draw_arena_size(draw_config, group.ncaptures));
+	if (res != 0) {
+		goto handle_error;
+	}
+	res = build_draw_buffers(&draw_buffers, &arena, draw_config,
+	    group.ncaptures);
+	if (res != 0) {
+		goto handle_error;
+	}
+	res = start_captures(&group, draw_config.nbars, &arena, rt_config);
+	if (res != 0) {
+		goto handle_error;
+	}
+
 	option = DRAW_FREQ;
 	for (;;) {
 		if (option >= E_UNHANDLED) {
@@ -290,22 +636,28 @@ main(int argc, char *argv[])
 		}
 
 		if (option == DRAW_INFO) {
-			option = draw_info(rctrl, rstream, fft_config, draw_config);
+			option = draw_info(&group, draw_config);
 		} else if (option == DRAW_FREQ) {
-			option = draw_frequency(rctrl, rstream, fft_config,
-			    draw_config);
+			option = draw_frequency(&group, draw_config,
+			    &draw_buffers);
+		} else if (option == DRAW_WATERFALL) {
+			option = draw_waterfall(&group, draw_config);
 		} else {
 			break;
 		}
 		clear();
 	}
 
+	stop_captures(&group);
+	free_arena(&arena);
 	endwin();
 	if (color_pairs != NULL) {
 		cleanup_colors(color_pairs, draw_config.ncolors);
 	}
 	return 0;
 handle_error:
+	stop_captures(&group);
+	free_arena(&arena);
 	endwin();
 	if (color_pairs != NULL) {
 		cleanup_colors(color_pairs, draw_config.ncolors);
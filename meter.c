@@ -0,0 +1,312 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "error_codes.h"
+#include "meter.h"
+
+/*
+ * Size of the arena the meter of channels takes
+ */
+size_t
+meter_arena_size(u_int channels)
+{
+	return ARENA_ROUND(sizeof(meter_channel_t) * channels);
+}
+
+/*
+ * Build the meter of a stream of channels interleaved at fs, with the state
+ * of the channels taken from the arena
+ *
+ * The K-weighting filters are those of BS.1770 brought to fs through the
+ * bilinear transform.
+ */
+int
+build_meter(meter_t *meter, u_int channels, u_int fs, arena_t *arena)
+{
+	u_int p, j, n;
+	double k, q, vh, vb, a0, t, w, x;
+
+	memset(meter, 0, sizeof(*meter));
+	meter->channels = channels;
+	meter->block = fs / 10;
+	meter->state = arena_alloc(arena, sizeof(meter_channel_t) * channels);
+	if (meter->state == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	k = tan(M_PI * 1681.974450955533 / fs);
+	q = 0.7071752369554196;
+	vh = pow(10.0, 3.999843853973347 / 20.0);
+	vb = pow(vh, 0.4996667741545416);
+	a0 = 1.0 + k / q + k * k;
+	meter->shelf[0] = (vh + vb * k / q + k * k) / a0;
+	meter->shelf[1] = 2.0 * (k * k - vh) / a0;
+	meter->shelf[2] = (vh - vb * k / q + k * k) / a0;
+	meter->shelf[3] = 2.0 * (k * k - 1.0) / a0;
+	meter->shelf[4] = (1.0 - k / q + k * k) / a0;
+
+	k = tan(M_PI * 38.13547087602444 / fs);
+	q = 0.5003270373238773;
+	a0 = 1.0 + k / q + k * k;
+	meter->highpass[0] = 1.0;
+	meter->highpass[1] = -2.0;
+	meter->highpass[2] = 1.0;
+	meter->highpass[3] = 2.0 * (k * k - 1.0) / a0;
+	meter->highpass[4] = (1.0 - k / q + k * k) / a0;
+
+	/*
+	 * Phase p of a Hann windowed sinc of an even length, so that every
+	 * phase falls between two samples
+	 */
+	n = METER_TP_PHASES * METER_TP_TAPS;
+	for (p = 0; p < METER_TP_PHASES; p++) {
+		for (j = 0; j < METER_TP_TAPS; j++) {
+			x = (double)(METER_TP_TAPS - 1 - j) * METER_TP_PHASES + p;
+			t = x - (n - 1) / 2.0;
+			w = 0.5 - 0.5 * cos(2.0 * M_PI * (x + 0.5) / n);
+			meter->taps[p][j] = (float)(w * (fabs(t) < 1e-9 ? 1.0 :
+			    sin(M_PI * t / METER_TP_PHASES) /
+			    (M_PI * t / METER_TP_PHASES)));
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * One sample through a biquad in transposed direct form II
+ */
+static inline double
+biquad(const double *c, double *z, double x)
+{
+	double y;
+
+	y = c[0] * x + z[0];
+	z[0] = c[1] * x - c[3] * y + z[1];
+	z[1] = c[2] * x - c[4] * y;
+	return y;
+}
+
+/*
+ * Largest magnitude of the samples interpolated between two samples of a
+ * channel, METER_TP_TAPS / 2 samples back since the filter is symmetric
+ */
+static inline float
+interpolate(const meter_t *meter, const meter_channel_t *s)
+{
+	u_int p, j;
+	float y, best;
+	const float *x;
+
+	x = s->hist + s->pos;
+	best = 0.0f;
+	for (p = 0; p < METER_TP_PHASES; p++) {
+		y = 0.0f;
+		for (j = 0; j < METER_TP_TAPS; j++) {
+			y += meter->taps[p][j] * x[j];
+		}
+		y = fabsf(y);
+		best = y > best ? y : best;
+	}
+	return best;
+}
+
+/*
+ * Close a 100 ms block, and count the gating block ending on it
+ */
+static void
+close_block(meter_t *meter)
+{
+	u_int i, b;
+	double ms, lufs;
+
+	meter->newest = (meter->newest + 1) % METER_SUBBLOCKS;
+	meter->blocks[meter->newest] = meter->ksum / meter->block;
+	if (meter->nblocks < METER_SUBBLOCKS) {
+		meter->nblocks++;
+	}
+	meter->ksum = 0.0;
+	meter->kframes = 0;
+
+	if (meter->nblocks < METER_MOMENTARY) {
+		return;
+	}
+	ms = 0.0;
+	for (i = 0; i < METER_MOMENTARY; i++) {
+		ms += meter->blocks[(meter->newest + METER_SUBBLOCKS - i) %
+		    METER_SUBBLOCKS];
+	}
+	lufs = -0.691 + 10.0 * log10(ms / METER_MOMENTARY + 1e-30);
+	if (lufs > METER_HIST_MIN) {
+		b = (u_int)((lufs - METER_HIST_MIN) / METER_HIST_STEP);
+		meter->hist[b < METER_HIST_BINS ? b : METER_HIST_BINS - 1]++;
+	}
+}
+
+/*
+ * Meter n interleaved samples just converted
+ *
+ * The peak and the sum of squares are plain reductions over the chunk;
+ * the filters and the interpolator walk it sample by sample, channel after
+ * channel, carrying their state over from the previous chunk.
+ */
+void
+meter_update(meter_t *meter, const float *pcm, u_int n)
+{
+	u_int i;
+	float x, a, peak, tp;
+	double sumsq, y;
+	meter_channel_t *s;
+
+	sumsq = 0.0;
+	peak = meter->peak;
+	for (i = 0; i < n; i++) {
+		sumsq += (double)pcm[i] * pcm[i];
+		a = fabsf(pcm[i]);
+		peak = a > peak ? a : peak;
+	}
+	meter->sumsq += sumsq;
+	meter->peak = peak;
+	meter->nsamples += n;
+
+	tp = meter->true_peak;
+	for (i = 0; i < n; i++) {
+		x = pcm[i];
+		s = &meter->state[meter->ch];
+
+		y = biquad(meter->shelf, s->z, x);
+		y = biquad(meter->highpass, s->z + 2, y);
+		meter->ksum += y * y;
+
+		s->hist[s->pos] = x;
+		s->hist[s->pos + METER_TP_TAPS] = x;
+		if (++s->pos == METER_TP_TAPS) {
+			s->pos = 0;
+		}
+		a = interpolate(meter, s);
+		tp = a > tp ? a : tp;
+
+		if (++meter->ch == meter->channels) {
+			meter->ch = 0;
+			if (++meter->kframes == meter->block) {
+				close_block(meter);
+			}
+		}
+	}
+	meter->true_peak = tp > peak ? tp : peak;
+}
+
+static float
+to_db(double power)
+{
+	return power > 0.0 ? (float)(10.0 * log10(power)) : METER_FLOOR;
+}
+
+/*
+ * Loudness of the last nblocks blocks, at most METER_SUBBLOCKS
+ */
+static float
+loudness(const meter_t *meter, u_int nblocks)
+{
+	u_int i;
+	double ms;
+
+	if (meter->nblocks < nblocks) {
+		return METER_FLOOR;
+	}
+	ms = 0.0;
+	for (i = 0; i < nblocks; i++) {
+		ms += meter->blocks[(meter->newest + METER_SUBBLOCKS - i) %
+		    METER_SUBBLOCKS];
+	}
+	return ms > 0.0 ? -0.691f + to_db(ms / nblocks) : METER_FLOOR;
+}
+
+/*
+ * Integrated loudness of the gating blocks above the absolute gate, gated
+ * again 10 LU under their own loudness
+ */
+static float
+integrated(const meter_t *meter)
+{
+	u_int b, first;
+	double e, sum, count, gate;
+
+	sum = 0.0;
+	count = 0.0;
+	for (b = 0; b < METER_HIST_BINS; b++) {
+		e = pow(10.0, (METER_HIST_MIN + (b + 0.5) * METER_HIST_STEP +
+		    0.691) / 10.0);
+		sum += meter->hist[b] * e;
+		count += meter->hist[b];
+	}
+	if (count == 0.0) {
+		return METER_FLOOR;
+	}
+
+	gate = -0.691 + 10.0 * log10(sum / count) - 10.0;
+	first = gate > METER_HIST_MIN ?
+	    (u_int)((gate - METER_HIST_MIN) / METER_HIST_STEP) : 0;
+	sum = 0.0;
+	count = 0.0;
+	for (b = first; b < METER_HIST_BINS; b++) {
+		e = pow(10.0, (METER_HIST_MIN + (b + 0.5) * METER_HIST_STEP +
+		    0.691) / 10.0);
+		sum += meter->hist[b] * e;
+		count += meter->hist[b];
+	}
+	return count > 0.0 ? -0.691f + to_db(sum / count) : METER_FLOOR;
+}
+
+/*
+ * Read the levels of the frame metered since the last call and start the
+ * next one. The loudness carries on.
+ */
+void
+meter_read(meter_t *meter, meter_levels_t *levels)
+{
+	levels->rms = meter->nsamples > 0 ?
+	    to_db(2.0 * meter->sumsq / meter->nsamples) : METER_FLOOR;
+	levels->peak = meter->peak > 0.0f ?
+	    20.0f * log10f(meter->peak) : METER_FLOOR;
+	levels->true_peak = meter->true_peak > 0.0f ?
+	    20.0f * log10f(meter->true_peak) : METER_FLOOR;
+	levels->momentary = loudness(meter, METER_MOMENTARY);
+	levels->short_term = loudness(meter, METER_SUBBLOCKS);
+	levels->integrated = integrated(meter);
+
+	meter->sumsq = 0.0;
+	meter->peak = 0.0f;
+	meter->true_peak = 0.0f;
+	meter->nsamples = 0;
+}
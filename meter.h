@@ -0,0 +1,107 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_METER_H
+#define AUDIO_METER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "arena.h"
+
+#define METER_TP_PHASES 4      /* true peak oversampling */
+#define METER_TP_TAPS 12       /* taps of the interpolator per phase */
+#define METER_SUBBLOCKS 30     /* 100 ms blocks of the short-term loudness */
+#define METER_MOMENTARY 4      /* 100 ms blocks of a gating block */
+#define METER_HIST_MIN -70.0   /* absolute gate, LUFS */
+#define METER_HIST_STEP 0.1    /* LU per bin of the gating histogram */
+#define METER_HIST_BINS 800    /* up to +10 LUFS */
+#define METER_FLOOR -99.0f     /* level reported for silence */
+
+/*
+ * Levels of a device as of a spectrum
+ */
+typedef struct meter_levels_t {
+	float rms;        /* dBFS over the frame, 0 for a full scale sine */
+	float peak;       /* dBFS of the largest sample of the frame */
+	float true_peak;  /* dBTP of the frame, oversampled */
+	float momentary;  /* LUFS over the last 400 ms */
+	float short_term; /* LUFS over the last 3 s */
+	float integrated; /* LUFS since the start, gated */
+} meter_levels_t;
+
+/*
+ * Filter and interpolator state of one channel
+ */
+typedef struct meter_channel_t {
+	double z[4];                        /* state of the two biquads */
+	float hist[2 * METER_TP_TAPS];      /* the last samples, twice */
+	u_int pos;                          /* oldest sample of hist */
+} meter_channel_t;
+
+/*
+ * Level and loudness meter of an interleaved stream
+ *
+ * Loudness follows ITU-R BS.1770 and EBU R128: every channel goes through
+ * the K-weighting shelf and high-pass biquads, mean squares are summed over
+ * the channels, all weighted 1, in blocks of 100 ms, and 400 ms gating
+ * blocks every 100 ms are counted in a histogram of 0.1 LU bins, so the
+ * integrated loudness needs no more memory after an hour than after a
+ * second. The true peak interpolates METER_TP_PHASES - 1 samples between
+ * every two with a polyphase windowed sinc.
+ *
+ * Fed by meter_update() in chunks as they are converted, the samples are
+ * still in the cache.
+ */
+typedef struct meter_t {
+	u_int channels;      /* channels of the stream */
+	u_int ch;            /* channel of the next sample */
+	double shelf[5];     /* b0 b1 b2 a1 a2 of the K-weighting shelf */
+	double highpass[5];  /* b0 b1 b2 a1 a2 of the K-weighting high-pass */
+	/* taps of every phase of the interpolator, for the oldest sample first */
+	float taps[METER_TP_PHASES][METER_TP_TAPS];
+	meter_channel_t *state; /* per channel */
+	double sumsq;        /* of the samples of the frame */
+	float peak;          /* largest magnitude of the frame */
+	float true_peak;     /* largest interpolated magnitude of the frame */
+	u_long nsamples;     /* samples of the frame */
+	double ksum;         /* K-weighted squares of the current block */
+	u_int kframes;       /* sample frames of the current block */
+	u_int block;         /* sample frames of a 100 ms block */
+	double blocks[METER_SUBBLOCKS]; /* mean squares of the last blocks */
+	u_int nblocks;       /* blocks seen, saturating at METER_SUBBLOCKS */
+	u_int newest;        /* newest of blocks */
+	uint32_t hist[METER_HIST_BINS]; /* gating blocks above the gate */
+} meter_t;
+
+size_t meter_arena_size(u_int channels);
+int build_meter(meter_t *meter, u_int channels, u_int fs, arena_t *arena);
+void meter_update(meter_t *meter, const float *pcm, u_int n);
+void meter_read(meter_t *meter, meter_levels_t *levels);
+
+#endif
@@ -0,0 +1,191 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "filterbank.h"
+#include "mfcc.h"
+
+/*
+ * Size of the arena the extractor takes
+ */
+size_t
+mfcc_arena_size(u_int nbands, u_int ncoeffs, fft_config_t config)
+{
+	size_t record_size;
+
+	if (ncoeffs > nbands) {
+		ncoeffs = nbands;
+	}
+	record_size = sizeof(mfcc_record_t) +
+	    sizeof(float) * (nbands + 2 * ncoeffs);
+	return filterbank_arena_size(FILTERBANK_MEL, nbands, config) +
+	    ARENA_ROUND(sizeof(float) * ncoeffs * nbands) +
+	    ARENA_ROUND(sizeof(float) * config.nbins) +
+	    ARENA_ROUND(sizeof(float) * config.nframes * nbands) +
+	    ARENA_ROUND(sizeof(float) * ncoeffs) +
+	    ARENA_ROUND(record_size * config.nframes);
+}
+
+/*
+ * Build the mel filters, the DCT-II matrix and the buffers of one call
+ *
+ * The filters span config.fmin to config.fmax. Everything is taken from the
+ * arena.
+ */
+int
+build_mfcc(mfcc_t *m, u_int nbands, u_int ncoeffs, fft_config_t config,
+    arena_t *arena)
+{
+	u_int k, b;
+	int res;
+	double scale;
+
+	memset(m, 0, sizeof(*m));
+	if (ncoeffs > nbands) {
+		ncoeffs = nbands;
+	}
+	m->ncoeffs = ncoeffs;
+	m->nframes = config.nframes;
+	m->record_size = sizeof(mfcc_record_t) +
+	    sizeof(float) * (nbands + 2 * ncoeffs);
+
+	if ((res = build_filterbank(&m->bank, FILTERBANK_MEL, nbands,
+	    config, arena)) != 0) {
+		return res;
+	}
+
+	m->dct = arena_alloc(arena, sizeof(float) * ncoeffs * nbands);
+	m->power = arena_alloc(arena, sizeof(float) * config.nbins);
+	m->logmel = arena_alloc(arena,
+	    sizeof(float) * config.nframes * nbands);
+	m->last = arena_alloc(arena, sizeof(float) * ncoeffs);
+	m->records = arena_alloc(arena, m->record_size * config.nframes);
+	if (m->dct == NULL || m->power == NULL || m->logmel == NULL ||
+	    m->last == NULL || m->records == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	for (k = 0; k < ncoeffs; k++) {
+		scale = sqrt((k == 0 ? 1.0 : 2.0) / nbands);
+		for (b = 0; b < nbands; b++) {
+			m->dct[k * nbands + b] = (float)(scale *
+			    cos(M_PI * k * (b + 0.5) / nbands));
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Describe the records of device to a reader of the stream
+ */
+void
+mfcc_header(const mfcc_t *m, fft_config_t config, u_int device,
+    u_int ndevices, mfcc_header_t *header)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, MFCC_MAGIC, sizeof(header->magic));
+	header->version = MFCC_VERSION;
+	header->device = device;
+	header->ndevices = ndevices;
+	header->fs = config.fs;
+	header->nsamples = config.nsamples;
+	header->nbands = m->bank.nbands;
+	header->ncoeffs = m->ncoeffs;
+}
+
+/*
+ * Extract the features of every frame of the normalized pcm data
+ *
+ * Returns the packed records, one per frame, which are kept until the next
+ * call, and their total size in size. Deltas are the difference with the
+ * previous frame, carried over from the previous call, so no frame is held
+ * back waiting for the next one; the very first frame has zero deltas.
+ */
+const u_char *
+mfcc(mfcc_t *m, fft_config_t config, u_int device, const float *pcm,
+    cplx *scratch, size_t *size)
+{
+	u_int t, k, b, j, nbands;
+	float acc;
+	const float *row, *x;
+	float *feat;
+	mfcc_record_t *r;
+	cplx *buf;
+
+	nbands = m->bank.nbands;
+
+	/* log-mel energies of every frame, one row each */
+	for (t = 0; t < m->nframes; t++) {
+		buf = fft_frame(config, pcm + t * config.nsamples, scratch);
+		for (j = 0; j < config.nbins; j++) {
+			m->power[j] = 0.0f;
+		}
+		fft_accumulate_power(buf, m->power, config.nbins);
+		feat = m->logmel + t * nbands;
+		apply_filterbank(&m->bank, m->power, feat);
+		for (b = 0; b < nbands; b++) {
+			feat[b] = logf(feat[b] + MFCC_FLOOR);
+		}
+	}
+
+	/* the whole batch through the DCT matrix, then the deltas */
+	for (t = 0; t < m->nframes; t++) {
+		r = (mfcc_record_t *)(m->records + t * m->record_size);
+		r->device = device;
+		r->frame = m->frame;
+		feat = (float *)(r + 1);
+		x = m->logmel + t * nbands;
+		memcpy(feat, x, sizeof(float) * nbands);
+		feat += nbands;
+
+		for (k = 0; k < m->ncoeffs; k++) {
+			row = m->dct + k * nbands;
+			acc = 0.0f;
+			for (b = 0; b < nbands; b++) {
+				acc += row[b] * x[b];
+			}
+			feat[k] = acc;
+		}
+		for (k = 0; k < m->ncoeffs; k++) {
+			feat[m->ncoeffs + k] = m->frame == 0 ? 0.0f :
+			    feat[k] - m->last[k];
+			m->last[k] = feat[k];
+		}
+		m->frame++;
+	}
+
+	*size = m->record_size * m->nframes;
+	return m->records;
+}
@@ -0,0 +1,99 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_MFCC_H
+#define AUDIO_MFCC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "arena.h"
+#include "fft.h"
+#include "filterbank.h"
+
+#define MFCC_MAGIC "AVMF"
+#define MFCC_VERSION 1
+
+#define MFCC_BANDS 40      /* mel bands of the log-mel energies */
+#define MFCC_COEFFS 13     /* cepstral coefficients kept */
+#define MFCC_FLOOR 1e-10f  /* energy floor before the log */
+
+/*
+ * Header of a feature stream, written once per device before any record.
+ * All fields and the records that follow are in host byte order.
+ */
+typedef struct mfcc_header_t {
+	char magic[4];     /* MFCC_MAGIC */
+	uint32_t version;  /* MFCC_VERSION */
+	uint32_t device;   /* index of the device described */
+	uint32_t ndevices; /* number of headers before the records */
+	uint32_t fs;       /* sample rate of the device */
+	uint32_t nsamples; /* samples per frame, frames do not overlap */
+	uint32_t nbands;   /* log-mel energies per record */
+	uint32_t ncoeffs;  /* coefficients and deltas per record */
+} mfcc_header_t;
+
+/*
+ * Head of a record, followed by nbands log-mel energies, ncoeffs
+ * coefficients and ncoeffs deltas, all floats
+ */
+typedef struct mfcc_record_t {
+	uint32_t device;   /* index of the device */
+	uint32_t frame;    /* number of the frame on its device */
+} mfcc_record_t;
+
+/*
+ * Feature extractor of a single device
+ *
+ * Every call turns all config.nframes frames of an interval into records at
+ * once: the log-mel energies of the frames are gathered into a matrix which
+ * is multiplied with the precomputed DCT-II matrix in a single pass.
+ */
+typedef struct mfcc_t {
+	filterbank_t bank;   /* mel filters, MFCC_BANDS of them */
+	u_int ncoeffs;       /* coefficients per frame */
+	u_int nframes;       /* frames per call */
+	float *dct;          /* ncoeffs x nbands orthonormal DCT-II matrix */
+	float *power;        /* power spectrum of the current frame */
+	float *logmel;       /* nframes x nbands log-mel energies */
+	float *last;         /* coefficients of the previous frame */
+	u_char *records;     /* the packed records of the last call */
+	size_t record_size;  /* size of one record */
+	uint32_t frame;      /* frames extracted so far */
+} mfcc_t;
+
+size_t mfcc_arena_size(u_int nbands, u_int ncoeffs, fft_config_t config);
+int build_mfcc(mfcc_t *m, u_int nbands, u_int ncoeffs, fft_config_t config,
+    arena_t *arena);
+void mfcc_header(const mfcc_t *m, fft_config_t config, u_int device,
+    u_int ndevices, mfcc_header_t *header);
+const u_char *mfcc(mfcc_t *m, fft_config_t config, u_int device,
+    const float *pcm, cplx *scratch, size_t *size);
+
+#endif
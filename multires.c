@@ -0,0 +1,241 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "decimate.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "multires.h"
+
+/*
+ * Pick the levels down to config.fmin and the bins taken from each
+ *
+ * Every level but the top one ends where the one above it starts, well
+ * within the flat part of its decimator. Returns the number of stitched
+ * bins.
+ */
+static u_int
+plan_levels(multires_t *m, fft_config_t config)
+{
+	u_int l, count;
+	double df;
+	multires_level_t *lv;
+
+	count = 0;
+	m->nlevels = 0;
+	for (l = 0; l < MULTIRES_LEVELS; l++) {
+		lv = &m->levels[l];
+		m->nlevels++;
+		lv->rate = (double)config.fs / (double)(1u << l);
+		lv->fmax = l == 0 ? (float)config.fs / 2.0f :
+		    m->levels[l - 1].fmin;
+		lv->fmin = (float)(MULTIRES_SPLIT * lv->rate);
+		if (lv->fmin <= config.fmin || l == MULTIRES_LEVELS - 1) {
+			lv->fmin = 0.0f;
+		}
+
+		df = lv->rate / config.nsamples;
+		lv->lo = (u_int)ceil(lv->fmin / df);
+		lv->hi = (u_int)ceil(lv->fmax / df);
+		if (lv->hi > config.nbins) {
+			lv->hi = config.nbins;
+		}
+		count += lv->hi - lv->lo;
+
+		if (lv->fmin == 0.0f) {
+			break;
+		}
+	}
+	return count;
+}
+
+/*
+ * Size of the arena the levels of config take
+ */
+size_t
+multires_arena_size(fft_config_t config)
+{
+	multires_t m;
+	size_t size;
+	u_int count;
+
+	memset(&m, 0, sizeof(m));
+	count = plan_levels(&m, config);
+	size = 2 * ARENA_ROUND(sizeof(float) * config.nsamples) +
+	    ARENA_ROUND(sizeof(float) * (config.total_samples + 1)) +
+	    ARENA_ROUND(sizeof(bin_t) * count);
+	size += m.nlevels * (ARENA_ROUND(sizeof(float) * config.nsamples) +
+	    ARENA_ROUND(sizeof(float) * config.nbins));
+	if (m.nlevels > 1) {
+		size += (m.nlevels - 1) *
+		    decimator_arena_size(2, config.total_samples + 1);
+	}
+	return size;
+}
+
+/*
+ * Pick the levels down to config.fmin and lay out the stitched bins, with
+ * the buffers taken from the arena
+ */
+int
+build_multires(multires_t *m, fft_config_t config, arena_t *arena)
+{
+	u_int l, k, n, count;
+	int res;
+	multires_level_t *lv;
+
+	memset(m, 0, sizeof(*m));
+	n = config.nsamples;
+	m->hop = n / 2;
+	m->window = arena_alloc(arena, sizeof(float) * n);
+	m->segment = arena_alloc(arena, sizeof(float) * n);
+	m->work = arena_alloc(arena,
+	    sizeof(float) * (config.total_samples + 1));
+	if (m->window == NULL || m->segment == NULL || m->work == NULL) {
+		return E_NO_MEMORY;
+	}
+	for (k = 0; k < n; k++) {
+		m->window[k] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * k / n));
+	}
+
+	count = plan_levels(m, config);
+	for (l = 0; l < m->nlevels; l++) {
+		lv = &m->levels[l];
+		if (l > 0) {
+			res = build_decimator(&lv->decimator, 2,
+			    config.total_samples + 1, arena);
+			if (res != 0) {
+				return res;
+			}
+		}
+		lv->ring = arena_alloc(arena, sizeof(float) * n);
+		lv->power = arena_alloc(arena, sizeof(float) * config.nbins);
+		if (lv->ring == NULL || lv->power == NULL) {
+			return E_NO_MEMORY;
+		}
+	}
+
+	if ((m->bins = arena_alloc(arena, sizeof(bin_t) * count)) == NULL) {
+		return E_NO_MEMORY;
+	}
+	count = 0;
+	for (l = m->nlevels; l-- > 0;) {
+		lv = &m->levels[l];
+		for (k = lv->lo; k < lv->hi; k++) {
+			m->bins[count].frequency = (float)(k * lv->rate / n);
+			m->bins[count].magnitude = 0.0f;
+			count++;
+		}
+	}
+	m->config = config;
+	m->config.nbins = count;
+
+	return 0;
+}
+
+/*
+ * Push n samples into a level, running its fft every hop samples
+ *
+ * The power spectrum of the level averages the ffts of this call, or is
+ * left as it was if the level was not due.
+ */
+static void
+feed_level(multires_t *m, multires_level_t *lv, fft_config_t config,
+    const float *x, u_int n, cplx *scratch)
+{
+	u_int i, j, k, nffts;
+	cplx *buf;
+
+	nffts = 0;
+	for (i = 0; i < n; i++) {
+		lv->ring[lv->pos] = x[i];
+		if (++lv->pos == config.nsamples) {
+			lv->pos = 0;
+		}
+		if (++lv->pending < m->hop) {
+			continue;
+		}
+		lv->pending = 0;
+
+		for (j = 0, k = lv->pos; j < config.nsamples; j++) {
+			m->segment[j] = lv->ring[k] * m->window[j];
+			if (++k == config.nsamples) {
+				k = 0;
+			}
+		}
+		buf = fft_frame(config, m->segment, scratch);
+		if (nffts++ == 0) {
+			memset(lv->power, 0, sizeof(float) * config.nbins);
+		}
+		fft_accumulate_power(buf, lv->power, config.nbins);
+	}
+
+	if (nffts > 1) {
+		for (k = 0; k < config.nbins; k++) {
+			lv->power[k] /= (float)nffts;
+		}
+	}
+}
+
+/*
+ * Feed the npcm normalized samples of a frame to every level and stitch
+ * their spectra into m->bins
+ *
+ * The magnitudes of the bins compare to those of fft() of the same size.
+ */
+void
+multires(multires_t *m, fft_config_t config, const float *pcm, u_int npcm,
+    cplx *scratch)
+{
+	u_int l, k, n, count;
+	multires_level_t *lv;
+
+	memcpy(m->work, pcm, sizeof(float) * npcm);
+	n = npcm;
+	for (l = 0; l < m->nlevels; l++) {
+		lv = &m->levels[l];
+		if (l > 0) {
+			n = decimate(&lv->decimator, m->work, n, m->work);
+		}
+		feed_level(m, lv, config, m->work, n, scratch);
+	}
+
+	/* the window halves a tone */
+	count = 0;
+	for (l = m->nlevels; l-- > 0;) {
+		lv = &m->levels[l];
+		for (k = lv->lo; k < lv->hi; k++) {
+			m->bins[count++].magnitude = 2.0f * sqrtf(lv->power[k]);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_MULTIRES_H
+#define AUDIO_MULTIRES_H
+
+#include <sys/types.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "decimate.h"
+#include "fft.h"
+
+#define MULTIRES_LEVELS 6     /* octaves of decimation at most */
+#define MULTIRES_SPLIT 0.175  /* lowest frequency of a level, in its rates */
+
+/*
+ * A level of the multi-resolution spectrum
+ *
+ * Level l sees the samples decimated by 2^l and transforms the last
+ * nsamples of them every hop new samples, so its fft covers 2^l times the
+ * duration of the first level's at 2^l times the resolution, and runs
+ * 2^l times less often.
+ */
+typedef struct multires_level_t {
+	decimator_t decimator; /* by 2 from the level above, none on level 0 */
+	double rate;           /* sample rate of the level */
+	float fmin;            /* lowest frequency taken from the level */
+	float fmax;            /* highest frequency taken from the level */
+	u_int lo;              /* first fft bin taken from the level */
+	u_int hi;              /* fft bin past the last one taken */
+	float *ring;           /* the last nsamples samples of the level */
+	u_int pos;             /* oldest sample in ring */
+	u_int pending;         /* samples since the last fft */
+	float *power;          /* power spectrum of the last ffts */
+} multires_level_t;
+
+/*
+ * Spectrum stitched from ffts of the same size at decreasing rates
+ *
+ * The top level covers the highest frequencies at the full rate, every
+ * level below takes the octave under it from half the rate, and the bottom
+ * level everything that is left down to config.fmin. The bins of all
+ * levels are stitched from the bottom up into one array for fill_bars().
+ */
+typedef struct multires_t {
+	u_int nlevels;        /* levels in use */
+	u_int hop;            /* new samples between two ffts of a level */
+	float *window;        /* nsamples Hann coefficients */
+	float *segment;       /* windowed samples of the current fft */
+	float *work;          /* samples of the frame, decimated in place */
+	bin_t *bins;          /* the stitched bins */
+	fft_config_t config;  /* nbins is the number of stitched bins */
+	multires_level_t levels[MULTIRES_LEVELS];
+} multires_t;
+
+size_t multires_arena_size(fft_config_t config);
+int build_multires(multires_t *m, fft_config_t config, arena_t *arena);
+void multires(multires_t *m, fft_config_t config, const float *pcm,
+    u_int npcm, cplx *scratch);
+
+#endif
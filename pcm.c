@@ -26,9 +26,13 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#include <stdint.h>
+#include <string.h>
+
 #include "pcm.h"
 #include "auconv.h"
 #include "error_codes.h"
+#include "meter.h"
 
 /*
  * Set the swap function of a converter
@@ -126,12 +130,15 @@ set_normalize_func(pcm_converter_t *converter, u_int precision)
 	switch (precision) {
 	case 8:
 		converter->normalize_func = normalize8;
+		converter->denormalize_func = denormalize8;
 		break;
 	case 16:
 		converter->normalize_func = normalize16;
+		converter->denormalize_func = denormalize16;
 		break;
 	case 32:
 		converter->normalize_func = normalize32;
+		converter->denormalize_func = denormalize32;
 		break;
 	default:
 		return E_FREQ_UNKNOWN_PRECISION;
@@ -163,39 +170,132 @@ build_converter(pcm_converter_t *converter, u_int precision, u_int encoding)
 	return 0;
 }
 
+/*
+ * Convert size bytes of raw audio data into normalized pcm data
+ *
+ * The data is never modified. Each sample is copied into an aligned scratch
+ * word before it is swapped and signed, so data can point straight into a
+ * read-only mapping of a recording or of the driver's ring buffer.
+ *
+ * With a meter, the samples are converted PCM_CHUNK at a time and metered
+ * while they are still in the cache, instead of in a pass of their own.
+ */
+static void
+convert(const pcm_converter_t *converter, u_int inc, const u_char *data,
+    size_t size, float *pcm, meter_t *meter)
+{
+	union {
+		uint32_t align;
+		u_char bytes[sizeof(uint32_t)];
+	} sample;
+	size_t i;
+	u_int n;
+	float *chunk;
+
+	for (i = 0; i < size;) {
+		chunk = pcm;
+		for (n = 0; i < size && n < PCM_CHUNK; i += inc, n++) {
+			memcpy(sample.bytes, data + i, inc);
+			if (converter->swap_func != NULL) {
+				converter->swap_func(sample.bytes);
+			}
+			if (converter->sign_func != NULL) {
+				converter->sign_func(sample.bytes);
+			}
+			*pcm++ = converter->normalize_func(sample.bytes);
+		}
+		if (meter != NULL) {
+			meter_update(meter, chunk, n);
+		}
+	}
+}
+
 /*
  * Convert the raw audio data into normalized pcm data
  */
 int
-to_normalized_pcm(audio_stream_t audio_stream, u_char *data, float *pcm)
+to_normalized_pcm(audio_stream_t audio_stream, const u_char *data, float *pcm)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *)(uintptr_t)data;
+	iov.iov_len = audio_stream.total_size;
+	return to_normalized_pcm_iov(audio_stream, &iov, 1, pcm);
+}
+
+/*
+ * Convert raw audio data split over several segments into normalized pcm data
+ *
+ * Every segment must hold whole samples.
+ */
+int
+to_normalized_pcm_iov(audio_stream_t audio_stream, const struct iovec *iov,
+    int iovcnt, float *pcm)
+{
+	return to_metered_pcm_iov(audio_stream, iov, iovcnt, pcm, NULL);
+}
+
+/*
+ * Convert raw audio data split over several segments into normalized pcm
+ * data, feeding the samples to meter on the way if it is not NULL
+ */
+int
+to_metered_pcm_iov(audio_stream_t audio_stream, const struct iovec *iov,
+    int iovcnt, float *pcm, meter_t *meter)
 {
-	u_char *c;
-	u_int encoding, i, j, precision;
 	u_int inc;
-	int err;
+	int err, i;
 	pcm_converter_t converter;
 
-	precision = audio_stream.precision;
-	encoding = audio_stream.encoding;
+	err = build_converter(&converter, audio_stream.precision,
+	    audio_stream.encoding);
+	if (err > 0) {
+		return err;
+	}
+
+	inc = audio_stream.precision / STREAM_BYTE_SIZE;
+	for (i = 0; i < iovcnt; i++) {
+		convert(&converter, inc, iov[i].iov_base, iov[i].iov_len, pcm,
+		    meter);
+		pcm += iov[i].iov_len / inc;
+	}
+	return 0;
+}
+
+/*
+ * Convert normalized pcm data into raw audio data, to be played
+ *
+ * The inverse of to_normalized_pcm(): every sample is clipped to full scale,
+ * then signed and swapped into the encoding of the stream.
+ */
+int
+from_normalized_pcm(audio_stream_t audio_stream, const float *pcm,
+    u_char *data)
+{
+	union {
+		uint32_t align;
+		u_char bytes[sizeof(uint32_t)];
+	} sample;
+	u_int i, inc;
+	int err;
+	pcm_converter_t converter;
 
-	if ((err = build_converter(&converter, precision, encoding)) > 0) {
+	err = build_converter(&converter, audio_stream.precision,
+	    audio_stream.encoding);
+	if (err > 0) {
 		return err;
 	}
 
-	inc = precision / STREAM_BYTE_SIZE;
-	c = data;
-	j = 0;
-	for (i = 0; i < audio_stream.total_size; i += inc) {
-		if (converter.swap_func != NULL) {
-			converter.swap_func(c);
-		}
+	inc = audio_stream.precision / STREAM_BYTE_SIZE;
+	for (i = 0; i < audio_stream.total_samples; i++, data += inc) {
+		converter.denormalize_func(pcm[i], sample.bytes);
 		if (converter.sign_func != NULL) {
-			converter.sign_func(c);
+			converter.sign_func(sample.bytes);
 		}
-		pcm[j] = converter.normalize_func(c);
-
-		j++;
-		c += inc;
+		if (converter.swap_func != NULL) {
+			converter.swap_func(sample.bytes);
+		}
+		memcpy(data, sample.bytes, inc);
 	}
 	return 0;
 }
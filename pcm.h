@@ -30,14 +30,24 @@
 #define PCM_H
 
 #include "audio_stream.h"
+#include "meter.h"
+
+#define PCM_CHUNK 256 /* samples converted between two meter updates */
 
 typedef struct pcm_converter_t {
 	void (*swap_func)(u_char *); /* le <> be - can be null */
 	void (*sign_func)(u_char *); /* unsigned -> signed - can be null */
 	float (*normalize_func)(u_char *); /* normalize to a float to 0-1 */
+	void (*denormalize_func)(float, u_char *); /* and back */
 } pcm_converter_t;
 
 int build_converter(pcm_converter_t *converter, u_int prec, u_int enc);
-int to_normalized_pcm(audio_stream_t a_stream, u_char *data, float *out);
+int to_normalized_pcm(audio_stream_t a_stream, const u_char *data, float *out);
+int to_normalized_pcm_iov(audio_stream_t a_stream, const struct iovec *iov,
+    int iovcnt, float *out);
+int to_metered_pcm_iov(audio_stream_t a_stream, const struct iovec *iov,
+    int iovcnt, float *out, meter_t *meter);
+int from_normalized_pcm(audio_stream_t a_stream, const float *pcm,
+    u_char *data);
 
 #endif
@@ -0,0 +1,291 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/audioio.h>
+#include <sys/ioctl.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_ctrl.h"
+#include "audio_file.h"
+#include "audio_stream.h"
+#include "error_codes.h"
+#include "pcm.h"
+#include "qualify.h"
+
+static const u_int sample_rates[] = { 8000, 11025, 16000, 22050, 32000,
+	44100, 48000, 88200, 96000, 176400, 192000 };
+static const u_int channel_counts[] = { 1, 2, 4, 6, 8, 12, 16 };
+static const u_int buffer_sizes[] = { 1024, 4096, 16384, 65536 };
+
+#define NELEM(a) (sizeof(a) / sizeof((a)[0]))
+
+/*
+ * List the encodings of the device that the pcm converter can handle
+ *
+ * Recordings only support their own format.
+ */
+static u_int
+list_encodings(audio_ctrl_t *ctrl, audio_encoding_t *encs, u_int max)
+{
+	u_int n;
+	audio_encoding_t enc;
+	pcm_converter_t converter;
+
+	if (ctrl->file != NULL) {
+		memset(&encs[0], 0, sizeof(encs[0]));
+		encs[0].encoding = (int)ctrl->config.encoding;
+		encs[0].precision = (int)ctrl->config.precision;
+		return 1;
+	}
+
+	n = 0;
+	for (enc.index = 0; n < max; enc.index++) {
+		if (ioctl(ctrl->fd, AUDIO_GETENC, &enc) == -1) {
+			break;
+		}
+		if (build_converter(&converter, (u_int)enc.precision,
+		    (u_int)enc.encoding) != 0) {
+			continue;
+		}
+		encs[n++] = enc;
+	}
+
+	return n;
+}
+
+static int
+same_format(audio_config_t a, audio_config_t b)
+{
+	return a.encoding == b.encoding && a.precision == b.precision &&
+	    a.sample_rate == b.sample_rate && a.channels == b.channels;
+}
+
+static double
+elapsed(struct timespec start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)(now.tv_sec - start.tv_sec) +
+	    (double)(now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * Read from the device for ms milliseconds with the current configuration
+ *
+ * Reads are issued with the size of the device buffer, like stream() does.
+ * Recordings are rewound at their end so they can be read indefinitely.
+ */
+static void
+measure(audio_ctrl_t *ctrl, u_int ms, qualify_result_t *r)
+{
+	u_char *buf;
+	ssize_t n;
+	size_t size;
+	u_int bytes_per_sample;
+	audio_info_t before, after;
+	struct timespec start;
+
+	size = ctrl->config.buffer_size;
+	if ((buf = malloc(size)) == NULL) {
+		r->status = QUALIFY_FAILED;
+		return;
+	}
+
+	if (ctrl->file == NULL) {
+		ioctl(ctrl->fd, AUDIO_FLUSH);
+		if (ioctl(ctrl->fd, AUDIO_GETINFO, &before) == -1) {
+			r->status = QUALIFY_FAILED;
+			free(buf);
+			return;
+		}
+	} else {
+		lseek(ctrl->fd, (off_t)ctrl->file->data_offset, SEEK_SET);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		n = read(ctrl->fd, buf, size);
+		r->nreads++;
+		if (n < 0) {
+			r->status = QUALIFY_FAILED;
+			break;
+		}
+		if (n == 0 && ctrl->file != NULL) {
+			lseek(ctrl->fd, (off_t)ctrl->file->data_offset, SEEK_SET);
+			continue;
+		}
+		if ((size_t)n < size) {
+			r->nshort++;
+		}
+		r->nbytes += (u_long)n;
+	} while (elapsed(start) * 1000.0 < ms);
+	r->seconds = elapsed(start);
+
+	if (ctrl->file == NULL &&
+	    ioctl(ctrl->fd, AUDIO_GETINFO, &after) != -1) {
+		bytes_per_sample = ctrl->config.precision / STREAM_BYTE_SIZE;
+		r->overrun = after.record.error != 0;
+		/* record.samples counts bytes, see check_overrun() */
+		if (after.record.samples - before.record.samples > r->nbytes) {
+			r->dropped = (after.record.samples -
+			    before.record.samples - r->nbytes) /
+			    bytes_per_sample;
+		}
+	}
+
+	free(buf);
+}
+
+static void
+print_header(FILE *out, audio_ctrl_t *ctrl)
+{
+	fprintf(out, "%s\n", ctrl->path);
+	fprintf(out, "%-12s %4s %6s %3s %7s %-8s %11s %10s %9s %6s %8s %3s\n",
+	    "ENCODING", "PREC", "RATE", "CH", "BUFSIZE", "STATUS", "KB/S",
+	    "EXPECTED", "READS/S", "SHORT", "DROPPED", "OVR");
+}
+
+static void
+print_result(FILE *out, qualify_result_t *r)
+{
+	const char *name, *status;
+	double expected;
+
+	name = get_encoding_name(r->config.encoding);
+	switch (r->status) {
+	case QUALIFY_OK:
+		status = "ok";
+		break;
+	case QUALIFY_REJECTED:
+		status = "rejected";
+		break;
+	default:
+		status = "failed";
+		break;
+	}
+
+	fprintf(out, "%-12s %4u %6u %3u %7u %-8s", name != NULL ? name : "?",
+	    r->config.precision, r->config.sample_rate, r->config.channels,
+	    r->config.buffer_size, status);
+	if (r->status != QUALIFY_OK) {
+		fprintf(out, "\n");
+		return;
+	}
+
+	expected = (double)r->config.sample_rate * r->config.channels *
+	    (r->config.precision / STREAM_BYTE_SIZE) / 1024.0;
+	fprintf(out, " %11.1f %10.1f %9.1f %6lu %8lu %3s\n",
+	    (double)r->nbytes / 1024.0 / r->seconds, expected,
+	    (double)r->nreads / r->seconds, r->nshort, r->dropped,
+	    r->overrun ? "yes" : "no");
+}
+
+/*
+ * Sweep every supported format of a device and report read performance
+ *
+ * Every combination of encoding, sample rate, channel count and buffer size
+ * is configured in turn and read for ms milliseconds. Any field set in pinned
+ * restricts the sweep to that value. Combinations the device refuses or
+ * silently alters are reported as rejected, except for the buffer size which
+ * is reported as the device set it. Recordings only sweep the buffer
+ * size, their format is fixed.
+ */
+int
+qualify(audio_ctrl_t *ctrl, audio_config_t pinned, u_int ms, FILE *out)
+{
+	u_int e, r, c, b, nencs, nrates, nchannels;
+	const u_int *rates, *channels;
+	audio_config_t want, orig;
+	audio_encoding_t encs[QUALIFY_MAX_ENCODINGS];
+	qualify_result_t res;
+
+	orig = ctrl->config;
+	nencs = list_encodings(ctrl, encs, QUALIFY_MAX_ENCODINGS);
+
+	rates = sample_rates;
+	nrates = NELEM(sample_rates);
+	channels = channel_counts;
+	nchannels = NELEM(channel_counts);
+	if (ctrl->file != NULL) {
+		rates = &orig.sample_rate;
+		nrates = 1;
+		channels = &orig.channels;
+		nchannels = 1;
+	}
+
+	print_header(out, ctrl);
+	for (e = 0; e < nencs; e++) {
+		if ((pinned.encoding > 0 &&
+		    (u_int)encs[e].encoding != pinned.encoding) ||
+		    (pinned.precision > 0 &&
+		    (u_int)encs[e].precision != pinned.precision)) {
+			continue;
+		}
+		for (r = 0; r < nrates; r++) {
+			if (pinned.sample_rate > 0 &&
+			    rates[r] != pinned.sample_rate) {
+				continue;
+			}
+			for (c = 0; c < nchannels; c++) {
+				if (pinned.channels > 0 &&
+				    channels[c] != pinned.channels) {
+					continue;
+				}
+				for (b = 0; b < NELEM(buffer_sizes); b++) {
+					memset(&res, 0, sizeof(res));
+					want.encoding = (u_int)encs[e].encoding;
+					want.precision = (u_int)encs[e].precision;
+					want.sample_rate = rates[r];
+					want.channels = channels[c];
+					want.buffer_size = buffer_sizes[b];
+					res.config = want;
+
+					/* drivers may round the buffer size */
+					if (update_audio_ctrl(ctrl, want) != 0 ||
+					    !same_format(ctrl->config, want)) {
+						res.status = QUALIFY_REJECTED;
+					} else {
+						res.config = ctrl->config;
+						measure(ctrl, ms, &res);
+					}
+					print_result(out, &res);
+					fflush(out);
+				}
+			}
+		}
+	}
+
+	/* leave the device the way we found it */
+	return update_audio_ctrl(ctrl, orig);
+}
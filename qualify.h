@@ -0,0 +1,55 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_QUALIFY_H
+#define AUDIO_QUALIFY_H
+
+#include <stdio.h>
+
+#include "audio_ctrl.h"
+
+#define QUALIFY_MAX_ENCODINGS 32
+
+#define QUALIFY_OK 0
+#define QUALIFY_REJECTED 1 /* the device refused or altered the format */
+#define QUALIFY_FAILED 2   /* reading from the device failed */
+
+typedef struct qualify_result_t {
+	audio_config_t config; /* format that was measured */
+	u_int status;          /* QUALIFY_OK, QUALIFY_REJECTED or QUALIFY_FAILED */
+	double seconds;        /* duration of the measurement */
+	u_long nbytes;         /* bytes read */
+	u_long nreads;         /* read(2) calls made */
+	u_long nshort;         /* reads that returned less than requested */
+	u_long dropped;        /* samples the driver recorded but we never read */
+	int overrun;           /* the driver flagged an overrun */
+} qualify_result_t;
+
+int qualify(audio_ctrl_t *ctrl, audio_config_t pinned, u_int ms, FILE *out);
+
+#endif
@@ -0,0 +1,119 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <errno.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "error_codes.h"
+#include "queue.h"
+
+/*
+ * Initialize an empty queue over size slots
+ */
+int
+build_queue(queue_t *queue, void **slots, u_int size)
+{
+	if (size == 0 || (size & (size - 1)) != 0) {
+		return E_CAPTURE_QUEUE;
+	}
+	if (sem_init(&queue->items, 0, 0) == -1) {
+		return E_CAPTURE_QUEUE;
+	}
+	queue->size = size;
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->tail, 0);
+	/* only set once the queue is usable, see destroy_queue() */
+	queue->slots = slots;
+	return 0;
+}
+
+/*
+ * Release the semaphore of a queue that build_queue() set slots of
+ */
+void
+destroy_queue(queue_t *queue)
+{
+	sem_destroy(&queue->items);
+}
+
+/*
+ * Append an item. Only the producer may call this.
+ *
+ * Returns -1 if the queue is full.
+ */
+int
+queue_push(queue_t *queue, void *item)
+{
+	u_int tail;
+
+	tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	if (tail - atomic_load_explicit(&queue->head, memory_order_acquire) ==
+	    queue->size) {
+		return -1;
+	}
+	queue->slots[tail & (queue->size - 1)] = item;
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+	sem_post(&queue->items);
+	return 0;
+}
+
+/*
+ * Remove the oldest item, sleeping until there is one. Only the consumer may
+ * call this.
+ *
+ * Returns NULL if the consumer was woken by queue_wake() instead.
+ */
+void *
+queue_pop(queue_t *queue)
+{
+	u_int head;
+	void *item;
+
+	while (sem_wait(&queue->items) == -1 && errno == EINTR) {
+		continue;
+	}
+
+	head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	if (head == atomic_load_explicit(&queue->tail, memory_order_acquire)) {
+		return NULL;
+	}
+	item = queue->slots[head & (queue->size - 1)];
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+	return item;
+}
+
+/*
+ * Wake the consumer up without an item, so it can notice it should stop
+ */
+void
+queue_wake(queue_t *queue)
+{
+	sem_post(&queue->items);
+}
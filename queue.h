@@ -0,0 +1,57 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_QUEUE_H
+#define AUDIO_QUEUE_H
+
+#include <sys/types.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+/*
+ * A bounded queue between exactly one producer and one consumer thread
+ *
+ * Pushing and popping never take a lock: the producer only moves tail and
+ * the consumer only moves head. The semaphore counts the queued items so
+ * the consumer can sleep while the queue is empty.
+ */
+typedef struct queue_t {
+	void **slots;      /* size slots, size is a power of two */
+	u_int size;
+	atomic_uint head;  /* next slot to pop */
+	atomic_uint tail;  /* next slot to push */
+	sem_t items;       /* number of queued items */
+} queue_t;
+
+int build_queue(queue_t *queue, void **slots, u_int size);
+void destroy_queue(queue_t *queue);
+int queue_push(queue_t *queue, void *item);
+void *queue_pop(queue_t *queue);
+void queue_wake(queue_t *queue);
+
+#endif
@@ -0,0 +1,141 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "rt.h"
+
+/*
+ * Run a thread with SCHED_FIFO at priority
+ *
+ * Returns 0 or the errno of the refusal; raising the priority usually takes
+ * root.
+ */
+int
+rt_priority(pthread_t thread, int priority)
+{
+	struct sched_param param;
+
+	if (priority < sched_get_priority_min(SCHED_FIFO) ||
+	    priority > sched_get_priority_max(SCHED_FIFO)) {
+		return EINVAL;
+	}
+	param.sched_priority = priority;
+	return pthread_setschedparam(thread, SCHED_FIFO, &param);
+}
+
+/*
+ * Pin a thread to a single cpu
+ *
+ * Returns 0 or the errno of the refusal.
+ */
+int
+rt_pin(pthread_t thread, int cpu)
+{
+	cpuset_t *cs;
+	int res;
+
+	if ((cs = cpuset_create()) == NULL) {
+		return ENOMEM;
+	}
+	cpuset_zero(cs);
+	cpuset_set((cpuid_t)cpu, cs);
+	res = pthread_setaffinity_np(thread, cpuset_size(cs), cs);
+	cpuset_destroy(cs);
+
+	return res;
+}
+
+/*
+ * Wire every page of the process, those mapped now and those mapped later
+ * such as the stacks of threads yet to start
+ *
+ * Returns 0 or the errno of mlockall(2), which usually takes privileges or
+ * a memory lock limit above the size of the process.
+ */
+int
+rt_lockall(void)
+{
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+		return errno;
+	}
+	return 0;
+}
+
+/*
+ * Wire a range of memory
+ *
+ * Returns 0 or the errno of mlock(2).
+ */
+int
+rt_lock(const void *addr, size_t size)
+{
+	if (size > 0 && mlock(addr, size) == -1) {
+		return errno;
+	}
+	return 0;
+}
+
+/*
+ * Fault every page of a range of memory in
+ *
+ * Done whether or not rt_lockall() was granted, so that at least the first
+ * use of every page does not fault in the capture path. Read-only ranges,
+ * such as the driver's ring buffer, are only read.
+ */
+void
+rt_prefault(const void *addr, size_t size, int writable)
+{
+	volatile u_char *p;
+	size_t i, page;
+
+	if (size == 0) {
+		return;
+	}
+
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	p = (volatile u_char *)(uintptr_t)addr;
+	for (i = 0; i < size; i += page) {
+		if (writable) {
+			p[i] = p[i];
+		} else {
+			(void)p[i];
+		}
+	}
+	if (writable) {
+		p[size - 1] = p[size - 1];
+	} else {
+		(void)p[size - 1];
+	}
+}
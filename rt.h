@@ -0,0 +1,53 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_RT_H
+#define AUDIO_RT_H
+
+#include <sys/types.h>
+#include <pthread.h>
+
+#define RT_MAX_CPUS 64
+
+/*
+ * What the capture path asks of the scheduler and the vm system
+ */
+typedef struct rt_config_t {
+	int priority;          /* SCHED_FIFO priority, 0 to stay SCHED_OTHER */
+	int lock;              /* mlockall() and prefault the working memory */
+	int cpus[RT_MAX_CPUS]; /* cpus to pin the capture threads to, in order */
+	u_int ncpus;           /* 0 to spread them over the spare cpus */
+} rt_config_t;
+
+int rt_priority(pthread_t thread, int priority);
+int rt_pin(pthread_t thread, int cpu);
+int rt_lockall(void);
+int rt_lock(const void *addr, size_t size);
+void rt_prefault(const void *addr, size_t size, int writable);
+
+#endif
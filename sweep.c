@@ -0,0 +1,642 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_ctrl.h"
+#include "audio_file.h"
+#include "audio_stream.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "pcm.h"
+#include "sweep.h"
+
+typedef struct sweep_player_t {
+	pthread_t thread;
+	audio_ctrl_t *ctrl;
+	audio_stream_t stream; /* the whole signal */
+	u_char *data;          /* the signal in the format of the device */
+	int res;
+} sweep_player_t;
+
+/*
+ * Render the sweep from f1 to f2 lasting about seconds
+ */
+int
+build_sweep(sweep_t *s, double f1, double f2, u_int seconds, u_int fs)
+{
+	u_int i, nfade;
+	double t, k;
+
+	memset(s, 0, sizeof(*s));
+	if (seconds == 0 || seconds > SWEEP_MAX_SECONDS) {
+		return E_SWEEP_LENGTH;
+	}
+	if (!(f1 > 0.0) || !(f2 > 2.0 * f1) || f2 >= fs / 2.0) {
+		return E_SWEEP_BAND;
+	}
+
+	/* f1 * rate is whole, so every harmonic starts in phase */
+	k = floor(f1 * seconds / log(f2 / f1) + 0.5);
+	if (k < 1.0) {
+		return E_SWEEP_BAND;
+	}
+	s->fs = fs;
+	s->f1 = f1;
+	s->f2 = f2;
+	s->rate = k / f1;
+	s->nsweep = (u_int)ceil(s->rate * log(f2 / f1) * fs);
+	s->nsignal = s->nsweep + fs / 1000 * SWEEP_TAIL_MS;
+
+	if ((s->signal = calloc(s->nsignal, sizeof(float))) == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	nfade = fs / 1000 * SWEEP_FADE_MS;
+	for (i = 0; i < s->nsweep; i++) {
+		t = (double)i / fs;
+		s->signal[i] = (float)(SWEEP_LEVEL * sin(2.0 * M_PI * k *
+		    (exp(t / s->rate) - 1.0)));
+		if (i < nfade) {
+			s->signal[i] *= (float)(0.5 - 0.5 *
+			    cos(M_PI * i / nfade));
+		} else if (s->nsweep - i <= nfade) {
+			s->signal[i] *= (float)(0.5 - 0.5 *
+			    cos(M_PI * (s->nsweep - 1 - i) / nfade));
+		}
+	}
+
+	return 0;
+}
+
+void
+free_sweep(sweep_t *s)
+{
+	free(s->signal);
+	free(s->inverse);
+	free(s->twiddles);
+	free(s->buf);
+	free(s->tmp);
+	s->signal = NULL;
+	s->inverse = NULL;
+	s->twiddles = NULL;
+	s->buf = NULL;
+	s->tmp = NULL;
+}
+
+/*
+ * Build the inverse filter for responses of nresponse samples
+ *
+ * The deconvolution is linear, not circular, as long as nfft holds both the
+ * response and the sweep. The orders of distortion come out ahead of time,
+ * that is at the end of the nfft samples, where the zero padding leaves
+ * room for them.
+ */
+int
+sweep_inverse(sweep_t *s, u_int nresponse)
+{
+	u_int k;
+	double f, power, peak, e;
+
+	s->nresponse = nresponse;
+	for (s->nfft = 2; s->nfft < nresponse + s->nsweep; s->nfft *= 2)
+		;
+
+	s->inverse = malloc(sizeof(cplx) * (s->nfft / 2 + 1));
+	s->twiddles = malloc(sizeof(cplx) * (s->nfft / 2));
+	s->buf = malloc(sizeof(cplx) * s->nfft);
+	s->tmp = malloc(sizeof(cplx) * s->nfft);
+	if (s->inverse == NULL || s->twiddles == NULL || s->buf == NULL ||
+	    s->tmp == NULL) {
+		return E_NO_MEMORY;
+	}
+	fft_twiddles(s->twiddles, s->nfft);
+
+	for (k = 0; k < s->nfft; k++) {
+		s->buf[k] = k < s->nsweep ? s->signal[k] : 0.0;
+	}
+	fft_cplx_table(s->buf, s->tmp, s->twiddles, s->nfft);
+
+	peak = 0.0;
+	for (k = 0; k <= s->nfft / 2; k++) {
+		power = creal(s->buf[k] * conj(s->buf[k]));
+		peak = fmax(peak, power);
+	}
+	for (k = 0; k <= s->nfft / 2; k++) {
+		f = (double)k * s->fs / s->nfft;
+		e = f >= s->f1 && f <= s->f2 ? SWEEP_REGULARIZE * peak : peak;
+		power = creal(s->buf[k] * conj(s->buf[k]));
+		s->inverse[k] = conj(s->buf[k]) / (power + e);
+	}
+
+	return 0;
+}
+
+/*
+ * Deconvolve the responses of two channels at once
+ *
+ * n samples, every stride-th of y0 and of y1, go into the real and the
+ * imaginary part of a single transform. The spectra of two real signals
+ * are conjugate symmetric, so both are split back out of it, filtered, and
+ * put together again so that a single inverse transform leaves the impulse
+ * responses in the real and imaginary parts. h0 and h1 receive nfft
+ * samples each. y1 and h1 may be NULL.
+ */
+void
+sweep_deconvolve(sweep_t *s, const float *y0, const float *y1,
+    u_int n, u_int stride, double *h0, double *h1)
+{
+	u_int i, k, nk;
+	cplx a, b, z0, z1;
+
+	if (n > s->nresponse) {
+		n = s->nresponse;
+	}
+	for (i = 0; i < s->nfft; i++) {
+		s->buf[i] = 0.0;
+	}
+	for (i = 0; i < n; i++) {
+		s->buf[i] = y0[(size_t)i * stride] +
+		    (y1 != NULL ? I * y1[(size_t)i * stride] : 0.0);
+	}
+	fft_cplx_table(s->buf, s->tmp, s->twiddles, s->nfft);
+
+	for (k = 0; k <= s->nfft / 2; k++) {
+		nk = (s->nfft - k) % s->nfft;
+		z0 = s->buf[k];
+		z1 = conj(s->buf[nk]);
+		a = (z0 + z1) * 0.5 * s->inverse[k];
+		b = (z0 - z1) * -0.5 * I * s->inverse[k];
+		/* inverse by the forward transform of the conjugate */
+		s->buf[k] = conj(a + I * b);
+		s->buf[nk] = conj(conj(a) + I * conj(b));
+	}
+	fft_cplx_table(s->buf, s->tmp, s->twiddles, s->nfft);
+
+	for (i = 0; i < s->nfft; i++) {
+		h0[i] = creal(s->buf[i]) / s->nfft;
+		if (h1 != NULL) {
+			h1[i] = -cimag(s->buf[i]) / s->nfft;
+		}
+	}
+}
+
+/*
+ * Window the impulse response of one order out of h and transform it
+ *
+ * The impulse sits an eighth into the n samples of the window, which fades
+ * in over that eighth and out over the last quarter. The delay of that
+ * eighth is taken back out of the spectrum, so that neighbouring bins can
+ * be interpolated.
+ */
+static void
+transform_order(const sweep_t *s, const double *h, long at, u_int n,
+    cplx *spectrum, cplx *tmp)
+{
+	u_int i, rise, fall;
+	long j;
+	double w;
+
+	rise = n / 8;
+	fall = n / 4;
+	for (i = 0; i < n; i++) {
+		j = (at - (long)rise + (long)i) % (long)s->nfft;
+		if (j < 0) {
+			j += s->nfft;
+		}
+		w = 1.0;
+		if (i < rise) {
+			w = 0.5 - 0.5 * cos(M_PI * i / rise);
+		} else if (n - i <= fall) {
+			w = 0.5 - 0.5 * cos(M_PI * (n - 1 - i) / fall);
+		}
+		spectrum[i] = h[j] * w;
+	}
+	fft_cplx(spectrum, tmp, n);
+	for (i = 0; i <= n / 2; i++) {
+		spectrum[i] *= cexp(2.0 * M_PI * I * (double)i * rise / n);
+	}
+}
+
+/*
+ * Interpolate a spectrum of n bins at frequency f
+ */
+static cplx
+spectrum_at(const sweep_t *s, const cplx *spectrum, u_int n, double f)
+{
+	double p, frac;
+	u_int k;
+
+	p = f * n / s->fs;
+	k = (u_int)p;
+	if (k >= n / 2) {
+		return spectrum[n / 2];
+	}
+	frac = p - k;
+	return spectrum[k] * (1.0 - frac) + spectrum[k + 1] * frac;
+}
+
+/*
+ * Write the frequency response and the harmonic distortion of a channel
+ *
+ * The linear impulse response is the largest sample of h. Order n lies
+ * rate * ln(n) seconds ahead of it and is windowed over the largest power
+ * of two that fits before order n + 1, at most SWEEP_MAX_IR samples. The
+ * phase is that of the linear response with the delay to its peak taken
+ * out. The distortion of order n at f is |Hn(n f)| / |H1(f)|, reported for
+ * n f up to f2.
+ */
+int
+sweep_report(const sweep_t *s, const double *h, u_int channel, FILE *out)
+{
+	u_int i, n, peak, len[SWEEP_HARMONICS + 1];
+	long at;
+	double f, gap, lead, mag, phase;
+	cplx *spectra[SWEEP_HARMONICS + 1], *tmp, h1, hn;
+	int res;
+
+	peak = 0;
+	for (i = 1; i < s->nfft; i++) {
+		if (fabs(h[i]) > fabs(h[peak])) {
+			peak = i;
+		}
+	}
+
+	res = 0;
+	memset(spectra, 0, sizeof(spectra));
+	tmp = malloc(sizeof(cplx) * SWEEP_MAX_IR);
+	if (tmp == NULL) {
+		return E_NO_MEMORY;
+	}
+	for (n = 1; n <= SWEEP_HARMONICS; n++) {
+		gap = s->rate * s->fs * (n < SWEEP_HARMONICS ?
+		    log((n + 1.0) / n) : log(n / (n - 1.0)));
+		for (len[n] = SWEEP_MAX_IR; len[n] > gap && len[n] > 8;
+		    len[n] /= 2)
+			;
+		if ((spectra[n] = malloc(sizeof(cplx) * len[n])) == NULL) {
+			res = E_NO_MEMORY;
+			goto done;
+		}
+		lead = s->rate * s->fs * log((double)n);
+		at = (long)peak - (long)floor(lead + 0.5);
+		transform_order(s, h, at, len[n], spectra[n], tmp);
+	}
+
+	fprintf(out, "# channel %u: delay %u samples (%.3f ms)\n", channel,
+	    peak, 1000.0 * peak / s->fs);
+	fprintf(out, "# %8s %9s %7s", "Hz", "dB", "deg");
+	for (n = 2; n <= SWEEP_HARMONICS; n++) {
+		fprintf(out, "  h%u (dB)", n);
+	}
+	fprintf(out, "\n");
+
+	for (i = 0;; i++) {
+		f = s->f1 * pow(2.0, (double)i / SWEEP_POINTS);
+		if (f > s->f2) {
+			break;
+		}
+		h1 = spectrum_at(s, spectra[1], len[1], f);
+		mag = cabs(h1);
+		phase = carg(h1) * 180.0 / M_PI;
+		fprintf(out, "%10.2f %9.2f %7.1f", f, 20.0 * log10(mag),
+		    phase);
+		for (n = 2; n <= SWEEP_HARMONICS; n++) {
+			if (n * f > s->f2) {
+				fprintf(out, " %9s", "nan");
+				continue;
+			}
+			hn = spectrum_at(s, spectra[n], len[n], n * f);
+			fprintf(out, " %9.2f", 20.0 * log10(cabs(hn) / mag));
+		}
+		fprintf(out, "\n");
+	}
+
+done:
+	for (n = 1; n <= SWEEP_HARMONICS; n++) {
+		free(spectra[n]);
+	}
+	free(tmp);
+	return res;
+}
+
+static void *
+play_thread(void *arg)
+{
+	sweep_player_t *p;
+
+	p = arg;
+	p->res = stream(*p->ctrl, p->stream, p->data);
+	return NULL;
+}
+
+/*
+ * Convert the signal, in every channel, to the format of a playback device
+ */
+static int
+build_player(sweep_player_t *p, const sweep_t *s, audio_ctrl_t *ctrl)
+{
+	u_int i, c, channels;
+	float *pcm;
+	int res;
+
+	memset(p, 0, sizeof(*p));
+	p->ctrl = ctrl;
+	channels = ctrl->config.channels;
+	res = build_stream(0, channels, s->fs, ctrl->config.buffer_size,
+	    ctrl->config.precision, ctrl->config.encoding, &p->stream);
+	if (res != 0) {
+		return res;
+	}
+	p->stream.total_samples = s->nsignal * channels;
+	p->stream.total_size = p->stream.total_samples *
+	    (ctrl->config.precision / STREAM_BYTE_SIZE);
+
+	pcm = malloc(sizeof(float) * p->stream.total_samples);
+	p->data = malloc(p->stream.total_size);
+	if (pcm == NULL || p->data == NULL) {
+		free(pcm);
+		return E_NO_MEMORY;
+	}
+	for (i = 0; i < s->nsignal; i++) {
+		for (c = 0; c < channels; c++) {
+			pcm[(size_t)i * channels + c] = s->signal[i];
+		}
+	}
+	res = from_normalized_pcm(p->stream, pcm, p->data);
+	free(pcm);
+	return res;
+}
+
+/*
+ * Record the response of every channel of a device, while p plays if it is
+ * not NULL
+ *
+ * Recording is under way by the time playback starts, the first read has
+ * returned.
+ */
+static int
+record_device(audio_ctrl_t *ctrl, u_int nframes, sweep_player_t *p,
+    float *pcm)
+{
+	audio_stream_t first, rest;
+	u_char *data;
+	u_int bytes_per_sample;
+	int res, started;
+
+	bytes_per_sample = ctrl->config.precision / STREAM_BYTE_SIZE;
+	res = build_stream(0, ctrl->config.channels, ctrl->config.sample_rate,
+	    ctrl->config.buffer_size, ctrl->config.precision,
+	    ctrl->config.encoding, &first);
+	if (res != 0) {
+		return res;
+	}
+	first.total_size = ctrl->config.buffer_size -
+	    ctrl->config.buffer_size %
+	    (ctrl->config.channels * bytes_per_sample);
+	first.total_samples = first.total_size / bytes_per_sample;
+	rest = first;
+	rest.total_samples = nframes * ctrl->config.channels;
+	if (rest.total_samples <= first.total_samples) {
+		return E_SWEEP_LENGTH;
+	}
+	rest.total_samples -= first.total_samples;
+	rest.total_size = rest.total_samples * bytes_per_sample;
+
+	if ((data = malloc(first.total_size + rest.total_size)) == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	started = 0;
+	if ((res = stream(*ctrl, first, data)) != 0) {
+		goto done;
+	}
+	if (p != NULL) {
+		if (pthread_create(&p->thread, NULL, play_thread, p) != 0) {
+			res = E_SWEEP_THREAD;
+			goto done;
+		}
+		started = 1;
+	}
+	res = stream(*ctrl, rest, data + first.total_size);
+
+	if (started) {
+		pthread_join(p->thread, NULL);
+		if (res == 0) {
+			res = p->res;
+		}
+	}
+	if (res == 0) {
+		rest.total_samples += first.total_samples;
+		rest.total_size += first.total_size;
+		res = to_normalized_pcm(rest, data, pcm);
+	}
+done:
+	free(data);
+	return res;
+}
+
+/*
+ * Convert up to nframes sample frames of a recorded response
+ */
+static int
+read_file(audio_file_t *file, u_int *nframes, float *pcm)
+{
+	audio_stream_t chunk;
+	u_int bytes_per_frame;
+	int res;
+
+	res = build_stream(0, file->config.channels,
+	    file->config.sample_rate, file->config.buffer_size,
+	    file->config.precision, file->config.encoding, &chunk);
+	if (res != 0) {
+		return res;
+	}
+	bytes_per_frame = file->config.channels *
+	    (file->config.precision / STREAM_BYTE_SIZE);
+	if (file->data_size / bytes_per_frame < *nframes) {
+		*nframes = (u_int)(file->data_size / bytes_per_frame);
+	}
+	chunk.total_samples = *nframes * file->config.channels;
+	chunk.total_size = *nframes * bytes_per_frame;
+	return to_normalized_pcm(chunk, file->map + file->data_offset, pcm);
+}
+
+/*
+ * Measure the response of a capture chain to a sweep from fmin to fmax
+ *
+ * The sweep is played into play, a device, file or pipe, unless it is NULL.
+ * The response is recorded from record, a device, recorded from while the
+ * sweep plays, or a recording of the sweep made before, unless it is NULL.
+ * Sample rates come from the recording, config or DEFAULT_RAW_SAMPLE_RATE,
+ * in that order; fmax defaults to SWEEP_FMAX of it. The report of every
+ * channel of the response is written to out.
+ */
+int
+run_sweep(const char *record, const char *play, audio_config_t config,
+    u_int seconds, float fmin, float fmax, FILE *out)
+{
+	u_int c, fs, channels, nframes;
+	int res, recorded;
+	struct stat st;
+	audio_ctrl_t rctrl, pctrl;
+	audio_file_t file;
+	sweep_t s;
+	sweep_player_t player;
+	float *pcm;
+	double *h0, *h1;
+
+	recorded = 0;
+	channels = 0;
+	fs = config.sample_rate > 0 ? config.sample_rate :
+	    DEFAULT_RAW_SAMPLE_RATE;
+	rctrl.fd = pctrl.fd = -1;
+	file.fd = -1;
+	memset(&s, 0, sizeof(s));
+	memset(&player, 0, sizeof(player));
+	pcm = NULL;
+	h0 = h1 = NULL;
+
+	if (record != NULL && stat(record, &st) == 0 && S_ISREG(st.st_mode)) {
+		if ((res = open_audio_file(&file, record, config)) != 0) {
+			return res;
+		}
+		fs = file.config.sample_rate;
+		channels = file.config.channels;
+		recorded = 1;
+	} else if (record != NULL) {
+		if ((res = build_audio_ctrl(&rctrl, record,
+		    AUMODE_RECORD)) != 0 ||
+		    (res = update_audio_ctrl(&rctrl, config)) != 0) {
+			goto done;
+		}
+		fs = rctrl.config.sample_rate;
+		channels = rctrl.config.channels;
+	}
+
+	res = build_sweep(&s, fmin, fmax > 0.0f ? fmax : SWEEP_FMAX * fs,
+	    seconds, fs);
+	if (res != 0) {
+		goto done;
+	}
+
+	if (play != NULL) {
+		if ((res = build_audio_ctrl(&pctrl, play, AUMODE_PLAY)) != 0) {
+			goto done;
+		}
+		config.sample_rate = fs;
+		if (rctrl.fd != -1) {
+			config.channels = 0;
+		}
+		if ((res = update_audio_ctrl(&pctrl, config)) != 0) {
+			goto done;
+		}
+		if (pctrl.config.sample_rate != fs) {
+			res = E_SWEEP_RATE;
+			goto done;
+		}
+		if ((res = build_player(&player, &s, &pctrl)) != 0) {
+			goto done;
+		}
+	}
+
+	fprintf(out, "# sweep %.1f to %.1f Hz, %.3f s at %u Hz\n", s.f1, s.f2,
+	    (double)s.nsweep / fs, fs);
+	if (record == NULL) {
+		/* nothing to measure, only play */
+		if (play != NULL) {
+			res = stream(pctrl, player.stream, player.data);
+		}
+		goto done;
+	}
+	if (play != NULL && recorded) {
+		/* the response was recorded before, play for the record */
+		if ((res = stream(pctrl, player.stream, player.data)) != 0) {
+			goto done;
+		}
+	}
+
+	nframes = s.nsignal + fs / 1000 * SWEEP_LEAD_MS;
+	if ((res = sweep_inverse(&s, nframes)) != 0) {
+		goto done;
+	}
+	pcm = malloc(sizeof(float) * nframes * channels);
+	h0 = malloc(sizeof(double) * s.nfft);
+	h1 = malloc(sizeof(double) * s.nfft);
+	if (pcm == NULL || h0 == NULL || h1 == NULL) {
+		res = E_NO_MEMORY;
+		goto done;
+	}
+	if (recorded) {
+		res = read_file(&file, &nframes, pcm);
+	} else {
+		res = record_device(&rctrl, nframes,
+		    play != NULL ? &player : NULL, pcm);
+	}
+	if (res != 0) {
+		goto done;
+	}
+
+	for (c = 0; c < channels; c += 2) {
+		sweep_deconvolve(&s, pcm + c,
+		    c + 1 < channels ? pcm + c + 1 : NULL, nframes,
+		    channels, h0, h1);
+		if ((res = sweep_report(&s, h0, c, out)) != 0) {
+			goto done;
+		}
+		if (c + 1 < channels &&
+		    (res = sweep_report(&s, h1, c + 1, out)) != 0) {
+			goto done;
+		}
+	}
+	fflush(out);
+
+done:
+	free(pcm);
+	free(h0);
+	free(h1);
+	free(player.data);
+	free_sweep(&s);
+	if (recorded) {
+		close_audio_file(&file);
+	}
+	if (rctrl.fd != -1) {
+		close_audio_ctrl(&rctrl);
+	}
+	if (pctrl.fd != -1) {
+		close_audio_ctrl(&pctrl);
+	}
+	return res;
+}
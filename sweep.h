@@ -0,0 +1,88 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_SWEEP_H
+#define AUDIO_SWEEP_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "audio_ctrl.h"
+#include "fft.h"
+
+#define SWEEP_LEVEL 0.5        /* amplitude of the sweep, -6 dBFS */
+#define SWEEP_HARMONICS 5      /* orders of the response separated */
+#define SWEEP_FADE_MS 10       /* fade in and out of the sweep */
+#define SWEEP_TAIL_MS 1000     /* silence played after the sweep */
+#define SWEEP_LEAD_MS 2000     /* latency a recorded response may have */
+#define SWEEP_MAX_SECONDS 60
+#define SWEEP_MAX_IR 65536     /* longest window of one order */
+#define SWEEP_FMAX 0.45        /* default end, of the sample rate */
+#define SWEEP_POINTS 12        /* points per octave of the report */
+#define SWEEP_REGULARIZE 1e-6  /* in band, of the largest |X|^2 */
+
+/*
+ * Synchronized exponential sine sweep and its inverse filter
+ *
+ * The frequency grows e fold every rate seconds, rate being rounded so that
+ * f1 * rate is a whole number. The n-th harmonic of the sweep is then the
+ * sweep itself, rate * ln(n) seconds ahead and in phase, so deconvolving a
+ * response leaves the impulse response of every order of distortion that
+ * much ahead of the linear one, where it is windowed out on its own.
+ *
+ * The inverse filter is the regularized spectral inverse of the sweep,
+ * X* / (|X|^2 + e), with e small within f1 to f2 and as large as the
+ * largest |X|^2 outside, over nfft bins, enough for a response of
+ * nresponse samples not to wrap around.
+ */
+typedef struct sweep_t {
+	u_int fs;         /* sample rate */
+	double f1, f2;    /* start and end frequency */
+	double rate;      /* seconds for the frequency to grow e fold */
+	u_int nsweep;     /* samples of the sweep */
+	u_int nsignal;    /* samples of the sweep and its tail */
+	float *signal;    /* the sweep, then SWEEP_TAIL_MS of silence */
+	u_int nresponse;  /* samples of a response */
+	u_int nfft;       /* length of the deconvolution */
+	cplx *inverse;    /* nfft / 2 + 1 bins of the inverse filter */
+	cplx *twiddles;   /* nfft / 2 twiddle factors */
+	cplx *buf;        /* nfft samples */
+	cplx *tmp;        /* nfft samples */
+} sweep_t;
+
+int build_sweep(sweep_t *s, double f1, double f2, u_int seconds, u_int fs);
+void free_sweep(sweep_t *s);
+int sweep_inverse(sweep_t *s, u_int nresponse);
+void sweep_deconvolve(sweep_t *s, const float *y0, const float *y1,
+    u_int n, u_int stride, double *h0, double *h1);
+int sweep_report(const sweep_t *s, const double *h, u_int channel,
+    FILE *out);
+int run_sweep(const char *record, const char *play, audio_config_t config,
+    u_int seconds, float fmin, float fmax, FILE *out);
+
+#endif
@@ -0,0 +1,678 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audio_ctrl.h"
+#include "audio_file.h"
+#include "audio_stream.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "pcm.h"
+#include "thdn.h"
+
+#define NELEM(a) (sizeof(a) / sizeof((a)[0]))
+
+#define THDN_SOURCE_SYNTH 0
+#define THDN_SOURCE_FILE 1
+#define THDN_SOURCE_DEVICE 2
+
+/* 7-term Blackman-Harris, alternating signs */
+static const double bh7[] = {
+	0.27105140069342, -0.43329793923448, 0.21812299954311,
+	-0.06592544638803, 0.01081174209837, -0.00077658482522,
+	0.00001388721735
+};
+
+static const char *limit_names[THDN_NLIMITS] = {
+	"thd", "thdn", "snr", "sinad"
+};
+
+const char *
+get_thdn_limit_name(u_int limit)
+{
+	return limit < THDN_NLIMITS ? limit_names[limit] : NULL;
+}
+
+int
+build_thdn(thdn_t *t, u_int nsamples, u_int fs)
+{
+	u_int i, j;
+	double x;
+	int res;
+
+	memset(t, 0, sizeof(*t));
+	if ((res = build_fft_config(&t->config, nsamples, fs, nsamples,
+	    0.0f)) != 0) {
+		return res;
+	}
+
+	t->window = malloc(sizeof(float) * nsamples);
+	t->frame = malloc(sizeof(float) * nsamples);
+	t->segment = malloc(sizeof(float) * nsamples);
+	t->power = calloc(t->config.nbins, sizeof(float));
+	if (t->window == NULL || t->frame == NULL || t->segment == NULL ||
+	    t->power == NULL) {
+		free_thdn(t);
+		return E_NO_MEMORY;
+	}
+
+	for (j = 0; j < nsamples; j++) {
+		x = 0.0;
+		for (i = 0; i < NELEM(bh7); i++) {
+			x += bh7[i] * cos(2.0 * M_PI * i * j / nsamples);
+		}
+		t->window[j] = (float)x;
+		t->energy += x * x;
+	}
+
+	return 0;
+}
+
+void
+free_thdn(thdn_t *t)
+{
+	free(t->window);
+	free(t->frame);
+	free(t->segment);
+	free(t->power);
+	t->window = NULL;
+	t->frame = NULL;
+	t->segment = NULL;
+	t->power = NULL;
+}
+
+/*
+ * Add n samples, every stride-th of pcm, to the averaged spectrum
+ *
+ * Every frame that fills up is transformed, then its second half is kept as
+ * the first half of the next one.
+ */
+void
+thdn_update(thdn_t *t, const float *pcm, u_int n, u_int stride,
+    cplx *scratch)
+{
+	u_int i, j, half;
+	cplx *buf;
+
+	half = t->config.nsamples / 2;
+	for (i = 0; i < n; i++) {
+		t->frame[t->fill++] = pcm[(size_t)i * stride];
+		if (t->fill < t->config.nsamples) {
+			continue;
+		}
+
+		for (j = 0; j < t->config.nsamples; j++) {
+			t->segment[j] = t->frame[j] * t->window[j];
+		}
+		buf = fft_frame(t->config, t->segment, scratch);
+		fft_accumulate_power(buf, t->power, t->config.nbins);
+		t->nframes++;
+
+		memmove(t->frame, t->frame + half, sizeof(float) * half);
+		t->fill = half;
+	}
+}
+
+/*
+ * Sum the power of bins from to to that lie between lo and hi
+ *
+ * The number of bins summed is added to count.
+ */
+static double
+sum_power(const bin_t *bins, long from, long to, u_int lo, u_int hi,
+    u_int *count)
+{
+	long j;
+	double sum;
+
+	sum = 0.0;
+	for (j = from < (long)lo ? (long)lo : from;
+	    j <= to && j <= (long)hi; j++) {
+		sum += (double)bins[j].magnitude * bins[j].magnitude;
+		(*count)++;
+	}
+	return sum;
+}
+
+/*
+ * Measure the averaged spectrum between flo and fhi
+ *
+ * bins receives config.nbins bins of the averaged magnitude, the measurement
+ * is done over them. The fundamental is the largest bin of the band and its
+ * frequency is interpolated with a parabola through the logarithm of the
+ * three largest bins. THDN_LOBE bins either side of the fundamental and of
+ * every harmonic up to THDN_HARMONICS that lies below fhi count as that
+ * tone, every other bin of the band is noise. The noise is scaled up to the
+ * whole band, as if it went on under the tones at the same density.
+ */
+int
+thdn_measure(const thdn_t *t, bin_t *bins, float flo, float fhi,
+    thdn_result_t *r)
+{
+	u_int j, h, k, lo, hi, ntotal, ntones;
+	double df, a, b, c, d, center, total, fundamental, harmonics, noise;
+
+	memset(r, 0, sizeof(*r));
+	r->nframes = t->nframes;
+	if (t->nframes == 0) {
+		return E_THDN_FUNDAMENTAL;
+	}
+
+	reset_bins(bins, t->config);
+	for (j = 0; j < t->config.nbins; j++) {
+		bins[j].magnitude = sqrtf(t->power[j] / (float)t->nframes);
+	}
+
+	df = (double)t->config.fs / t->config.nsamples;
+	if (fhi <= 0.0f || fhi > t->config.fmax) {
+		fhi = t->config.fmax;
+	}
+	lo = (u_int)ceil(flo / df);
+	hi = (u_int)floor(fhi / df);
+	if (lo < 1) {
+		lo = 1;
+	}
+	if (hi > t->config.nbins - 1) {
+		hi = t->config.nbins - 1;
+	}
+	if (lo + 2 > hi) {
+		return E_THDN_FUNDAMENTAL;
+	}
+
+	k = lo;
+	for (j = lo; j <= hi; j++) {
+		if (bins[j].magnitude > bins[k].magnitude) {
+			k = j;
+		}
+	}
+	/* harmonic lobes must clear the lobe of the fundamental */
+	if (k <= 2 * THDN_LOBE || !(bins[k].magnitude > 0.0f)) {
+		return E_THDN_FUNDAMENTAL;
+	}
+
+	a = log(fmax(bins[k - 1].magnitude, 1e-30f));
+	b = log(bins[k].magnitude);
+	c = log(fmax(bins[k + 1].magnitude, 1e-30f));
+	d = a - 2.0 * b + c;
+	d = d < 0.0 ? 0.5 * (a - c) / d : 0.0;
+	r->frequency = (k + d) * df;
+
+	ntotal = ntones = 0;
+	total = sum_power(bins, lo, hi, lo, hi, &ntotal);
+	fundamental = sum_power(bins, (long)k - THDN_LOBE,
+	    (long)k + THDN_LOBE, lo, hi, &ntones);
+	harmonics = 0.0;
+	for (h = 2; h <= THDN_HARMONICS; h++) {
+		center = floor(h * (k + d) + 0.5);
+		if (center > hi) {
+			break;
+		}
+		harmonics += sum_power(bins, (long)center - THDN_LOBE,
+		    (long)center + THDN_LOBE, lo, hi, &ntones);
+		r->nharmonics++;
+	}
+	noise = total - fundamental - harmonics;
+	if (ntotal > ntones) {
+		noise *= (double)ntotal / (ntotal - ntones);
+	}
+	/* keep the ratios finite, 200 dB below the fundamental */
+	noise = fmax(noise, fundamental * 1e-20);
+	harmonics = fmax(harmonics, fundamental * 1e-20);
+	total = fundamental + harmonics + noise;
+
+	/* a full scale sine leaves N * energy / 4 in its one-sided lobe */
+	r->level = 10.0 * log10(4.0 * fundamental /
+	    ((double)t->config.nsamples * t->energy));
+	r->thd = 10.0 * log10(harmonics / fundamental);
+	r->thdn = 10.0 * log10((noise + harmonics) / fundamental);
+	r->snr = 10.0 * log10(fundamental / noise);
+	r->sinad = 10.0 * log10(total / (noise + harmonics));
+
+	return 0;
+}
+
+/*
+ * Compare a result to the limits, NAN for the ones not checked
+ *
+ * Returns a mask of 1 << THDN_* of the limits not met. THD is not checked
+ * when no harmonic lies within the band.
+ */
+int
+thdn_check(const thdn_result_t *r, const double *limits)
+{
+	int failed;
+
+	failed = 0;
+	if (!isnan(limits[THDN_THD]) && r->nharmonics > 0 &&
+	    r->thd > limits[THDN_THD]) {
+		failed |= 1 << THDN_THD;
+	}
+	if (!isnan(limits[THDN_THDN]) && r->thdn > limits[THDN_THDN]) {
+		failed |= 1 << THDN_THDN;
+	}
+	if (!isnan(limits[THDN_SNR]) && r->snr < limits[THDN_SNR]) {
+		failed |= 1 << THDN_SNR;
+	}
+	if (!isnan(limits[THDN_SINAD]) && r->sinad < limits[THDN_SINAD]) {
+		failed |= 1 << THDN_SINAD;
+	}
+	return failed;
+}
+
+/*
+ * Parse synth:frequency[,thd[,snr]]
+ *
+ * Without thd the tone is a pure sine, without snr it has no noise.
+ */
+int
+build_thdn_synth(thdn_synth_t *s, const char *spec, u_int fs)
+{
+	const char *p;
+	char *ep;
+	double a;
+
+	memset(s, 0, sizeof(*s));
+	s->thd = -INFINITY;
+	s->snr = INFINITY;
+	s->rng = 0x9e3779b97f4a7c15ULL;
+
+	p = spec + strlen(THDN_SYNTH_PREFIX);
+	s->frequency = strtod(p, &ep);
+	if (ep == p || !(s->frequency > 0.0) || s->frequency >= fs / 2.0) {
+		return E_THDN_SYNTH;
+	}
+	if (ep[0] == ',') {
+		p = ep + 1;
+		s->thd = strtod(p, &ep);
+		if (ep == p) {
+			return E_THDN_SYNTH;
+		}
+	}
+	if (ep[0] == ',') {
+		p = ep + 1;
+		s->snr = strtod(p, &ep);
+		if (ep == p) {
+			return E_THDN_SYNTH;
+		}
+	}
+	if (ep[0] != '\0') {
+		return E_THDN_SYNTH;
+	}
+
+	a = THDN_SYNTH_LEVEL;
+	s->step = 2.0 * M_PI * s->frequency / fs;
+	s->a2 = s->a3 = a * pow(10.0, s->thd / 20.0) / M_SQRT2;
+	s->sigma = a / M_SQRT2 * pow(10.0, -s->snr / 20.0);
+
+	return 0;
+}
+
+static double
+uniform(uint64_t *x)
+{
+	*x ^= *x >> 12;
+	*x ^= *x << 25;
+	*x ^= *x >> 27;
+	return ((double)((*x * 0x2545f4914f6cdd1dULL) >> 11) + 0.5) /
+	    9007199254740992.0;
+}
+
+/*
+ * Render n samples of the synthetic tone
+ */
+void
+thdn_synth(thdn_synth_t *s, float *pcm, u_int n)
+{
+	u_int i;
+	double x, u, v;
+
+	for (i = 0; i < n; i++) {
+		x = THDN_SYNTH_LEVEL * sin(s->phase) +
+		    s->a2 * sin(2.0 * s->phase) + s->a3 * sin(3.0 * s->phase);
+		if (s->sigma > 0.0) {
+			u = uniform(&s->rng);
+			v = uniform(&s->rng);
+			x += s->sigma * sqrt(-2.0 * log(u)) *
+			    cos(2.0 * M_PI * v);
+		}
+		pcm[i] = (float)x;
+
+		s->phase += s->step;
+		if (s->phase >= 2.0 * M_PI) {
+			s->phase -= 2.0 * M_PI;
+		}
+	}
+}
+
+static void
+print_header(FILE *out, const char *path, const double *limits)
+{
+	u_int i;
+	int n;
+
+	fprintf(out, "%s\n", path);
+	n = 0;
+	for (i = 0; i < THDN_NLIMITS; i++) {
+		if (isnan(limits[i])) {
+			continue;
+		}
+		fprintf(out, "%s %s %s %.1f dB", n++ == 0 ? "limits:" : ",",
+		    limit_names[i], i <= THDN_THDN ? "<=" : ">=", limits[i]);
+	}
+	if (n > 0) {
+		fprintf(out, "\n");
+	}
+	fprintf(out, "%-3s %9s %7s %8s %8s %8s %7s %7s %6s %s\n",
+	    "CH", "FREQ", "LEVEL", "THD", "THD%", "THD+N", "SNR", "SINAD",
+	    "FRAMES", "RESULT");
+}
+
+static void
+print_result(FILE *out, u_int channel, const thdn_result_t *r, int failed,
+    const double *limits)
+{
+	u_int i, n, checked;
+
+	fprintf(out, "%-3u %9.2f %7.2f ", channel, r->frequency, r->level);
+	if (r->nharmonics > 0) {
+		fprintf(out, "%8.2f %8.4f ", r->thd,
+		    100.0 * pow(10.0, r->thd / 20.0));
+	} else {
+		fprintf(out, "%8s %8s ", "-", "-");
+	}
+	fprintf(out, "%8.2f %7.2f %7.2f %6u ", r->thdn, r->snr, r->sinad,
+	    r->nframes);
+
+	checked = 0;
+	for (i = 0; i < THDN_NLIMITS; i++) {
+		checked += !isnan(limits[i]);
+	}
+	if (checked == 0) {
+		fprintf(out, "-\n");
+		return;
+	}
+	if (failed == 0) {
+		fprintf(out, "pass\n");
+		return;
+	}
+	fprintf(out, "fail");
+	for (i = 0, n = 0; i < THDN_NLIMITS; i++) {
+		if (failed & (1 << i)) {
+			fprintf(out, "%s%s", n++ == 0 ? " " : ",",
+			    limit_names[i]);
+		}
+	}
+	fprintf(out, "\n");
+}
+
+/*
+ * Average the spectrum of every channel of a recording
+ *
+ * The recording is converted ms at a time, straight from the mapping, and
+ * every channel is picked out of the interleaved samples.
+ */
+static int
+average_file(audio_file_t *file, u_int ms, thdn_t *t, cplx *scratch)
+{
+	u_int c, channels, bytes_per_sample;
+	size_t offset;
+	audio_stream_t chunk;
+	float *pcm;
+	int res;
+
+	channels = file->config.channels;
+	res = build_stream(ms, channels, file->config.sample_rate,
+	    file->config.buffer_size, file->config.precision,
+	    file->config.encoding, &chunk);
+	if (res != 0) {
+		return res;
+	}
+
+	/* whole sample frames, so every chunk starts on channel 0 */
+	bytes_per_sample = file->config.precision / STREAM_BYTE_SIZE;
+	chunk.total_samples -= chunk.total_samples % channels;
+	chunk.total_size = chunk.total_samples * bytes_per_sample;
+	if ((pcm = malloc(sizeof(float) * chunk.total_samples)) == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	for (offset = 0; offset < file->data_size; offset += chunk.total_size) {
+		if (file->data_size - offset < chunk.total_size) {
+			chunk.total_samples = (u_int)((file->data_size -
+			    offset) / bytes_per_sample);
+			chunk.total_samples -= chunk.total_samples % channels;
+			chunk.total_size = chunk.total_samples *
+			    bytes_per_sample;
+			if (chunk.total_size == 0) {
+				break;
+			}
+		}
+		res = to_normalized_pcm(chunk,
+		    file->map + file->data_offset + offset, pcm);
+		release_file_range(file, offset, chunk.total_size);
+		if (res != 0) {
+			break;
+		}
+		for (c = 0; c < channels; c++) {
+			thdn_update(&t[c], pcm + c,
+			    chunk.total_samples / channels, channels, scratch);
+		}
+	}
+
+	free(pcm);
+	return res;
+}
+
+/*
+ * Average the spectrum of every channel of a device over THDN_FRAMES frames
+ *
+ * The device is read ms at a time. The first read is thrown away, it may
+ * hold whatever the driver buffered before the tone was steady.
+ */
+static int
+average_device(audio_ctrl_t *ctrl, u_int ms, thdn_t *t, cplx *scratch)
+{
+	u_int c, n, channels;
+	audio_stream_t chunk;
+	u_char *data;
+	float *pcm;
+	int res;
+
+	channels = ctrl->config.channels;
+	if ((res = build_stream_from_ctrl(*ctrl, ms, &chunk)) != 0) {
+		return res;
+	}
+	data = malloc(chunk.total_size);
+	pcm = malloc(sizeof(float) * chunk.total_samples);
+	if (data == NULL || pcm == NULL) {
+		res = E_NO_MEMORY;
+		goto done;
+	}
+
+	for (n = 0; t[0].nframes < THDN_FRAMES; n++) {
+		if ((res = stream(*ctrl, chunk, data)) != 0) {
+			break;
+		}
+		if (n == 0) {
+			continue;
+		}
+		if ((res = to_normalized_pcm(chunk, data, pcm)) != 0) {
+			break;
+		}
+		for (c = 0; c < channels; c++) {
+			thdn_update(&t[c], pcm + c,
+			    chunk.total_samples / channels, channels, scratch);
+		}
+	}
+
+done:
+	free(data);
+	free(pcm);
+	return res;
+}
+
+/*
+ * Measure THD, THD+N, SNR and SINAD of every channel of a source
+ *
+ * path is a recording, which is measured whole, a device, which is recorded
+ * in the format of fallback until THDN_FRAMES frames are averaged, or
+ * THDN_SYNTH_PREFIX followed by the spec of a synthetic tone, which is
+ * rendered for as many frames to check the measurement against known levels.
+ * A report is written to out and failed is set when any channel misses any
+ * of the limits.
+ */
+int
+measure_thdn(const char *path, audio_config_t fallback, u_int ms,
+    u_int nsamples, float fmin, float fmax, const double *limits, FILE *out,
+    int *failed)
+{
+	u_int c, channels, fs, source;
+	int res, mask;
+	struct stat st;
+	audio_file_t file;
+	audio_ctrl_t ctrl;
+	thdn_synth_t synth;
+	thdn_result_t r;
+	thdn_t *t;
+	bin_t *bins;
+	cplx *scratch;
+	float *pcm;
+
+	*failed = 0;
+	t = NULL;
+	bins = NULL;
+	scratch = NULL;
+	pcm = NULL;
+
+	if (strncmp(path, THDN_SYNTH_PREFIX,
+	    strlen(THDN_SYNTH_PREFIX)) == 0) {
+		source = THDN_SOURCE_SYNTH;
+		channels = 1;
+		fs = fallback.sample_rate > 0 ? fallback.sample_rate :
+		    DEFAULT_RAW_SAMPLE_RATE;
+		if ((res = build_thdn_synth(&synth, path, fs)) != 0) {
+			return res;
+		}
+	} else if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+		source = THDN_SOURCE_FILE;
+		if ((res = open_audio_file(&file, path, fallback)) != 0) {
+			return res;
+		}
+		channels = file.config.channels;
+		fs = file.config.sample_rate;
+	} else {
+		source = THDN_SOURCE_DEVICE;
+		if ((res = build_audio_ctrl(&ctrl, path, AUMODE_RECORD)) != 0) {
+			return res;
+		}
+		if ((res = update_audio_ctrl(&ctrl, fallback)) != 0) {
+			close(ctrl.fd);
+			return res;
+		}
+		channels = ctrl.config.channels;
+		fs = ctrl.config.sample_rate;
+	}
+
+	t = calloc(channels, sizeof(thdn_t));
+	bins = malloc(sizeof(bin_t) * nsamples / 2);
+	scratch = malloc(2 * sizeof(cplx) * nsamples);
+	if (t == NULL || bins == NULL || scratch == NULL) {
+		res = E_NO_MEMORY;
+		goto done;
+	}
+	for (c = 0; c < channels; c++) {
+		if ((res = build_thdn(&t[c], nsamples, fs)) != 0) {
+			goto done;
+		}
+	}
+
+	switch (source) {
+	case THDN_SOURCE_SYNTH:
+		if ((pcm = malloc(sizeof(float) * nsamples)) == NULL) {
+			res = E_NO_MEMORY;
+			goto done;
+		}
+		while (t[0].nframes < THDN_FRAMES) {
+			thdn_synth(&synth, pcm, nsamples);
+			thdn_update(&t[0], pcm, nsamples, 1, scratch);
+		}
+		break;
+	case THDN_SOURCE_FILE:
+		res = average_file(&file, ms, t, scratch);
+		break;
+	default:
+		res = average_device(&ctrl, ms, t, scratch);
+		break;
+	}
+	if (res != 0) {
+		goto done;
+	}
+
+	/* a channel without a tone fails, it does not stop the others */
+	print_header(out, path, limits);
+	for (c = 0; c < channels; c++) {
+		res = thdn_measure(&t[c], bins, fmin, fmax, &r);
+		if (res == E_THDN_FUNDAMENTAL) {
+			fprintf(out, "%-3u %s\n", c, get_error_msg(res));
+			*failed = 1;
+			res = 0;
+			continue;
+		} else if (res != 0) {
+			goto done;
+		}
+		mask = thdn_check(&r, limits);
+		*failed |= mask != 0;
+		print_result(out, c, &r, mask, limits);
+	}
+	fflush(out);
+
+done:
+	if (t != NULL) {
+		for (c = 0; c < channels; c++) {
+			free_thdn(&t[c]);
+		}
+	}
+	free(t);
+	free(bins);
+	free(scratch);
+	free(pcm);
+	if (source == THDN_SOURCE_FILE) {
+		close_audio_file(&file);
+	} else if (source == THDN_SOURCE_DEVICE) {
+		close(ctrl.fd);
+	}
+	return res;
+}
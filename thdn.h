@@ -0,0 +1,112 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_THDN_H
+#define AUDIO_THDN_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "audio_ctrl.h"
+#include "fft.h"
+
+#define THDN_HARMONICS 10      /* highest harmonic counted as distortion */
+#define THDN_LOBE 7            /* bins each side of a tone counted with it */
+#define THDN_SYNTH_PREFIX "synth:"
+#define THDN_SYNTH_LEVEL 0.5   /* amplitude of the synthetic fundamental */
+#define THDN_FRAMES 256        /* frames averaged from devices and synths */
+
+#define THDN_THD 0    /* harmonics to fundamental, at most, dB */
+#define THDN_THDN 1   /* noise and harmonics to fundamental, at most, dB */
+#define THDN_SNR 2    /* fundamental to noise, at least, dB */
+#define THDN_SINAD 3  /* everything to noise and harmonics, at least, dB */
+#define THDN_NLIMITS 4
+
+/*
+ * Averaged spectrum of one channel
+ *
+ * Frames overlap by half and go through a 7-term Blackman-Harris window,
+ * whose main lobe spans 7 bins either side and whose side lobes stay 180 dB
+ * down, so the skirt of the fundamental does not pass for noise once
+ * THDN_LOBE bins either side of it are set aside.
+ */
+typedef struct thdn_t {
+	fft_config_t config; /* transform of a single frame */
+	float *window;       /* the Blackman-Harris window */
+	double energy;       /* sum of the squared window */
+	float *frame;        /* samples of the frame being filled */
+	float *segment;      /* windowed frame */
+	u_int fill;          /* samples in frame */
+	float *power;        /* |X|^2 summed over the frames */
+	u_int nframes;       /* frames summed into power */
+} thdn_t;
+
+typedef struct thdn_result_t {
+	double frequency;  /* fundamental, interpolated between bins */
+	double level;      /* fundamental, dBFS */
+	double thd;        /* dB */
+	double thdn;       /* dB */
+	double snr;        /* dB */
+	double sinad;      /* dB */
+	u_int nharmonics;  /* harmonics within the band */
+	u_int nframes;     /* frames averaged */
+} thdn_result_t;
+
+/*
+ * Sine with harmonic distortion and white noise of known levels
+ *
+ * The distortion is split evenly between the second and third harmonics,
+ * thd and snr are referred to the fundamental over the whole band.
+ */
+typedef struct thdn_synth_t {
+	double frequency; /* of the fundamental */
+	double thd;       /* dB */
+	double snr;       /* dB */
+	double step;      /* phase increment per sample */
+	double phase;     /* of the fundamental */
+	double a2, a3;    /* amplitudes of the harmonics */
+	double sigma;     /* standard deviation of the noise */
+	uint64_t rng;     /* xorshift state of the noise */
+} thdn_synth_t;
+
+int build_thdn(thdn_t *t, u_int nsamples, u_int fs);
+void free_thdn(thdn_t *t);
+void thdn_update(thdn_t *t, const float *pcm, u_int n, u_int stride,
+    cplx *scratch);
+int thdn_measure(const thdn_t *t, bin_t *bins, float flo, float fhi,
+    thdn_result_t *r);
+int thdn_check(const thdn_result_t *r, const double *limits);
+const char *get_thdn_limit_name(u_int limit);
+int build_thdn_synth(thdn_synth_t *s, const char *spec, u_int fs);
+void thdn_synth(thdn_synth_t *s, float *pcm, u_int n);
+int measure_thdn(const char *path, audio_config_t fallback, u_int ms,
+    u_int nsamples, float fmin, float fmax, const double *limits, FILE *out,
+    int *failed);
+
+#endif
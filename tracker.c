@@ -0,0 +1,134 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "tracker.h"
+
+/*
+ * Size of the arena the history of config.nsamples samples takes
+ */
+size_t
+tracker_arena_size(fft_config_t config)
+{
+	return ARENA_ROUND(sizeof(float) * config.nsamples);
+}
+
+/*
+ * Track ntargets frequencies over windows of config.nsamples samples, with
+ * the history taken from the arena
+ */
+int
+build_tracker(tracker_t *tracker, const float *freqs, u_int ntargets,
+    fft_config_t config, arena_t *arena)
+{
+	u_int k;
+	double w;
+
+	if (ntargets > TRACK_MAX) {
+		return E_TRACK_FREQUENCY;
+	}
+	tracker->ntargets = ntargets;
+	tracker->fs = config.fs;
+	tracker->n = config.nsamples;
+	tracker->pos = 0;
+	tracker->history = arena_alloc(arena, sizeof(float) * tracker->n);
+	if (tracker->history == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	for (k = 0; k < ntargets; k++) {
+		if (freqs[k] <= 0.0f || freqs[k] >= (float)config.fs / 2.0f) {
+			return E_TRACK_FREQUENCY;
+		}
+		w = 2.0 * M_PI * freqs[k] / config.fs;
+		tracker->freqs[k] = freqs[k];
+		tracker->sum[k] = 0.0;
+		tracker->osc[k] = 1.0;
+		tracker->step[k] = cexp(-I * w);
+		tracker->wrap[k] = cexp(I * w * tracker->n);
+	}
+
+	return 0;
+}
+
+/*
+ * Slide the window of every target over nsamples normalized samples
+ */
+void
+track(tracker_t *tracker, const float *pcm, u_int nsamples)
+{
+	u_int i, k;
+	float x, old;
+
+	for (i = 0; i < nsamples; i++) {
+		x = pcm[i];
+		old = tracker->history[tracker->pos];
+		tracker->history[tracker->pos] = x;
+
+		for (k = 0; k < tracker->ntargets; k++) {
+			tracker->sum[k] += (x - old * tracker->wrap[k]) *
+			    tracker->osc[k];
+			tracker->osc[k] *= tracker->step[k];
+		}
+
+		if (++tracker->pos == tracker->n) {
+			tracker->pos = 0;
+			for (k = 0; k < tracker->ntargets; k++) {
+				tracker->osc[k] /= cabs(tracker->osc[k]);
+			}
+		}
+	}
+}
+
+/*
+ * Fill one bar per target with the magnitude of its DFT
+ *
+ * The magnitude is that of an fft bin centered on the target, and the bar
+ * spans the width of such a bin.
+ */
+void
+tracker_bars(const tracker_t *tracker, bar_t *bars)
+{
+	u_int k;
+	float half;
+
+	for (k = 0; k < tracker->ntargets; k++) {
+		half = (float)tracker->fs / (float)tracker->n / 2.0f;
+		bars[k].fmin = tracker->freqs[k] - half;
+		bars[k].fmax = tracker->freqs[k] + half;
+		bars[k].magnitude = (float)cabs(tracker->sum[k]);
+		bars[k].nbins = 1;
+	}
+}
@@ -0,0 +1,73 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_TRACKER_H
+#define AUDIO_TRACKER_H
+
+#include <complex.h>
+#include <sys/types.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "fft.h"
+
+#define TRACK_MAX 32 /* frequencies tracked at most */
+
+/*
+ * Sliding DFT of a few target frequencies, updated on every sample
+ *
+ * Each target keeps the DFT of the last n samples at its own frequency,
+ * which need not fall on an fft bin. Every sample is added to every sum and
+ * the sample n samples older removed from it, so a sample costs O(ntargets)
+ * whatever the window, and the sums are always current instead of being
+ * recomputed once per window.
+ *
+ * The sums are kept in absolute time: sample m enters them multiplied by
+ * e^(-i w m), so nothing but the oscillator has to rotate, and the
+ * oscillator is renormalized once per window to keep it on the unit circle.
+ */
+typedef struct tracker_t {
+	u_int ntargets;          /* number of frequencies tracked */
+	u_int fs;                /* sample rate */
+	u_int n;                 /* samples in the window */
+	u_int pos;               /* oldest sample in history */
+	float *history;          /* the last n samples */
+	float freqs[TRACK_MAX];  /* tracked frequencies in Hz */
+	cplx sum[TRACK_MAX];     /* DFT of the window, in absolute time */
+	cplx osc[TRACK_MAX];     /* e^(-i w m) for the next sample m */
+	cplx step[TRACK_MAX];    /* e^(-i w), one sample of the oscillator */
+	cplx wrap[TRACK_MAX];    /* e^(i w n), from osc to the oldest sample */
+} tracker_t;
+
+size_t tracker_arena_size(fft_config_t config);
+int build_tracker(tracker_t *tracker, const float *freqs, u_int ntargets,
+    fft_config_t config, arena_t *arena);
+void track(tracker_t *tracker, const float *pcm, u_int nsamples);
+void tracker_bars(const tracker_t *tracker, bar_t *bars);
+
+#endif
@@ -0,0 +1,109 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bars.h"
+#include "waterfall.h"
+
+/*
+ * Initialize an empty history over nrows * ncols bytes of rows
+ */
+int
+build_waterfall(waterfall_t *waterfall, uint8_t *rows, u_int nrows,
+    u_int ncols)
+{
+	memset(rows, 0, (size_t)nrows * ncols);
+	waterfall->rows = rows;
+	waterfall->nrows = nrows;
+	waterfall->ncols = ncols;
+	atomic_init(&waterfall->count, 0);
+	return 0;
+}
+
+/*
+ * Quantize the average magnitude of a bar to a level
+ */
+static uint8_t
+quantize(const bar_t *bar)
+{
+	float db, level;
+
+	if (bar->nbins == 0 || bar->magnitude <= 0.0f) {
+		return 0;
+	}
+	db = 20.0f * log10f(bar->magnitude / (float)bar->nbins);
+	level = (db - WATERFALL_DB_MIN) / (WATERFALL_DB_MAX - WATERFALL_DB_MIN) *
+	    (float)(WATERFALL_LEVELS - 1);
+	if (level <= 0.0f) {
+		return 0;
+	}
+	if (level >= (float)(WATERFALL_LEVELS - 1)) {
+		return WATERFALL_LEVELS - 1;
+	}
+	return (uint8_t)level;
+}
+
+/*
+ * Push the bars of a new spectrum, overwriting the oldest row
+ */
+void
+push_waterfall(waterfall_t *waterfall, const bar_t *bars)
+{
+	u_int i, count;
+	uint8_t *row;
+
+	count = atomic_load_explicit(&waterfall->count, memory_order_relaxed);
+	row = waterfall->rows + (size_t)(count % waterfall->nrows) *
+	    waterfall->ncols;
+	for (i = 0; i < waterfall->ncols; i++) {
+		row[i] = quantize(&bars[i]);
+	}
+	atomic_store_explicit(&waterfall->count, count + 1,
+	    memory_order_release);
+}
+
+/*
+ * Get the row pushed age rows before the count'th one
+ *
+ * count should be a value of waterfall->count loaded by the reader. Returns
+ * NULL if that row was never pushed or has fallen out of the ring. A reader
+ * that lags the writer by a whole ring may see a row being overwritten.
+ */
+const uint8_t *
+waterfall_row(waterfall_t *waterfall, u_int count, u_int age)
+{
+	if (age >= count || age >= waterfall->nrows) {
+		return NULL;
+	}
+	return waterfall->rows +
+	    (size_t)((count - 1 - age) % waterfall->nrows) * waterfall->ncols;
+}
@@ -0,0 +1,63 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_WATERFALL_H
+#define AUDIO_WATERFALL_H
+
+#include <sys/types.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "bars.h"
+
+#define WATERFALL_ROWS 256      /* spectra kept per device */
+#define WATERFALL_DB_MIN -20.0f /* magnitude drawn as the lowest level */
+#define WATERFALL_DB_MAX 40.0f  /* magnitude drawn as the highest level */
+#define WATERFALL_LEVELS 256
+
+/*
+ * History of the last nrows spectra of a device
+ *
+ * Each row holds the bars of one spectrum, quantized to a level of
+ * WATERFALL_LEVELS between WATERFALL_DB_MIN and WATERFALL_DB_MAX, in a ring
+ * that never grows. A single thread pushes rows; any thread may read them,
+ * the newest being published by count.
+ */
+typedef struct waterfall_t {
+	uint8_t *rows;      /* nrows rows of ncols levels */
+	u_int nrows;        /* rows in the ring */
+	u_int ncols;        /* levels per row, one per bar */
+	atomic_uint count;  /* rows pushed so far, row i is at i % nrows */
+} waterfall_t;
+
+int build_waterfall(waterfall_t *waterfall, uint8_t *rows, u_int nrows,
+    u_int ncols);
+void push_waterfall(waterfall_t *waterfall, const bar_t *bars);
+const uint8_t *waterfall_row(waterfall_t *waterfall, u_int count, u_int age);
+
+#endif
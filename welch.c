@@ -0,0 +1,153 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "welch.h"
+
+/*
+ * Size of the arena the window and the segment of config take
+ */
+size_t
+welch_arena_size(fft_config_t config)
+{
+	return 2 * ARENA_ROUND(sizeof(float) * config.nsamples);
+}
+
+/*
+ * Build the window and the segmentation of config with overlap percent,
+ * taken from the arena
+ *
+ * The last segment ends at most hop - 1 samples before the end of the frame,
+ * instead of up to nsamples - 1 with frames that do not overlap.
+ */
+int
+build_welch(welch_t *welch, u_int overlap, fft_config_t config,
+    arena_t *arena)
+{
+	u_int j;
+	double energy;
+
+	if (overlap > WELCH_MAX_OVERLAP) {
+		return E_WELCH_OVERLAP;
+	}
+	welch->hop = config.nsamples * (100 - overlap) / 100;
+	if (welch->hop == 0) {
+		welch->hop = 1;
+	}
+	welch->nsegments =
+	    (config.total_samples - config.nsamples) / welch->hop + 1;
+
+	welch->window = arena_alloc(arena, sizeof(float) * config.nsamples);
+	welch->segment = arena_alloc(arena, sizeof(float) * config.nsamples);
+	if (welch->window == NULL || welch->segment == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	energy = 0.0;
+	for (j = 0; j < config.nsamples; j++) {
+		welch->window[j] = (float)(0.5 - 0.5 *
+		    cos(2.0 * M_PI * j / config.nsamples));
+		energy += (double)welch->window[j] * welch->window[j];
+	}
+
+	/*
+	 * One-sided density, twice the two-sided one but at DC, referred to
+	 * a full scale sine, whose mean square is 1/2, rather than to 1.
+	 */
+	welch->scale = 2.0 * 2.0 /
+	    ((double)config.fs * energy * welch->nsegments);
+
+	return 0;
+}
+
+/*
+ * Estimate the power spectral density of the normalized pcm data
+ *
+ * psd receives config.nbins bins in full scale^2 / Hz, 10 log10 of which is
+ * dBFS/Hz.
+ */
+void
+welch_psd(const welch_t *welch, fft_config_t config, const float *pcm,
+    float *psd, cplx *scratch)
+{
+	u_int i, j;
+	const float *x;
+	cplx *buf;
+
+	for (j = 0; j < config.nbins; j++) {
+		psd[j] = 0.0f;
+	}
+	for (i = 0; i < welch->nsegments; i++) {
+		x = pcm + i * welch->hop;
+		for (j = 0; j < config.nsamples; j++) {
+			welch->segment[j] = x[j] * welch->window[j];
+		}
+		buf = fft_frame(config, welch->segment, scratch);
+		fft_accumulate_power(buf, psd, config.nbins);
+	}
+	for (j = 0; j < config.nbins; j++) {
+		psd[j] *= (float)welch->scale;
+	}
+	psd[0] *= 0.5f;
+}
+
+/*
+ * Fill the bars with the mean density of their bins
+ *
+ * The magnitude of a bar is its density in dB above WELCH_DB_FLOOR, times
+ * its number of bins like the other transforms, so that it can be drawn
+ * as is. bins is scratch space of config.nbins bins.
+ */
+void
+welch_bars(const float *psd, bin_t *bins, bar_t *bars, u_int nbars,
+    fft_config_t config)
+{
+	u_int i;
+	float db;
+
+	reset_bins(bins, config);
+	for (i = 0; i < config.nbins; i++) {
+		bins[i].magnitude = psd[i];
+	}
+	fill_bars(bars, nbars, bins, config);
+
+	for (i = 0; i < nbars; i++) {
+		if (bars[i].nbins == 0) {
+			continue;
+		}
+		db = 10.0f * log10f(bars[i].magnitude / (float)bars[i].nbins +
+		    1e-30f) - WELCH_DB_FLOOR;
+		bars[i].magnitude = db > 0.0f ? db * (float)bars[i].nbins : 0.0f;
+	}
+}
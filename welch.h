@@ -0,0 +1,66 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_WELCH_H
+#define AUDIO_WELCH_H
+
+#include <sys/types.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "fft.h"
+
+#define WELCH_OVERLAP 50         /* default overlap of segments, percent */
+#define WELCH_MAX_OVERLAP 90
+#define WELCH_DB_FLOOR -140.0f   /* dBFS/Hz a bar of height zero stands for */
+
+/*
+ * Welch estimate of the power spectral density of a captured frame
+ *
+ * The frame is cut into segments of nsamples, one every hop samples, each
+ * multiplied by a Hann window before its fft. Their power spectra are
+ * averaged and scaled by the energy of the window, so a level does not
+ * depend on the fft size or the overlap.
+ */
+typedef struct welch_t {
+	u_int hop;        /* samples between the starts of two segments */
+	u_int nsegments;  /* segments per frame */
+	float *window;    /* nsamples window coefficients */
+	float *segment;   /* the windowed segment being transformed */
+	double scale;     /* from averaged |X|^2 to full scale^2 / Hz */
+} welch_t;
+
+size_t welch_arena_size(fft_config_t config);
+int build_welch(welch_t *welch, u_int overlap, fft_config_t config,
+    arena_t *arena);
+void welch_psd(const welch_t *welch, fft_config_t config, const float *pcm,
+    float *psd, cplx *scratch);
+void welch_bars(const float *psd, bin_t *bins, bar_t *bars, u_int nbars,
+    fft_config_t config);
+
+#endif
@@ -0,0 +1,210 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "error_codes.h"
+#include "fft.h"
+#include "zoom.h"
+
+#define ZOOM_RENORMALIZE 4096 /* samples between renormalizations */
+
+/*
+ * Decimation of the band of config, or 0 if it is too wide to zoom into
+ */
+static u_int
+band_decimation(fft_config_t config)
+{
+	double span;
+	u_int decimation;
+
+	span = (double)config.fmax - config.fmin;
+	if (span <= 0.0 ||
+	    (decimation = (u_int)floor(config.fs / (2.0 * span))) < 2) {
+		return 0;
+	}
+	return decimation;
+}
+
+/*
+ * Size of the arena the decimator of the band of config takes
+ */
+size_t
+zoom_arena_size(fft_config_t config)
+{
+	u_int ntaps;
+
+	ntaps = ZOOM_TAPS_PER_PHASE * band_decimation(config);
+	return ARENA_ROUND(sizeof(float) * ntaps) +
+	    ARENA_ROUND(sizeof(float) * config.nsamples) +
+	    ARENA_ROUND(sizeof(cplx) * 2 * ntaps) +
+	    ARENA_ROUND(sizeof(cplx) * config.nsamples);
+}
+
+/*
+ * Design the decimator and the fft of the band of config, taken from the
+ * arena
+ *
+ * The decimated rate is at least twice the width of the band, so the band
+ * and its images from the decimation stay apart, with room for the filter
+ * to roll off in between. The filter is a Blackman windowed sinc cut off at
+ * half the decimated rate.
+ */
+int
+build_zoom(zoom_t *zoom, fft_config_t config, arena_t *arena)
+{
+	u_int j;
+	int res;
+	double fc, t, w, sum;
+
+	memset(zoom, 0, sizeof(*zoom));
+	if ((zoom->decimation = band_decimation(config)) == 0) {
+		return E_ZOOM_BAND;
+	}
+	zoom->center = (config.fmin + config.fmax) / 2.0;
+	zoom->rate = (double)config.fs / zoom->decimation;
+	zoom->ntaps = ZOOM_TAPS_PER_PHASE * zoom->decimation;
+
+	res = build_fft_config(&zoom->config, config.nsamples,
+	    (u_int)lround(zoom->rate), config.nsamples, config.fmin);
+	if (res != 0) {
+		return res;
+	}
+	zoom->config.nbins = config.nsamples;
+	zoom->config.fmax = config.fmax;
+
+	zoom->taps = arena_alloc(arena, sizeof(float) * zoom->ntaps);
+	zoom->window = arena_alloc(arena, sizeof(float) * config.nsamples);
+	zoom->input = arena_alloc(arena, sizeof(cplx) * 2 * zoom->ntaps);
+	zoom->output = arena_alloc(arena, sizeof(cplx) * config.nsamples);
+	if (zoom->taps == NULL || zoom->window == NULL ||
+	    zoom->input == NULL || zoom->output == NULL) {
+		return E_NO_MEMORY;
+	}
+
+	fc = 0.5 / zoom->decimation;
+	sum = 0.0;
+	for (j = 0; j < zoom->ntaps; j++) {
+		t = j - (zoom->ntaps - 1) / 2.0;
+		w = 0.42 - 0.5 * cos(2.0 * M_PI * j / (zoom->ntaps - 1)) +
+		    0.08 * cos(4.0 * M_PI * j / (zoom->ntaps - 1));
+		zoom->taps[j] = (float)(w * (t == 0.0 ? 2.0 * fc :
+		    sin(2.0 * M_PI * fc * t) / (M_PI * t)));
+		sum += zoom->taps[j];
+	}
+	for (j = 0; j < zoom->ntaps; j++) {
+		zoom->taps[j] /= (float)sum;
+	}
+	for (j = 0; j < config.nsamples; j++) {
+		zoom->window[j] = (float)(0.5 - 0.5 *
+		    cos(2.0 * M_PI * j / config.nsamples));
+	}
+
+	zoom->osc = 1.0;
+	zoom->step = cexp(-I * 2.0 * M_PI * zoom->center / config.fs);
+	return 0;
+}
+
+/*
+ * Output of the low-pass over the last ntaps shifted samples
+ */
+static inline cplx
+zoom_decimate(const zoom_t *zoom)
+{
+	u_int j;
+	double re, im;
+	const cplx *x;
+
+	x = zoom->input + zoom->pos;
+	re = 0.0;
+	im = 0.0;
+	for (j = 0; j < zoom->ntaps; j++) {
+		re += zoom->taps[j] * creal(x[j]);
+		im += zoom->taps[j] * cimag(x[j]);
+	}
+	return re + I * im;
+}
+
+/*
+ * Feed nsamples normalized samples through the decimator and transform the
+ * latest decimated samples
+ *
+ * bins receives config.nsamples bins from the bottom to the top of the
+ * decimated band, centered on the band. Their magnitudes compare to those
+ * of fft() over as many samples. scratch must hold fft_scratch_size() bytes
+ * of the config of the band.
+ */
+void
+zoom(zoom_t *zoom, const float *pcm, u_int nsamples, bin_t *bins,
+    cplx *scratch)
+{
+	u_int i, j, k, n;
+	cplx x;
+
+	for (i = 0; i < nsamples; i++) {
+		x = pcm[i] * zoom->osc;
+		zoom->osc *= zoom->step;
+		if (++zoom->nosc == ZOOM_RENORMALIZE) {
+			zoom->osc /= cabs(zoom->osc);
+			zoom->nosc = 0;
+		}
+
+		zoom->input[zoom->pos] = x;
+		zoom->input[zoom->pos + zoom->ntaps] = x;
+		if (++zoom->pos == zoom->ntaps) {
+			zoom->pos = 0;
+		}
+		if (++zoom->phase == zoom->decimation) {
+			zoom->phase = 0;
+			zoom->output[zoom->head] = zoom_decimate(zoom);
+			if (++zoom->head == zoom->config.nsamples) {
+				zoom->head = 0;
+			}
+		}
+	}
+
+	n = zoom->config.nsamples;
+	for (j = 0; j < n; j++) {
+		scratch[j] = zoom->output[(zoom->head + j) % n] *
+		    zoom->window[j];
+	}
+	fft_cplx(scratch, scratch + n, n);
+
+	/* the window and the shift each halve a tone, fft() only the shift */
+	for (j = 0; j < n; j++) {
+		k = (j + n / 2) % n;
+		bins[j].frequency = (float)(zoom->center +
+		    ((double)j - n / 2) * zoom->rate / n);
+		bins[j].magnitude = 2.0f * (float)cabs(scratch[k]);
+	}
+}
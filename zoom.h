@@ -0,0 +1,76 @@
+/*-
+ * Copyright (c) 1997 The NetBSD Foundation, Inc.
+ * All rights reserved.
+ *
+ * This code is derived from software contributed to The NetBSD Foundation
+ * by Lennart Augustsson.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE NETBSD FOUNDATION, INC. AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef AUDIO_ZOOM_H
+#define AUDIO_ZOOM_H
+
+#include <sys/types.h>
+
+#include "arena.h"
+#include "bars.h"
+#include "fft.h"
+
+#define ZOOM_TAPS_PER_PHASE 12 /* taps of the low-pass per decimated sample */
+
+/*
+ * Zoom fft of the band config.fmin to config.fmax
+ *
+ * The samples are shifted down by the center of the band with a complex
+ * oscillator, low-pass filtered and decimated by the largest factor that
+ * keeps the band clear of aliases, and the last nsamples decimated samples
+ * go through a complex fft of nsamples points. The resolution is that of
+ * an fft decimation times longer at the full rate.
+ *
+ * The filter is only evaluated at the decimated instants, one polyphase
+ * branch of ZOOM_TAPS_PER_PHASE taps per input sample in effect. Its input
+ * is kept twice in a row, so the taps always see a contiguous window.
+ */
+typedef struct zoom_t {
+	u_int decimation;   /* input samples per decimated sample */
+	u_int ntaps;        /* taps of the low-pass filter */
+	u_int pos;          /* next slot of input */
+	u_int phase;        /* input samples since the last decimated one */
+	u_int head;         /* next slot of output */
+	double center;      /* frequency shifted to 0 Hz */
+	double rate;        /* decimated sample rate */
+	float *taps;        /* ntaps low-pass coefficients, newest last */
+	float *window;      /* nsamples Hann coefficients */
+	cplx *input;        /* 2 * ntaps shifted samples */
+	cplx *output;       /* the last nsamples decimated samples */
+	cplx osc;           /* oscillator at the next input sample */
+	cplx step;          /* one sample of the oscillator */
+	u_int nosc;         /* samples since the oscillator was renormalized */
+	fft_config_t config; /* fft of the decimated samples */
+} zoom_t;
+
+size_t zoom_arena_size(fft_config_t config);
+int build_zoom(zoom_t *zoom, fft_config_t config, arena_t *arena);
+void zoom(zoom_t *zoom, const float *pcm, u_int nsamples, bin_t *bins,
+    cplx *scratch);
+
+#endif